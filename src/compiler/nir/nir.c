@@ -125,6 +125,8 @@ nir_process_debug_variable_once(void)
    nir_debug_print_shader[MESA_SHADER_CALLABLE]     = NIR_DEBUG(PRINT_CBS);
    nir_debug_print_shader[MESA_SHADER_KERNEL]       = NIR_DEBUG(PRINT_KS);
    /* clang-format on */
+
+   nir_pass_stats_init();
 }
 
 void
@@ -2241,6 +2243,21 @@ nir_index_instrs(nir_function_impl *impl)
    return index;
 }
 
+/** Returns the number of instructions in all the impls of a shader. */
+unsigned
+nir_shader_count_instrs(nir_shader *shader)
+{
+   unsigned count = 0;
+
+   nir_foreach_function_impl(impl, shader) {
+      nir_foreach_block(block, impl) {
+         count += exec_list_length(&block->instr_list);
+      }
+   }
+
+   return count;
+}
+
 void
 nir_shader_clear_pass_flags(nir_shader *shader)
 {
@@ -1014,6 +1014,11 @@ typedef struct nir_instr {
 
    /** generic instruction index. */
    uint32_t index;
+
+   /** Hash of the instruction for nir_instr_set, or 0 if it hasn't been
+    * computed.  Only meaningful with nir_metadata_instr_hash.
+    */
+   uint32_t hash;
 } nir_instr;
 
 static inline nir_instr *
@@ -3794,6 +3799,19 @@ typedef enum {
     */
    nir_metadata_dominance_lca = 0x80,
 
+   /** Indicates that nir_instr::hash values are valid.
+    *
+    * Each one is either 0 or the current hash of the instruction, see
+    * nir_instr_set_init_cached().  nir_src_rewrite() resets the hash of the
+    * instruction whose source it changes.
+    *
+    * A pass can preserve this metadata type if it only adds, removes or
+    * moves instructions and changes sources with nir_src_rewrite().  Since
+    * this can't be assumed of most passes, it isn't part of
+    * nir_metadata_all and has to be preserved explicitly.
+    */
+   nir_metadata_instr_hash = 0x100,
+
    /** All control flow metadata
     *
     * This includes all metadata preserved by a pass that preserves control flow
@@ -3809,10 +3827,12 @@ typedef enum {
 
    /** All metadata
     *
-    * This includes all nir_metadata flags except not_properly_reset.  Passes
-    * which do not change the shader in any way should use this.
+    * This includes all nir_metadata flags except not_properly_reset and
+    * instr_hash.  Passes which do not change the shader in any way should use
+    * this.
     */
-   nir_metadata_all = ~nir_metadata_not_properly_reset,
+   nir_metadata_all = ~(nir_metadata_not_properly_reset |
+                        nir_metadata_instr_hash),
 } nir_metadata;
 MESA_DEFINE_CPP_ENUM_BITFIELD_OPERATORS(nir_metadata)
 
@@ -4777,6 +4797,9 @@ nir_src_rewrite(nir_src *src, nir_def *new_ssa)
    list_del(&src->use_link);
    src->ssa = new_ssa;
    list_addtail(&src->use_link, &new_ssa->uses);
+
+   if (!nir_src_is_if(src))
+      nir_src_parent_instr(src)->hash = 0;
 }
 
 static inline void
@@ -4993,6 +5016,7 @@ nir_block **nir_block_get_predecessors_sorted(const nir_block *block, void *mem_
 
 void nir_index_ssa_defs(nir_function_impl *impl);
 unsigned nir_index_instrs(nir_function_impl *impl);
+unsigned nir_shader_count_instrs(nir_shader *shader);
 
 void nir_index_blocks(nir_function_impl *impl);
 
@@ -5136,10 +5160,56 @@ should_print_nir(UNUSED nir_shader *shader)
 }
 #endif /* NDEBUG */
 
-#define _PASS(pass, nir, do_pass)                                       \
+/* Per-pass statistics gathered by NIR_PASS, see nir_pass_stats.c. */
+typedef struct {
+   const char *name;
+   uint64_t calls;
+   uint64_t progress;
+   uint64_t skipped;
+   int64_t time_ns;
+   int64_t instr_delta;
+} nir_pass_stats;
+
+typedef struct {
+   int64_t start_ns;
+   unsigned num_instrs;
+} nir_pass_stats_scope;
+
+extern bool nir_pass_stats_enabled;
+void nir_pass_stats_init(void);
+void nir_pass_stats_enable(void);
+nir_pass_stats *nir_pass_stats_get(void *mem_ctx, unsigned *count);
+void _nir_pass_stats_begin(nir_shader *shader, nir_pass_stats_scope *scope);
+void _nir_pass_stats_end(nir_shader *shader, nir_pass_stats_scope *scope,
+                         const char *name, bool progress);
+void _nir_pass_stats_skip(const char *name);
+
+static inline nir_pass_stats_scope
+nir_pass_stats_begin(nir_shader *shader)
+{
+   nir_pass_stats_scope scope = { 0 };
+   if (unlikely(nir_pass_stats_enabled))
+      _nir_pass_stats_begin(shader, &scope);
+   return scope;
+}
+static inline void
+nir_pass_stats_end(nir_shader *shader, nir_pass_stats_scope *scope,
+                   const char *name, bool progress)
+{
+   if (unlikely(nir_pass_stats_enabled))
+      _nir_pass_stats_end(shader, scope, name, progress);
+}
+static inline void
+nir_pass_stats_skip(const char *name)
+{
+   if (unlikely(nir_pass_stats_enabled))
+      _nir_pass_stats_skip(name);
+}
+
+#define _PASS(name, nir, do_pass)                                       \
    do {                                                                 \
-      if (should_skip_nir(#pass)) {                                     \
-         printf("skipping %s\n", #pass);                                \
+      if (should_skip_nir(name)) {                                      \
+         printf("skipping %s\n", name);                                 \
          break;                                                         \
       }                                                                 \
       if (NIR_DEBUG(INVALIDATE_METADATA))                               \
@@ -5161,7 +5231,13 @@ should_print_nir(UNUSED nir_shader *shader)
 
 extern simple_mtx_t nir_print_lock;
 
-#define NIR_PASS(progress, nir, pass, ...) _PASS(pass, nir, {                            \
+#define NIR_PASS(progress, nir, pass, ...) \
+   NIR_PASS_NAMED(progress, nir, #pass, pass, ##__VA_ARGS__)
+
+/* Like NIR_PASS, but for a pass called through a function pointer, which
+ * the NIR_SKIP and NIR_DEBUG output and the pass statistics know as "name".
+ */
+#define NIR_PASS_NAMED(progress, nir, name, pass, ...) _PASS(name, nir, {                \
    nir_metadata_set_validation_flag(nir);                                                \
    if (should_print_nir(nir)) {                                                          \
       if ((nir)->nir_pass_depth++ == 0) {                                                \
@@ -5169,17 +5245,20 @@ extern simple_mtx_t nir_print_lock;
       } else {                                                                           \
          (nir)->nir_pass_recursed = true;                                                \
       }                                                                                  \
-      printf("%s\n", #pass);                                                             \
+      printf("%s\n", name);                                                              \
    }                                                                                     \
    static const char *when = "after " #pass " in " __FILE__ ":" NIR_STRINGIZE(__LINE__); \
    struct blob blob_before = nir_validate_progress_setup(nir);                           \
-   if (pass(nir, ##__VA_ARGS__)) {                                                       \
+   nir_pass_stats_scope _stats = nir_pass_stats_begin(nir);                              \
+   bool _pass_progress = pass(nir, ##__VA_ARGS__);                                       \
+   nir_pass_stats_end(nir, &_stats, #pass, _pass_progress);                              \
+   if (_pass_progress) {                                                                 \
       nir_validate_shader(nir, when);                                                    \
       UNUSED bool _;                                                                     \
       progress = true;                                                                   \
       if (should_print_nir(nir)) {                                                       \
          if ((nir)->nir_pass_recursed)                                                   \
-            printf("%s (finished)\n", #pass);                                            \
+            printf("%s (finished)\n", name);                                             \
          nir_print_shader(nir, stdout);                                                  \
       }                                                                                  \
       nir_metadata_check_validation_flag(nir);                                           \
@@ -5195,15 +5274,18 @@ extern simple_mtx_t nir_print_lock;
    }                                                                                     \
 })
 
-#define _NIR_LOOP_PASS(progress, idempotent, skip, nir, pass, ...)   \
+#define _NIR_LOOP_PASS(progress, idempotent, skip, nir, name, pass, ...) \
 do {                                                                 \
    bool nir_loop_pass_progress = false;                              \
-   if (!_mesa_set_search(skip, (void (*)())&pass))                   \
-      NIR_PASS(nir_loop_pass_progress, nir, pass, ##__VA_ARGS__);    \
+   if (!_mesa_set_search(skip, (void (*)())(pass)))                  \
+      NIR_PASS_NAMED(nir_loop_pass_progress, nir, name, pass,        \
+                     ##__VA_ARGS__);                                 \
+   else                                                              \
+      nir_pass_stats_skip(name);                                     \
    if (nir_loop_pass_progress)                                       \
       _mesa_set_clear(skip, NULL);                                   \
    if (idempotent || !nir_loop_pass_progress)                        \
-      _mesa_set_add(skip, (void (*)())&pass);                        \
+      _mesa_set_add(skip, (void (*)())(pass));                       \
    UNUSED bool _ = false;                                            \
    progress |= nir_loop_pass_progress;                               \
 } while (0)
@@ -5232,13 +5314,19 @@ do {                                                                 \
  * using a new "skip" in-between.
  */
 #define NIR_LOOP_PASS(progress, skip, nir, pass, ...) \
-   _NIR_LOOP_PASS(progress, true, skip, nir, pass, ##__VA_ARGS__)
+   _NIR_LOOP_PASS(progress, true, skip, nir, #pass, pass, ##__VA_ARGS__)
+
+/* Like NIR_LOOP_PASS, but for a pass called through a function pointer, see
+ * NIR_PASS_NAMED.  The pass is still skipped by its address.
+ */
+#define NIR_LOOP_PASS_NAMED(progress, skip, nir, name, pass, ...) \
+   _NIR_LOOP_PASS(progress, true, skip, nir, name, pass, ##__VA_ARGS__)
 
 /* Like NIR_LOOP_PASS, but use this for passes which may make further progress
  * when repeated.
  */
 #define NIR_LOOP_PASS_NOT_IDEMPOTENT(progress, skip, nir, pass, ...) \
-   _NIR_LOOP_PASS(progress, false, skip, nir, pass, ##__VA_ARGS__)
+   _NIR_LOOP_PASS(progress, false, skip, nir, #pass, pass, ##__VA_ARGS__)
 
 #define NIR_SKIP(name) should_skip_nir(#name)
 
@@ -6606,8 +6694,47 @@ bool nir_shader_supports_implicit_lod(nir_shader *shader);
 
 void nir_live_defs_impl(nir_function_impl *impl);
 
+/** Incremental liveness updates
+ *
+ * Passes which only add and remove instructions or rewrite sources, without
+ * touching the control flow, can patch the liveness of the defs involved
+ * instead of having it recomputed for the whole impl.  Record every
+ * instruction right after inserting it or before removing it, and every def
+ * that gained or lost uses through a source rewrite, then pass the result of
+ * nir_live_defs_tracker_finish() to nir_progress().  Nothing is recorded if
+ * the liveness wasn't valid to begin with.
+ */
+typedef struct {
+   nir_function_impl *impl;
+   bool valid;
+   struct util_dynarray defs;
+} nir_live_defs_tracker;
+
+void nir_live_defs_tracker_init(nir_live_defs_tracker *tracker,
+                                nir_function_impl *impl);
+void nir_live_defs_tracker_add_def(nir_live_defs_tracker *tracker,
+                                   nir_def *def);
+void nir_live_defs_tracker_add_instr(nir_live_defs_tracker *tracker,
+                                     nir_instr *instr);
+nir_metadata nir_live_defs_tracker_finish(nir_live_defs_tracker *tracker);
+
 struct u_sparse_bitset *nir_get_live_defs(nir_cursor cursor, void *mem_ctx);
 
+/* Number of 32-bit registers a def takes in register pressure estimates. */
+static inline unsigned
+nir_def_pressure(const nir_def *def)
+{
+   return def->num_components * DIV_ROUND_UP(def->bit_size, 32);
+}
+
+/* Estimates the register pressure of an impl as the maximum of the sum of
+ * nir_def_pressure() over the defs live at any point.  If block_pressure
+ * isn't NULL, the maximum of each block is stored in it, indexed by block
+ * index.  This requires nir_metadata_live_defs and nir_metadata_block_index.
+ */
+unsigned nir_live_defs_max_pressure(nir_function_impl *impl,
+                                    unsigned *block_pressure);
+
 void nir_loop_analyze_impl(nir_function_impl *impl,
                            nir_variable_mode indirect_mask,
                            bool force_unroll_sampler_indirect);
@@ -6712,6 +6839,7 @@ bool nir_opt_copy_prop(nir_shader *shader);
 bool nir_opt_copy_prop_vars(nir_shader *shader);
 
 bool nir_opt_cse(nir_shader *shader);
+bool nir_opt_cse_global(nir_shader *shader);
 
 bool nir_opt_dce_impl(nir_function_impl *impl);
 bool nir_opt_dce(nir_shader *shader);
@@ -6728,7 +6856,23 @@ bool nir_opt_find_array_copies(nir_shader *shader);
 bool nir_def_is_frag_coord_z(nir_def *def);
 bool nir_opt_fragdepth(nir_shader *shader);
 
+typedef struct nir_opt_gcm_options {
+   /* Do full global value numbering rather than only merging identical
+    * instructions on both sides of an if.
+    */
+   bool value_number;
+
+   /* Number of 32-bit registers the backend can use without spilling, or 0
+    * to only rely on the loop size heuristic.  When set, instructions are
+    * only hoisted out of loops as long as the estimated pressure of the loops
+    * stays within the budget, and sunk into ifs from blocks which exceed it.
+    */
+   unsigned register_budget;
+} nir_opt_gcm_options;
+
 bool nir_opt_gcm(nir_shader *shader, bool value_number);
+bool nir_opt_gcm_pressure(nir_shader *shader,
+                          const nir_opt_gcm_options *options);
 
 bool nir_opt_generate_bfi(nir_shader *shader);
 
@@ -6912,6 +7056,10 @@ typedef struct nir_opt_load_skip_helpers_options {
 
 bool nir_opt_load_skip_helpers(nir_shader *shader, nir_opt_load_skip_helpers_options *options);
 
+void nir_optimize(nir_shader *nir, bool (*driver_pass)(nir_shader *nir),
+                  const char *driver_pass_name);
+void nir_optimize_late(nir_shader *nir);
+
 void nir_sweep(nir_shader *shader);
 
 nir_intrinsic_op nir_intrinsic_from_system_value(gl_system_value val);
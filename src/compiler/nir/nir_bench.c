@@ -0,0 +1,501 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Compile-time benchmark for NIR passes.
+ *
+ * Loads shaders serialized with nir_serialize(), given as files or as
+ * directories of such files, and times a driver-like pipeline of passes over
+ * them.  Every iteration runs on a fresh clone of the shader, so the numbers
+ * don't depend on the number of iterations.
+ *
+ * Besides the time, instruction count, estimated register pressure and
+ * number of ralloc and GC allocations of each shader, the statistics of
+ * every pass of the pipeline gathered by NIR_PASS are reported (see
+ * nir_pass_stats.c).  With -j, the results are printed as JSON, to keep
+ * track of compile times across versions.
+ *
+ * In debug builds, the time of the shaders includes the validation done by
+ * NIR_PASS, while the time of the passes doesn't.
+ *
+ * The register budget given with -b is used by the gcm pipeline, and the
+ * number of shaders whose pressure exceeds it, i.e. which would likely spill,
+ * is reported before and after the pipeline.
+ *
+ * With -l, the time it takes to load the shaders is measured instead, for
+ * the regular and the lazy serialization layouts.  The lazy numbers include
+ * loading the impls reachable from the entrypoints.
+ *
+ * Usage: nir_bench [-j] [-l] [-p pipeline] [-b budget] [-n iterations]
+ *                  <file|dir>...
+ */
+
+#include <dirent.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "compiler/glsl_types.h"
+#include "util/blob.h"
+#include "util/os_file.h"
+#include "util/os_time.h"
+#include "util/ralloc.h"
+#include "util/u_dynarray.h"
+#include "nir.h"
+#include "nir_serialize.h"
+
+static unsigned register_budget;
+
+static void
+run_algebraic(nir_shader *nir)
+{
+   bool progress;
+   do {
+      progress = false;
+      NIR_PASS(progress, nir, nir_opt_algebraic);
+   } while (progress);
+}
+
+/* The optimization loop and final cleanups of lavapipe, without the
+ * lavapipe specific passes.
+ */
+static void
+run_lvp(nir_shader *nir)
+{
+   nir_optimize(nir, NULL, NULL);
+   nir_optimize_late(nir);
+}
+
+static void
+run_gcm(nir_shader *nir)
+{
+   nir_opt_gcm_options options = {
+      .value_number = false,
+      .register_budget = register_budget,
+   };
+
+   NIR_PASS(_, nir, nir_opt_gcm_pressure, &options);
+}
+
+static const struct {
+   const char *name;
+   void (*run)(nir_shader *nir);
+} pipelines[] = {
+   { "algebraic", run_algebraic },
+   { "lvp", run_lvp },
+   { "gcm", run_gcm },
+};
+
+static unsigned
+max_pressure(nir_shader *nir)
+{
+   unsigned pressure = 0;
+
+   nir_foreach_function_impl(impl, nir) {
+      nir_metadata_require(impl, nir_metadata_block_index |
+                                 nir_metadata_live_defs);
+      pressure = MAX2(pressure, nir_live_defs_max_pressure(impl, NULL));
+   }
+
+   return pressure;
+}
+
+static void
+print_json_string(const char *str)
+{
+   putchar('"');
+   for (const char *c = str; *c; c++) {
+      if (*c == '"' || *c == '\\')
+         printf("\\%c", *c);
+      else if ((unsigned char)*c < 0x20)
+         printf("\\u%04x", *c);
+      else
+         putchar(*c);
+   }
+   putchar('"');
+}
+
+static int
+compare_strings(const void *a, const void *b)
+{
+   return strcmp(*(const char **)a, *(const char **)b);
+}
+
+/* Adds path to the list of files, or all the files it contains, sorted by
+ * name, if it is a directory.
+ */
+static bool
+add_files(struct util_dynarray *files, const char *path)
+{
+   struct stat st;
+   if (stat(path, &st)) {
+      fprintf(stderr, "Failed to stat %s\n", path);
+      return false;
+   }
+
+   if (!S_ISDIR(st.st_mode)) {
+      util_dynarray_append(files, ralloc_strdup(files->mem_ctx, path));
+      return true;
+   }
+
+   DIR *dir = opendir(path);
+   if (!dir) {
+      fprintf(stderr, "Failed to open %s\n", path);
+      return false;
+   }
+
+   unsigned first = util_dynarray_num_elements(files, char *);
+   struct dirent *entry;
+   while ((entry = readdir(dir))) {
+      if (entry->d_name[0] == '.')
+         continue;
+
+      char *file = ralloc_asprintf(files->mem_ctx, "%s/%s", path,
+                                   entry->d_name);
+      if (!stat(file, &st) && S_ISREG(st.st_mode))
+         util_dynarray_append(files, file);
+   }
+   closedir(dir);
+
+   unsigned count = util_dynarray_num_elements(files, char *) - first;
+   if (count) {
+      qsort(util_dynarray_element(files, char *, first), count,
+            sizeof(char *), compare_strings);
+   }
+
+   return true;
+}
+
+static nir_shader *
+load_shader(void *mem_ctx, const struct nir_shader_compiler_options *options,
+            const char *filename)
+{
+   size_t size;
+   char *data = os_read_file(filename, &size);
+   if (!data) {
+      fprintf(stderr, "Failed to read %s\n", filename);
+      return NULL;
+   }
+
+   struct blob_reader blob;
+   blob_reader_init(&blob, data, size);
+   nir_shader *nir = nir_deserialize(mem_ctx, options, &blob);
+   if (blob.overrun) {
+      fprintf(stderr, "%s is not a serialized NIR shader\n", filename);
+      ralloc_free(nir);
+      nir = NULL;
+   }
+
+   free(data);
+   return nir;
+}
+
+static int64_t
+time_load(const struct nir_shader_compiler_options *options,
+          const struct blob *blob, bool lazy, unsigned iterations)
+{
+   int64_t ns = 0;
+
+   for (unsigned it = 0; it < iterations; it++) {
+      struct blob_reader reader;
+      blob_reader_init(&reader, blob->data, blob->size);
+
+      int64_t start = os_time_get_nano();
+      nir_shader *nir;
+      if (lazy) {
+         nir_lazy_impls *impls;
+         bool ok = true;
+         nir = nir_deserialize_lazy(NULL, options, &reader, &impls);
+         if (!nir)
+            return -1;
+         nir_foreach_entrypoint(fxn, nir)
+            ok &= nir_lazy_impls_load_reachable(impls, fxn);
+         nir_lazy_impls_free(impls);
+
+         if (!ok) {
+            ralloc_free(nir);
+            return -1;
+         }
+      } else {
+         nir = nir_deserialize(NULL, options, &reader);
+      }
+      ns += os_time_get_nano() - start;
+
+      ralloc_free(nir);
+   }
+
+   return ns;
+}
+
+static void
+bench_load(const struct nir_shader_compiler_options *options,
+           nir_shader *nir, const char *name, unsigned iterations,
+           bool json, bool first)
+{
+   struct blob regular, lazy;
+   blob_init(&regular);
+   blob_init(&lazy);
+   nir_serialize(&regular, nir, false);
+   nir_serialize_lazy(&lazy, nir, false);
+
+   int64_t regular_ns = time_load(options, &regular, false, iterations);
+   int64_t lazy_ns = time_load(options, &lazy, true, iterations);
+   if (lazy_ns < 0) {
+      fprintf(stderr, "Failed to load the impls of %s\n", name);
+      exit(EXIT_FAILURE);
+   }
+
+   double regular_us = regular_ns / 1000.0 / iterations;
+   double lazy_us = lazy_ns / 1000.0 / iterations;
+
+   unsigned num_impls = 0;
+   nir_foreach_function_impl(impl, nir)
+      num_impls++;
+
+   if (json) {
+      printf("%s\n    {\"name\": ", first ? "" : ",");
+      print_json_string(name);
+      printf(", \"impls\": %u, \"regular_us\": %.1f, \"lazy_us\": %.1f}",
+             num_impls, regular_us, lazy_us);
+   } else {
+      printf("%-40s %8u %12.1f %12.1f\n", name, num_impls, regular_us,
+             lazy_us);
+   }
+
+   blob_finish(&regular);
+   blob_finish(&lazy);
+}
+
+struct pipeline_totals {
+   int64_t time_ns;
+   unsigned over_budget;
+   unsigned over_budget_after;
+};
+
+static void
+bench_pipeline(void (*run)(nir_shader *nir), nir_shader *nir,
+               const char *name, unsigned iterations, bool json, bool first,
+               struct pipeline_totals *totals)
+{
+   unsigned instrs_after = 0, pressure_after = 0;
+   uint64_t rallocs = 0, gc_allocs = 0;
+   int64_t ns = 0;
+
+   for (unsigned it = 0; it < iterations; it++) {
+      nir_shader *clone = nir_shader_clone(NULL, nir);
+
+      struct ralloc_alloc_counts allocs_start, allocs_end;
+      ralloc_get_alloc_counts(&allocs_start);
+      int64_t start = os_time_get_nano();
+
+      run(clone);
+
+      ns += os_time_get_nano() - start;
+      ralloc_get_alloc_counts(&allocs_end);
+      rallocs += allocs_end.ralloc - allocs_start.ralloc;
+      gc_allocs += allocs_end.gc - allocs_start.gc;
+
+      instrs_after = nir_shader_count_instrs(clone);
+      pressure_after = max_pressure(clone);
+      ralloc_free(clone);
+   }
+
+   unsigned pressure = max_pressure(nir);
+   totals->time_ns += ns;
+   if (register_budget) {
+      totals->over_budget += pressure > register_budget;
+      totals->over_budget_after += pressure_after > register_budget;
+   }
+
+   double us = ns / 1000.0 / iterations;
+   if (json) {
+      printf("%s\n    {\"name\": ", first ? "" : ",");
+      print_json_string(name);
+      printf(", \"instrs\": %u, \"instrs_after\": %u, \"pressure\": %u"
+             ", \"pressure_after\": %u, \"time_us\": %.1f"
+             ", \"ralloc_allocs\": %" PRIu64 ", \"gc_allocs\": %" PRIu64 "}",
+             nir_shader_count_instrs(nir), instrs_after, pressure,
+             pressure_after, us, rallocs / iterations, gc_allocs / iterations);
+   } else {
+      printf("%-40s %8u %8u %8u %8u %12.1f %10" PRIu64 " %10" PRIu64 "\n",
+             name, nir_shader_count_instrs(nir), instrs_after, pressure,
+             pressure_after, us, rallocs / iterations, gc_allocs / iterations);
+   }
+}
+
+/* All numbers are per iteration, the most expensive passes first. */
+static void
+print_pass_stats(unsigned iterations, bool json)
+{
+   unsigned count;
+   nir_pass_stats *stats = nir_pass_stats_get(NULL, &count);
+
+   if (!json) {
+      printf("\n%-40s %8s %8s %8s %8s %12s\n", "pass", "runs", "progress",
+             "skipped", "instrs", "us/iter");
+   }
+
+   for (unsigned i = 0; i < count; i++) {
+      const nir_pass_stats *pass = &stats[i];
+      double us = pass->time_ns / 1000.0 / iterations;
+
+      if (json) {
+         printf("%s\n    {\"name\": ", i ? "," : "");
+         print_json_string(pass->name);
+         printf(", \"runs\": %" PRIu64 ", \"progress\": %" PRIu64
+                ", \"skipped\": %" PRIu64 ", \"instr_delta\": %" PRId64
+                ", \"time_us\": %.1f}",
+                pass->calls / iterations, pass->progress / iterations,
+                pass->skipped / iterations, pass->instr_delta / iterations, us);
+      } else {
+         printf("%-40s %8" PRIu64 " %8" PRIu64 " %8" PRIu64 " %8" PRId64
+                " %12.1f\n", pass->name, pass->calls / iterations,
+                pass->progress / iterations, pass->skipped / iterations,
+                pass->instr_delta / iterations, us);
+      }
+   }
+
+   ralloc_free(stats);
+}
+
+static void
+usage(const char *name)
+{
+   fprintf(stderr,
+           "Usage: %s [-j] [-l] [-p pipeline] [-b budget] [-n iterations] "
+           "<file|dir>...\n", name);
+   fprintf(stderr, "Pipelines:");
+   for (unsigned i = 0; i < ARRAY_SIZE(pipelines); i++)
+      fprintf(stderr, " %s", pipelines[i].name);
+   fprintf(stderr, "\n");
+}
+
+int
+main(int argc, char **argv)
+{
+   const char *pipeline_name = pipelines[0].name;
+   unsigned iterations = 10;
+   bool load = false, json = false;
+   int opt;
+
+   while ((opt = getopt(argc, argv, "jlp:b:n:h")) != -1) {
+      switch (opt) {
+      case 'j':
+         json = true;
+         break;
+      case 'l':
+         load = true;
+         break;
+      case 'p':
+         pipeline_name = optarg;
+         break;
+      case 'b':
+         register_budget = strtoul(optarg, NULL, 0);
+         break;
+      case 'n':
+         iterations = strtoul(optarg, NULL, 0);
+         break;
+      default:
+         usage(argv[0]);
+         return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+      }
+   }
+
+   void (*run)(nir_shader *nir) = NULL;
+   for (unsigned i = 0; i < ARRAY_SIZE(pipelines); i++) {
+      if (!strcmp(pipelines[i].name, pipeline_name))
+         run = pipelines[i].run;
+   }
+
+   if (!run || optind == argc || !iterations) {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   void *mem_ctx = ralloc_context(NULL);
+   struct util_dynarray files;
+   util_dynarray_init(&files, mem_ctx);
+
+   int ret = EXIT_SUCCESS;
+   for (int i = optind; i < argc; i++) {
+      if (!add_files(&files, argv[i]))
+         ret = EXIT_FAILURE;
+   }
+
+   /* The options the shaders were compiled with aren't serialized, the
+    * passes only get the defaults.
+    */
+   static const struct nir_shader_compiler_options options = { 0 };
+   struct pipeline_totals totals = { 0 };
+   bool first = true;
+
+   glsl_type_singleton_init_or_ref();
+   nir_pass_stats_enable();
+   ralloc_enable_alloc_counts(true);
+
+   if (json) {
+      printf("{\n  \"mode\": \"%s\",\n", load ? "load" : "pipeline");
+      if (!load) {
+         printf("  \"pipeline\": ");
+         print_json_string(pipeline_name);
+         printf(",\n");
+      }
+      printf("  \"iterations\": %u,\n  \"shaders\": [", iterations);
+   } else if (load) {
+      printf("%-40s %8s %12s %12s\n", "shader", "impls", "regular us",
+             "lazy us");
+   } else {
+      printf("%-40s %8s %8s %8s %8s %12s %10s %10s\n", "shader", "instrs",
+             "after", "pressure", "after", "us/iter", "rallocs", "gc allocs");
+   }
+
+   util_dynarray_foreach(&files, char *, file) {
+      void *shader_ctx = ralloc_context(NULL);
+      nir_shader *nir = load_shader(shader_ctx, &options, *file);
+      if (!nir) {
+         ret = EXIT_FAILURE;
+         ralloc_free(shader_ctx);
+         continue;
+      }
+
+      if (load)
+         bench_load(&options, nir, *file, iterations, json, first);
+      else
+         bench_pipeline(run, nir, *file, iterations, json, first, &totals);
+      first = false;
+
+      ralloc_free(shader_ctx);
+   }
+
+   if (json) {
+      printf("\n  ]");
+      if (!load) {
+         printf(",\n  \"passes\": [");
+         print_pass_stats(iterations, true);
+         printf("\n  ],\n  \"total_time_us\": %.1f",
+                totals.time_ns / 1000.0 / iterations);
+         if (register_budget) {
+            printf(",\n  \"register_budget\": %u,\n  \"over_budget\": %u"
+                   ",\n  \"over_budget_after\": %u", register_budget,
+                   totals.over_budget, totals.over_budget_after);
+         }
+      }
+      printf("\n}\n");
+   } else if (!load) {
+      print_pass_stats(iterations, false);
+      printf("\ntotal: %.3f ms/iter\n",
+             totals.time_ns / 1000000.0 / iterations);
+      if (register_budget) {
+         printf("over a budget of %u registers: %u shaders before, %u after\n",
+                register_budget, totals.over_budget, totals.over_budget_after);
+      }
+   }
+
+   glsl_type_singleton_decref();
+   ralloc_free(mem_ctx);
+
+   return ret;
+}
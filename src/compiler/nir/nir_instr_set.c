@@ -98,11 +98,18 @@ hash_src(uint32_t hash, const nir_src *src)
 static uint32_t
 hash_alu_src(uint32_t hash, const nir_alu_src *src, unsigned num_components)
 {
-   for (unsigned i = 0; i < num_components; i++)
-      hash = HASH(hash, src->swizzle[i]);
-
-   hash = hash_src(hash, &src->src);
-   return hash;
+   /* Hash the source and its swizzle with a single XXH32 call, this is the
+    * hottest part of hashing and every call has a fixed cost.
+    */
+   struct alu_src_key {
+      const nir_def *ssa;
+      uint8_t swizzle[NIR_MAX_VEC_COMPONENTS];
+   } v;
+   v.ssa = src->src.ssa;
+   memcpy(v.swizzle, src->swizzle, num_components);
+
+   return XXH32(&v, offsetof(struct alu_src_key, swizzle) + num_components,
+                hash);
 }
 
 static uint32_t
@@ -772,12 +779,32 @@ cmp_func(const void *data1, const void *data2)
    return nir_instrs_equal(data1, data2);
 }
 
+static uint32_t
+hash_instr_cached(const void *data)
+{
+   /* Only the cached hash is written, the instruction isn't changed. */
+   nir_instr *instr = (nir_instr *)data;
+
+   if (!instr->hash) {
+      uint32_t hash = hash_instr(data);
+      instr->hash = hash ? hash : 1;
+   }
+
+   return instr->hash;
+}
+
 void
 nir_instr_set_init(struct set *s, void *mem_ctx)
 {
    _mesa_set_init(s, mem_ctx, hash_instr, cmp_func);
 }
 
+void
+nir_instr_set_init_cached(struct set *s, void *mem_ctx)
+{
+   _mesa_set_init(s, mem_ctx, hash_instr_cached, cmp_func);
+}
+
 void
 nir_instr_set_fini(struct set *instr_set)
 {
@@ -43,6 +43,13 @@
 /** Creates an instruction set, using a given ralloc mem_ctx */
 void nir_instr_set_init(struct set *s, void *mem_ctx);
 
+/**
+ * Like nir_instr_set_init(), but the hashes are kept in nir_instr::hash and
+ * reused by later sets, until the instruction changes.  The caller must
+ * require nir_metadata_instr_hash on the impl of the instructions.
+ */
+void nir_instr_set_init_cached(struct set *s, void *mem_ctx);
+
 /** Destroys an instruction set. */
 void nir_instr_set_fini(struct set *instr_set);
 
@@ -180,6 +180,182 @@ nir_live_defs_impl(nir_function_impl *impl)
    nir_block_worklist_fini(&state.worklist);
 }
 
+/*
+ * Incremental updates.
+ *
+ * The liveness of a single def can be recomputed by clearing it everywhere
+ * and walking backwards from each of its uses up to the block defining it.
+ * When a pass only touches a few defs, doing that for each of them is much
+ * cheaper than recomputing the sets of the whole impl.
+ */
+
+void
+nir_live_defs_tracker_init(nir_live_defs_tracker *tracker,
+                           nir_function_impl *impl)
+{
+   tracker->impl = impl;
+   tracker->valid = impl->valid_metadata & nir_metadata_live_defs;
+   util_dynarray_init(&tracker->defs, NULL);
+}
+
+void
+nir_live_defs_tracker_add_def(nir_live_defs_tracker *tracker, nir_def *def)
+{
+   if (!tracker->valid)
+      return;
+
+   assert(def->index != UINT_MAX);
+   util_dynarray_append(&tracker->defs, def->index);
+}
+
+static bool
+add_src_def(nir_src *src, void *tracker)
+{
+   nir_live_defs_tracker_add_def(tracker, src->ssa);
+   return true;
+}
+
+static bool
+add_def(nir_def *def, void *tracker)
+{
+   nir_live_defs_tracker_add_def(tracker, def);
+   return true;
+}
+
+void
+nir_live_defs_tracker_add_instr(nir_live_defs_tracker *tracker,
+                                nir_instr *instr)
+{
+   if (!tracker->valid)
+      return;
+
+   nir_foreach_def(instr, add_def, tracker);
+   nir_foreach_src(instr, add_src_def, tracker);
+}
+
+struct live_def_update {
+   nir_def *def;
+   nir_block *def_block;
+   bool is_phi;
+   struct util_dynarray stack;
+};
+
+static void
+mark_live_in(struct live_def_update *update, nir_block *block)
+{
+   /* Phi destinations are in the live-in of their block, other defs are
+    * killed there.
+    */
+   if (block == update->def_block && !update->is_phi)
+      return;
+
+   if (u_sparse_bitset_test(&block->live_in, update->def->index))
+      return;
+
+   u_sparse_bitset_set(&block->live_in, update->def->index);
+   if (block != update->def_block)
+      util_dynarray_append(&update->stack, block);
+}
+
+static void
+mark_live_out(struct live_def_update *update, nir_block *block)
+{
+   if (u_sparse_bitset_test(&block->live_out, update->def->index))
+      return;
+
+   u_sparse_bitset_set(&block->live_out, update->def->index);
+   mark_live_in(update, block);
+}
+
+static void
+update_def_liveness(nir_def *def, struct util_dynarray *stack)
+{
+   nir_instr *def_instr = nir_def_instr(def);
+
+   /* Undefs are never live. */
+   if (def_instr->type == nir_instr_type_undef)
+      return;
+
+   struct live_def_update update = {
+      .def = def,
+      .def_block = def_instr->block,
+      .is_phi = def_instr->type == nir_instr_type_phi,
+      .stack = *stack,
+   };
+
+   nir_foreach_use_including_if(src, def) {
+      nir_block *block = nir_src_get_block(src);
+
+      /* Phi sources are used at the end of the predecessor, if conditions
+       * at the end of the block preceding the if, but not across the edges.
+       */
+      if (!nir_src_is_if(src) &&
+          nir_src_parent_instr(src)->type == nir_instr_type_phi)
+         mark_live_out(&update, block);
+      else
+         mark_live_in(&update, block);
+
+      while (util_dynarray_num_elements(&update.stack, nir_block *)) {
+         nir_block *live = util_dynarray_pop(&update.stack, nir_block *);
+         nir_foreach_pred(pred, live)
+            mark_live_out(&update, pred);
+      }
+   }
+
+   *stack = update.stack;
+}
+
+nir_metadata
+nir_live_defs_tracker_finish(nir_live_defs_tracker *tracker)
+{
+   nir_function_impl *impl = tracker->impl;
+
+   if (!tracker->valid) {
+      util_dynarray_fini(&tracker->defs);
+      return nir_metadata_none;
+   }
+
+   if (!util_dynarray_num_elements(&tracker->defs, unsigned)) {
+      util_dynarray_fini(&tracker->defs);
+      impl->valid_metadata |= nir_metadata_live_defs;
+      return nir_metadata_live_defs;
+   }
+
+   BITSET_WORD *changed = BITSET_RZALLOC(NULL, impl->ssa_alloc);
+   util_dynarray_foreach(&tracker->defs, unsigned, index)
+      BITSET_SET(changed, *index);
+   util_dynarray_fini(&tracker->defs);
+
+   /* Forget what we knew about the recorded defs, including the removed
+    * ones.
+    */
+   nir_foreach_block(block, impl) {
+      unsigned i;
+      BITSET_FOREACH_SET(i, changed, impl->ssa_alloc) {
+         u_sparse_bitset_clear(&block->live_in, i);
+         u_sparse_bitset_clear(&block->live_out, i);
+      }
+   }
+
+   struct util_dynarray stack;
+   util_dynarray_init(&stack, NULL);
+
+   nir_foreach_block(block, impl) {
+      nir_foreach_instr(instr, block) {
+         nir_def *def = nir_instr_def(instr);
+         if (def && BITSET_TEST(changed, def->index))
+            update_def_liveness(def, &stack);
+      }
+   }
+
+   util_dynarray_fini(&stack);
+   ralloc_free(changed);
+
+   /* Inserting instructions drops the flag, so set it again. */
+   impl->valid_metadata |= nir_metadata_live_defs;
+   return nir_metadata_live_defs;
+}
+
 /** Return the live set at a cursor
  *
  * Note: The bitset returned may be the live_in or live_out from the block in
@@ -237,6 +413,95 @@ nir_get_live_defs(nir_cursor cursor, void *mem_ctx)
    return live;
 }
 
+struct pressure_state {
+   BITSET_WORD *live;
+   unsigned *def_pressure;
+   unsigned pressure;
+};
+
+static bool
+record_def_pressure(nir_def *def, void *void_state)
+{
+   struct pressure_state *state = void_state;
+   state->def_pressure[def->index] = nir_def_pressure(def);
+   return true;
+}
+
+static bool
+pressure_def_dead(nir_def *def, void *void_state)
+{
+   struct pressure_state *state = void_state;
+   if (BITSET_TEST(state->live, def->index)) {
+      BITSET_CLEAR(state->live, def->index);
+      state->pressure -= state->def_pressure[def->index];
+   }
+   return true;
+}
+
+static bool
+pressure_src_live(nir_src *src, void *void_state)
+{
+   struct pressure_state *state = void_state;
+   if (nir_src_is_undef(*src))
+      return true;
+
+   if (!BITSET_TEST(state->live, src->ssa->index)) {
+      BITSET_SET(state->live, src->ssa->index);
+      state->pressure += state->def_pressure[src->ssa->index];
+   }
+   return true;
+}
+
+unsigned
+nir_live_defs_max_pressure(nir_function_impl *impl, unsigned *block_pressure)
+{
+   assert(impl->valid_metadata & nir_metadata_live_defs);
+   assert(impl->valid_metadata & nir_metadata_block_index);
+
+   void *mem_ctx = ralloc_context(NULL);
+   struct pressure_state state = {
+      .live = BITSET_RZALLOC(mem_ctx, impl->ssa_alloc),
+      .def_pressure = rzalloc_array(mem_ctx, unsigned, impl->ssa_alloc),
+   };
+
+   nir_foreach_block(block, impl) {
+      nir_foreach_instr(instr, block)
+         nir_foreach_def(instr, record_def_pressure, &state);
+   }
+
+   unsigned max_pressure = 0;
+   nir_foreach_block(block, impl) {
+      /* Same walk as nir_live_defs_impl(), keeping a running sum. */
+      memset(state.live, 0, BITSET_BYTES(impl->ssa_alloc));
+      state.pressure = 0;
+      U_SPARSE_BITSET_FOREACH_SET(&block->live_out, i) {
+         BITSET_SET(state.live, i);
+         state.pressure += state.def_pressure[i];
+      }
+
+      nir_if *following_if = nir_block_get_following_if(block);
+      if (following_if)
+         pressure_src_live(&following_if->condition, &state);
+
+      unsigned max_block_pressure = state.pressure;
+      nir_foreach_instr_reverse(instr, block) {
+         if (instr->type == nir_instr_type_phi)
+            break;
+
+         nir_foreach_def(instr, pressure_def_dead, &state);
+         nir_foreach_src(instr, pressure_src_live, &state);
+         max_block_pressure = MAX2(max_block_pressure, state.pressure);
+      }
+
+      if (block_pressure)
+         block_pressure[block->index] = max_block_pressure;
+      max_pressure = MAX2(max_pressure, max_block_pressure);
+   }
+
+   ralloc_free(mem_ctx);
+   return max_pressure;
+}
+
 static bool
 src_does_not_use_def(nir_src *src, void *def)
 {
@@ -42,6 +42,12 @@ nir_metadata_require(nir_function_impl *impl, nir_metadata required, ...)
       nir_calc_dominance_lca_impl(impl);
    if (NEEDS_UPDATE(nir_metadata_live_defs))
       nir_live_defs_impl(impl);
+   if (NEEDS_UPDATE(nir_metadata_instr_hash)) {
+      nir_foreach_block(block, impl) {
+         nir_foreach_instr(instr, block)
+            instr->hash = 0;
+      }
+   }
    if (NEEDS_UPDATE(nir_metadata_divergence))
       nir_divergence_analysis_impl(impl,
                                    impl->function->shader->options->divergence_analysis_options);
@@ -73,7 +79,7 @@ nir_progress(bool progress, nir_function_impl *impl, nir_metadata preserved)
 {
    /* If we do not make progress, we preserve all metadata. */
    if (!progress)
-      preserved = nir_metadata_all;
+      preserved = nir_metadata_all | nir_metadata_instr_hash;
 
    if (!(preserved & nir_metadata_block_index))
       assert(!(preserved & nir_metadata_dominance));
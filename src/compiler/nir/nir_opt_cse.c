@@ -41,10 +41,17 @@
  *       %3 = iadd %0, %1 // keep, but replace %2 in the set
  *       %4 = iadd %0, %1 // eliminated
  *    }
- *    TODO: We could move %2 before "if" in this pass instead. It would also
- *          reduce register usage when %0 and %1 are no longer live in
- *          the range between "if" and %3, while only %2 would be live in that
- *          range.
+ *
+ * Example 5. Non-dominating situation with nir_opt_cse_global:
+ *    %2 = iadd %0, %1    // moved here from the then-branch
+ *    if {
+ *    } else {
+ *       %3 = iadd %0, %1 // eliminated
+ *    }
+ *    This is only done for ALU and load_const instructions directly in the
+ *    two branches of the same if, whose sources are then always available
+ *    before the if. It also reduces register usage when %0 and %1 are no
+ *    longer live after the if, while only %2 is live in that range.
  *
  * TODO - everything below is not implemented:
  *
@@ -76,27 +83,74 @@ dominates(const nir_instr *old_instr, const nir_instr *new_instr)
    return nir_block_dominates(old_instr->block, new_instr->block);
 }
 
+/* Returns the block before the if when the two instructions are directly in
+ * the two branches of the same if, and the old instruction can be moved to
+ * the end of that block.
+ */
+static nir_block *
+get_hoist_block(const nir_instr *old_instr, const nir_instr *new_instr)
+{
+   if (old_instr->type != nir_instr_type_alu &&
+       old_instr->type != nir_instr_type_load_const)
+      return NULL;
+
+   nir_cf_node *parent = old_instr->block->cf_node.parent;
+   if (parent->type != nir_cf_node_if ||
+       parent != new_instr->block->cf_node.parent)
+      return NULL;
+
+   /* Both blocks being in the same branch means that one dominates the
+    * other, so we don't get here in that case. Since the new instruction has
+    * the same sources and is in the other branch, all of them are defined
+    * before the if.
+    */
+   return nir_cf_node_as_block(nir_cf_node_prev(parent));
+}
+
+static bool
+dominates_or_can_hoist(const nir_instr *old_instr, const nir_instr *new_instr)
+{
+   return dominates(old_instr, new_instr) ||
+          get_hoist_block(old_instr, new_instr) != NULL;
+}
+
 static bool
-nir_opt_cse_impl(nir_function_impl *impl)
+nir_opt_cse_impl(nir_function_impl *impl, bool hoist)
 {
    struct set instr_set;
-   nir_instr_set_init(&instr_set, NULL);
+   nir_instr_set_init_cached(&instr_set, NULL);
 
    _mesa_set_resize(&instr_set, impl->ssa_alloc);
 
-   nir_metadata_require(impl, nir_metadata_dominance);
+   nir_metadata_require(impl, nir_metadata_dominance |
+                              nir_metadata_instr_hash);
 
    bool progress = false;
    nir_foreach_block(block, impl) {
       nir_foreach_instr_safe(instr, block) {
-         if (nir_instr_set_add_or_rewrite(&instr_set, instr, dominates)) {
-            progress = true;
-            nir_instr_remove(instr);
-         }
+         nir_instr *match =
+            nir_instr_set_add_or_rewrite(&instr_set, instr,
+                                         hoist ? dominates_or_can_hoist
+                                               : dominates);
+         if (!match)
+            continue;
+
+         /* The uses of instr now use match, move it where it dominates
+          * them.
+          */
+         if (hoist && !dominates(match, instr))
+            nir_instr_move(nir_after_block(get_hoist_block(match, instr)), match);
+
+         progress = true;
+         nir_instr_remove(instr);
       }
    }
 
-   nir_progress(progress, impl, nir_metadata_control_flow);
+   /* Moving instructions doesn't change the control flow, and the sources
+    * are only changed through nir_src_rewrite().
+    */
+   nir_progress(progress, impl, nir_metadata_control_flow |
+                                nir_metadata_instr_hash);
 
    nir_instr_set_fini(&instr_set);
    return progress;
@@ -108,7 +162,22 @@ nir_opt_cse(nir_shader *shader)
    bool progress = false;
 
    nir_foreach_function_impl(impl, shader) {
-      progress |= nir_opt_cse_impl(impl);
+      progress |= nir_opt_cse_impl(impl, false);
+   }
+
+   return progress;
+}
+
+/* Like nir_opt_cse, but also merges identical ALU instructions in the two
+ * branches of an if by moving one of them before the if (see example 5).
+ */
+bool
+nir_opt_cse_global(nir_shader *shader)
+{
+   bool progress = false;
+
+   nir_foreach_function_impl(impl, shader) {
+      progress |= nir_opt_cse_impl(impl, true);
    }
 
    return progress;
@@ -244,6 +244,9 @@ nir_opt_dce_impl(nir_function_impl *impl)
 
    BITSET_WORD *defs_live = BITSET_RZALLOC(NULL, impl->ssa_alloc);
 
+   nir_live_defs_tracker live_defs;
+   nir_live_defs_tracker_init(&live_defs, impl);
+
    struct exec_list dead_instrs;
    exec_list_make_empty(&dead_instrs);
 
@@ -253,9 +256,18 @@ nir_opt_dce_impl(nir_function_impl *impl)
 
    ralloc_free(defs_live);
 
+   /* Removing dead instructions only shortens the live ranges of their
+    * sources, which is cheap to patch up.
+    */
+   foreach_list_typed(nir_instr, instr, node, &dead_instrs)
+      nir_live_defs_tracker_add_instr(&live_defs, instr);
+   nir_metadata live_metadata = nir_live_defs_tracker_finish(&live_defs);
+
    nir_instr_free_list(&dead_instrs);
 
-   return nir_progress(progress, impl, nir_metadata_control_flow);
+   return nir_progress(progress, impl,
+                       nir_metadata_control_flow | nir_metadata_instr_hash |
+                       live_metadata);
 }
 
 bool
@@ -36,11 +36,21 @@
 /* This is used to stop GCM moving instruction out of a loop if the loop
  * contains too many instructions and moving them would create excess spilling.
  *
- * TODO: Figure out a better way to decide if we should remove instructions from
- * a loop.
+ * This is only used when the driver doesn't give a register budget, see
+ * nir_opt_gcm_options::register_budget.
  */
 #define MAX_LOOP_INSTRUCTIONS 100
 
+struct gcm_loop_info {
+   /* The loop this loop is nested inside or NULL */
+   struct gcm_loop_info *parent;
+
+   /* Estimated register pressure of the loop body, including the defs
+    * hoisted out of it so far.
+    */
+   unsigned pressure;
+};
+
 struct gcm_block_info {
    /* Number of loops this block is inside */
    unsigned loop_depth;
@@ -52,6 +62,10 @@ struct gcm_block_info {
 
    /* The loop the block is nested inside or NULL */
    nir_loop *loop;
+   struct gcm_loop_info *loop_info;
+
+   /* Estimated register pressure, only computed with a register budget */
+   unsigned pressure;
 
    /* The last instruction inserted into this block.  This is used as we
     * traverse the instructions and insert them back into the program to
@@ -79,6 +93,8 @@ struct gcm_state {
 
    bool progress;
 
+   unsigned register_budget;
+
    /* The list of non-pinned instructions.  As we do the late scheduling,
     * we pull non-pinned instructions out of their blocks and place them in
     * this list.  This saves us from having linked-list problems when we go
@@ -128,7 +144,8 @@ get_loop_instr_count(struct exec_list *cf_list)
 /* Recursively walks the CFG and builds the block_info structure */
 static void
 gcm_build_block_info(struct exec_list *cf_list, struct gcm_state *state,
-                     nir_loop *loop, unsigned loop_depth, unsigned if_depth,
+                     nir_loop *loop, struct gcm_loop_info *loop_info,
+                     unsigned loop_depth, unsigned if_depth,
                      unsigned loop_instr_count)
 {
    foreach_list_typed(nir_cf_node, node, node, cf_list) {
@@ -139,21 +156,25 @@ gcm_build_block_info(struct exec_list *cf_list, struct gcm_state *state,
          state->blocks[block->index].loop_depth = loop_depth;
          state->blocks[block->index].loop_instr_count = loop_instr_count;
          state->blocks[block->index].loop = loop;
+         state->blocks[block->index].loop_info = loop_info;
          break;
       }
       case nir_cf_node_if: {
          nir_if *if_stmt = nir_cf_node_as_if(node);
-         gcm_build_block_info(&if_stmt->then_list, state, loop, loop_depth,
-                              if_depth + 1, ~0u);
-         gcm_build_block_info(&if_stmt->else_list, state, loop, loop_depth,
-                              if_depth + 1, ~0u);
+         gcm_build_block_info(&if_stmt->then_list, state, loop, loop_info,
+                              loop_depth, if_depth + 1, ~0u);
+         gcm_build_block_info(&if_stmt->else_list, state, loop, loop_info,
+                              loop_depth, if_depth + 1, ~0u);
          break;
       }
       case nir_cf_node_loop: {
          nir_loop *loop = nir_cf_node_as_loop(node);
          assert(!nir_loop_has_continue_construct(loop));
-         gcm_build_block_info(&loop->body, state, loop, loop_depth + 1, if_depth,
-                              get_loop_instr_count(&loop->body));
+         struct gcm_loop_info *info = rzalloc(state->blocks,
+                                              struct gcm_loop_info);
+         info->parent = loop_info;
+         gcm_build_block_info(&loop->body, state, loop, info, loop_depth + 1,
+                              if_depth, get_loop_instr_count(&loop->body));
          break;
       }
       default:
@@ -162,6 +183,61 @@ gcm_build_block_info(struct exec_list *cf_list, struct gcm_state *state,
    }
 }
 
+/* Estimates the register pressure of every block and loop from the liveness
+ * before anything is moved.
+ */
+static void
+gcm_compute_pressure(nir_function_impl *impl, struct gcm_state *state)
+{
+   nir_metadata_require(impl, nir_metadata_live_defs);
+
+   unsigned *block_pressure = ralloc_array(NULL, unsigned, impl->num_blocks);
+   nir_live_defs_max_pressure(impl, block_pressure);
+
+   nir_foreach_block(block, impl) {
+      struct gcm_block_info *info = &state->blocks[block->index];
+      info->pressure = block_pressure[block->index];
+
+      for (struct gcm_loop_info *loop = info->loop_info; loop;
+           loop = loop->parent)
+         loop->pressure = MAX2(loop->pressure, info->pressure);
+   }
+
+   ralloc_free(block_pressure);
+}
+
+/* The def of a hoisted instruction is live through all of the loops it is
+ * hoisted out of, so it adds to the pressure of all of them.
+ */
+static bool
+gcm_hoist_fits_budget(struct gcm_state *state, nir_instr *instr,
+                      nir_block *block)
+{
+   nir_def *def = nir_instr_def(instr);
+   unsigned pressure = def ? nir_def_pressure(def) : 0;
+   struct gcm_loop_info *target = state->blocks[block->index].loop_info;
+
+   for (struct gcm_loop_info *loop = state->blocks[instr->block->index].loop_info;
+        loop && loop != target; loop = loop->parent) {
+      if (loop->pressure + pressure > state->register_budget)
+         return false;
+   }
+
+   return true;
+}
+
+static void
+gcm_account_hoist(struct gcm_state *state, nir_instr *instr, nir_block *block)
+{
+   nir_def *def = nir_instr_def(instr);
+   unsigned pressure = def ? nir_def_pressure(def) : 0;
+   struct gcm_loop_info *target = state->blocks[block->index].loop_info;
+
+   for (struct gcm_loop_info *loop = state->blocks[instr->block->index].loop_info;
+        loop && loop != target; loop = loop->parent)
+      loop->pressure += pressure;
+}
+
 static bool
 is_src_scalarizable(nir_src *src)
 {
@@ -508,14 +584,15 @@ set_block_for_loop_instr(struct gcm_state *state, nir_instr *instr,
     * the workgroup id, subgroup id and subgroup invocation, pulling all
     * these calculations outside the loop causes register pressure.
     *
-    * To work around these issues for now we only allow constant and texture
-    * instructions to be moved outside their original loops, or instructions
-    * where the total loop instruction count is less than
+    * With a register budget, we hoist as long as the estimated pressure of
+    * the loops stays within it.  Otherwise, we only allow constant and
+    * texture instructions to be moved outside their original loops, or
+    * instructions where the total loop instruction count is less than
     * MAX_LOOP_INSTRUCTIONS.
-    *
-    * TODO: figure out some more heuristics to allow more to be moved out of
-    * loops.
     */
+   if (state->register_budget)
+      return gcm_hoist_fits_budget(state, instr, block);
+
    if (state->blocks[instr->block->index].loop_instr_count < MAX_LOOP_INSTRUCTIONS)
       return true;
 
@@ -539,6 +616,13 @@ set_block_to_if_block(struct gcm_state *state, nir_instr *instr,
        nir_instr_as_intrinsic(instr)->intrinsic == nir_intrinsic_resource_intel)
       return true;
 
+   /* Sinking into an if shortens the live range of the def on the paths
+    * which don't use it, which is worth it when the block is over budget.
+    */
+   if (state->register_budget &&
+       state->blocks[instr->block->index].pressure > state->register_budget)
+      return true;
+
    /* TODO: Figure out some more heuristics to allow more to be moved into
     * if-statements.
     */
@@ -684,8 +768,11 @@ gcm_schedule_late_def(nir_def *def, void *void_state)
    nir_block *best_block =
       gcm_choose_block_for_instr(nir_def_instr(def), early_block, lca, state);
 
-   if (nir_def_block(def) != best_block)
+   if (nir_def_block(def) != best_block) {
+      if (state->register_budget)
+         gcm_account_hoist(state, nir_def_instr(def), best_block);
       state->progress = true;
+   }
 
    nir_def_instr(def)->block = best_block;
 
@@ -798,7 +885,8 @@ weak_gvn(const nir_instr *a, const nir_instr *b)
 }
 
 static bool
-opt_gcm_impl(nir_shader *shader, nir_function_impl *impl, bool value_number)
+opt_gcm_impl(nir_shader *shader, nir_function_impl *impl,
+             const nir_opt_gcm_options *options)
 {
    nir_metadata_require(impl, nir_metadata_block_index |
                               nir_metadata_dominance |
@@ -817,10 +905,14 @@ opt_gcm_impl(nir_shader *shader, nir_function_impl *impl, bool value_number)
    state.impl = impl;
    state.instr = NULL;
    state.progress = false;
+   state.register_budget = options->register_budget;
    exec_list_make_empty(&state.instrs);
    state.blocks = rzalloc_array(NULL, struct gcm_block_info, impl->num_blocks);
 
-   gcm_build_block_info(&impl->body, &state, NULL, 0, 0, ~0u);
+   gcm_build_block_info(&impl->body, &state, NULL, NULL, 0, 0, ~0u);
+
+   if (state.register_budget)
+      gcm_compute_pressure(impl, &state);
 
    gcm_pin_instructions(impl, &state);
 
@@ -845,7 +937,7 @@ opt_gcm_impl(nir_shader *shader, nir_function_impl *impl, bool value_number)
          continue;
 
       if (nir_instr_set_add_or_rewrite(&gvn_set, instr,
-                                       value_number ? NULL : weak_gvn)) {
+                                       options->value_number ? NULL : weak_gvn)) {
          state.progress = true;
          nir_instr_remove(instr);
       }
@@ -878,13 +970,23 @@ opt_gcm_impl(nir_shader *shader, nir_function_impl *impl, bool value_number)
 }
 
 bool
-nir_opt_gcm(nir_shader *shader, bool value_number)
+nir_opt_gcm_pressure(nir_shader *shader, const nir_opt_gcm_options *options)
 {
    bool progress = false;
 
    nir_foreach_function_impl(impl, shader) {
-      progress |= opt_gcm_impl(shader, impl, value_number);
+      progress |= opt_gcm_impl(shader, impl, options);
    }
 
    return progress;
 }
+
+bool
+nir_opt_gcm(nir_shader *shader, bool value_number)
+{
+   nir_opt_gcm_options options = {
+      .value_number = value_number,
+   };
+
+   return nir_opt_gcm_pressure(shader, &options);
+}
@@ -5378,6 +5378,12 @@ nir_opt_varyings(nir_shader *producer, nir_shader *consumer, bool spirv,
     *   that there is exactly 1 load per input
     */
    if (prop_dedup_consumer_progress) {
+      /* Input loads were changed in place, so the instruction hashes cached
+       * by nir_opt_cse are stale.
+       */
+      nir_progress(true, nir_shader_get_entrypoint(consumer),
+                   nir_metadata_control_flow);
+
       bool opts_progress;
       do {
          opts_progress = false;
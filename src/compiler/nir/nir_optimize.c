@@ -0,0 +1,106 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+/* A generic optimization loop for drivers with a scalar backend, used by
+ * lavapipe and by nir_bench.
+ */
+
+#include "nir.h"
+
+#include "util/set.h"
+
+/**
+ * Run the common optimizations until none of them makes progress.
+ *
+ * \p driver_pass, if not NULL, is run at the end of every iteration, for
+ * driver lowering which the loop should clean up after.  It shows up as
+ * \p driver_pass_name in the NIR_DEBUG output and the pass statistics.
+ */
+void
+nir_optimize(nir_shader *nir, bool (*driver_pass)(nir_shader *nir),
+             const char *driver_pass_name)
+{
+   /* Passes are skipped until another pass makes progress, see
+    * NIR_LOOP_PASS.
+    */
+   struct set *skip = _mesa_pointer_set_create(NULL);
+   bool progress = false;
+   do {
+      progress = false;
+
+      NIR_LOOP_PASS(progress, skip, nir, nir_lower_flrp, 16|32|64, true);
+      NIR_LOOP_PASS(progress, skip, nir, nir_split_array_vars, nir_var_function_temp);
+      NIR_LOOP_PASS(progress, skip, nir, nir_shrink_vec_array_vars, nir_var_function_temp);
+      NIR_LOOP_PASS_NOT_IDEMPOTENT(progress, skip, nir, nir_opt_deref);
+      NIR_LOOP_PASS(progress, skip, nir, nir_lower_vars_to_ssa);
+
+      NIR_LOOP_PASS(progress, skip, nir, nir_opt_copy_prop_vars);
+
+      NIR_LOOP_PASS(progress, skip, nir, nir_opt_copy_prop);
+      NIR_LOOP_PASS(progress, skip, nir, nir_opt_dce);
+
+      nir_opt_peephole_select_options peephole_select_options = {
+         .limit = 8,
+         .indirect_load_ok = true,
+         .expensive_alu_ok = true,
+      };
+      NIR_LOOP_PASS(progress, skip, nir, nir_opt_peephole_select, &peephole_select_options);
+
+      NIR_LOOP_PASS_NOT_IDEMPOTENT(progress, skip, nir, nir_opt_algebraic);
+      NIR_LOOP_PASS(progress, skip, nir, nir_opt_constant_folding);
+
+      NIR_LOOP_PASS(progress, skip, nir, nir_opt_remove_phis);
+      bool loop = false;
+      NIR_LOOP_PASS_NOT_IDEMPOTENT(loop, skip, nir, nir_opt_loop);
+      progress |= loop;
+      if (loop) {
+         /* If nir_opt_loop makes progress, then we need to clean
+          * things up if we want any hope of nir_opt_if or nir_opt_loop_unroll
+          * to make progress.
+          */
+         NIR_LOOP_PASS(progress, skip, nir, nir_opt_copy_prop);
+         NIR_LOOP_PASS(progress, skip, nir, nir_opt_dce);
+         NIR_LOOP_PASS(progress, skip, nir, nir_opt_remove_phis);
+      }
+      NIR_LOOP_PASS_NOT_IDEMPOTENT(progress, skip, nir, nir_opt_if, nir_opt_if_optimize_phi_true_false);
+      NIR_LOOP_PASS(progress, skip, nir, nir_opt_dead_cf);
+
+      /* This runs nir_opt_peephole_select again with different options, so
+       * it can't share its entry in the skip set.
+       */
+      nir_opt_peephole_select_options peephole_discard_options = {
+         .limit = 0,
+         .discard_ok = true,
+      };
+      bool discard = false;
+      NIR_PASS(discard, nir, nir_opt_peephole_select, &peephole_discard_options);
+      if (discard) {
+         _mesa_set_clear(skip, NULL);
+         progress = true;
+      }
+      NIR_LOOP_PASS(progress, skip, nir, nir_opt_remove_phis);
+      NIR_LOOP_PASS(progress, skip, nir, nir_opt_cse_global);
+      NIR_LOOP_PASS(progress, skip, nir, nir_opt_undef);
+
+      NIR_LOOP_PASS_NOT_IDEMPOTENT(progress, skip, nir, nir_opt_deref);
+      NIR_LOOP_PASS(progress, skip, nir, nir_lower_alu_to_scalar, NULL, NULL);
+      NIR_LOOP_PASS_NOT_IDEMPOTENT(progress, skip, nir, nir_opt_loop_unroll);
+      if (driver_pass)
+         NIR_LOOP_PASS_NAMED(progress, skip, nir, driver_pass_name, driver_pass);
+   } while (progress);
+
+   _mesa_set_destroy(skip, NULL);
+}
+
+/** Final cleanups after nir_optimize(), once no more lowering is needed. */
+void
+nir_optimize_late(nir_shader *nir)
+{
+   NIR_PASS(_, nir, nir_opt_algebraic_late);
+   NIR_PASS(_, nir, nir_opt_dce);
+   NIR_PASS(_, nir, nir_lower_var_copies);
+   NIR_PASS(_, nir, nir_remove_dead_variables, nir_var_function_temp, NULL);
+   NIR_PASS(_, nir, nir_opt_dce);
+   nir_sweep(nir);
+}
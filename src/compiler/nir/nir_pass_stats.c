@@ -0,0 +1,190 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Per-pass statistics gathered by NIR_PASS.
+ *
+ * Every pass is accounted under its name, no matter which shader or call
+ * site it was run from.  "skipped" counts the NIR_LOOP_PASS invocations that
+ * did not run the pass because nothing changed since its last run, "time_ns"
+ * only covers the pass itself (not validation or printing), and
+ * "instr_delta" is the sum of the changes in the number of instructions of
+ * the shader.
+ *
+ * In debug builds, setting NIR_PASS_STATS makes the totals be written as CSV
+ * to the file it names when the process exits:
+ *
+ *    pass,calls,progress,skipped,time_ns,instr_delta
+ *
+ * Tools can collect them in any build with nir_pass_stats_enable() and
+ * nir_pass_stats_get().
+ */
+
+#include "nir.h"
+
+#include "util/hash_table.h"
+#include "util/os_time.h"
+#include "util/simple_mtx.h"
+
+bool nir_pass_stats_enabled = false;
+
+static const char *stats_filename;
+static simple_mtx_t stats_lock = SIMPLE_MTX_INITIALIZER;
+static struct hash_table *stats;
+
+static int
+compare_stats(const void *_a, const void *_b)
+{
+   const nir_pass_stats *a = _a;
+   const nir_pass_stats *b = _b;
+
+   if (a->time_ns != b->time_ns)
+      return a->time_ns < b->time_ns ? 1 : -1;
+   return strcmp(a->name, b->name);
+}
+
+/* Must be called with stats_lock held. */
+static nir_pass_stats *
+get_sorted_stats(void *mem_ctx, unsigned *count)
+{
+   *count = stats ? _mesa_hash_table_num_entries(stats) : 0;
+
+   nir_pass_stats *sorted = ralloc_array(mem_ctx, nir_pass_stats, *count);
+   if (!sorted) {
+      *count = 0;
+      return NULL;
+   }
+
+   unsigned i = 0;
+   hash_table_foreach(stats, entry)
+      sorted[i++] = *(nir_pass_stats *)entry->data;
+
+   /* Sort by time, the most expensive passes are what one looks for. */
+   qsort(sorted, *count, sizeof(*sorted), compare_stats);
+   return sorted;
+}
+
+/**
+ * Returns a copy of the statistics of all the passes run so far, the most
+ * expensive first.
+ */
+nir_pass_stats *
+nir_pass_stats_get(void *mem_ctx, unsigned *count)
+{
+   simple_mtx_lock(&stats_lock);
+   nir_pass_stats *sorted = get_sorted_stats(mem_ctx, count);
+   simple_mtx_unlock(&stats_lock);
+
+   return sorted;
+}
+
+static void
+write_stats(void)
+{
+   simple_mtx_lock(&stats_lock);
+
+   FILE *f = stats ? fopen(stats_filename, "w") : NULL;
+   if (!f) {
+      if (stats)
+         fprintf(stderr, "NIR: failed to open %s\n", stats_filename);
+      goto out;
+   }
+
+   unsigned count;
+   nir_pass_stats *sorted = get_sorted_stats(NULL, &count);
+   fprintf(f, "pass,calls,progress,skipped,time_ns,instr_delta\n");
+   for (unsigned i = 0; i < count; i++) {
+      fprintf(f, "%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRId64 ",%" PRId64 "\n",
+              sorted[i].name, sorted[i].calls, sorted[i].progress,
+              sorted[i].skipped, sorted[i].time_ns, sorted[i].instr_delta);
+   }
+   ralloc_free(sorted);
+   fclose(f);
+
+out:
+   _mesa_hash_table_destroy(stats, NULL);
+   stats = NULL;
+   nir_pass_stats_enabled = false;
+   simple_mtx_unlock(&stats_lock);
+}
+
+/** Start gathering statistics, if they aren't already. */
+void
+nir_pass_stats_enable(void)
+{
+   simple_mtx_lock(&stats_lock);
+   if (!stats) {
+      stats = _mesa_hash_table_create(NULL, _mesa_hash_string,
+                                      _mesa_key_string_equal);
+   }
+   nir_pass_stats_enabled = stats != NULL;
+   simple_mtx_unlock(&stats_lock);
+}
+
+void
+nir_pass_stats_init(void)
+{
+   stats_filename = os_get_option("NIR_PASS_STATS");
+   if (!stats_filename || !stats_filename[0])
+      return;
+
+   nir_pass_stats_enable();
+   if (nir_pass_stats_enabled)
+      atexit(write_stats);
+}
+
+/* Must be called with stats_lock held. */
+static nir_pass_stats *
+get_pass_stats(const char *name)
+{
+   if (!stats)
+      return NULL;
+
+   struct hash_entry *entry = _mesa_hash_table_search(stats, name);
+   if (entry)
+      return entry->data;
+
+   nir_pass_stats *pass = rzalloc(stats, nir_pass_stats);
+   if (!pass)
+      return NULL;
+
+   pass->name = name;
+   _mesa_hash_table_insert(stats, name, pass);
+   return pass;
+}
+
+void
+_nir_pass_stats_begin(nir_shader *shader, nir_pass_stats_scope *scope)
+{
+   scope->num_instrs = nir_shader_count_instrs(shader);
+   scope->start_ns = os_time_get_nano();
+}
+
+void
+_nir_pass_stats_end(nir_shader *shader, nir_pass_stats_scope *scope,
+                    const char *name, bool progress)
+{
+   int64_t time_ns = os_time_get_nano() - scope->start_ns;
+   int64_t instr_delta =
+      progress ? (int64_t)nir_shader_count_instrs(shader) - scope->num_instrs : 0;
+
+   simple_mtx_lock(&stats_lock);
+   nir_pass_stats *pass = get_pass_stats(name);
+   if (pass) {
+      pass->calls++;
+      pass->progress += progress;
+      pass->time_ns += time_ns;
+      pass->instr_delta += instr_delta;
+   }
+   simple_mtx_unlock(&stats_lock);
+}
+
+void
+_nir_pass_stats_skip(const char *name)
+{
+   simple_mtx_lock(&stats_lock);
+   nir_pass_stats *pass = get_pass_stats(name);
+   if (pass)
+      pass->skipped++;
+   simple_mtx_unlock(&stats_lock);
+}
@@ -202,6 +202,16 @@ match_value(const nir_algebraic_table *table,
 {
    uint8_t new_swizzle[NIR_MAX_VEC_COMPONENTS];
 
+   /* If the value has a specific bit size and it doesn't match, bail */
+   if (value->bit_size > 0 &&
+       nir_src_bit_size(instr->src[src].src) != value->bit_size)
+      return false;
+
+   /* Same if it's an expression and the source isn't an ALU instruction. */
+   if (value->type == nir_search_value_expression &&
+       !nir_src_is_alu(instr->src[src].src))
+      return false;
+
    /* If the source is an explicitly sized source, then we need to reset
     * both the number of components and the swizzle.
     */
@@ -213,15 +223,8 @@ match_value(const nir_algebraic_table *table,
    for (unsigned i = 0; i < num_components; ++i)
       new_swizzle[i] = instr->src[src].swizzle[swizzle[i]];
 
-   /* If the value has a specific bit size and it doesn't match, bail */
-   if (value->bit_size > 0 &&
-       nir_src_bit_size(instr->src[src].src) != value->bit_size)
-      return false;
-
    switch (value->type) {
    case nir_search_value_expression:
-      if (!nir_src_is_alu(instr->src[src].src))
-         return false;
 
       return match_expression(table, nir_search_value_as_expression(value),
                               nir_def_as_alu(instr->src[src].src.ssa),
@@ -313,14 +316,15 @@ match_value(const nir_algebraic_table *table,
    }
 }
 
+/* Checks the instruction itself against the expression, but not its
+ * sources.  This doesn't depend on the match state, so it only needs to be
+ * done once for all the commutative variants of a root expression.
+ */
 static bool
-match_expression(const nir_algebraic_table *table, const nir_search_expression *expr, nir_alu_instr *instr,
-                 unsigned num_components, const uint8_t *swizzle,
-                 struct match_state *state)
+match_expression_instr(const nir_algebraic_table *table, const nir_search_expression *expr,
+                       const nir_alu_instr *instr, unsigned num_components,
+                       const uint8_t *swizzle)
 {
-   if (expr->cond_index != -1 && !table->expression_cond[expr->cond_index](instr))
-      return false;
-
    if (!nir_op_matches_search_op(instr->op, expr->opcode))
       return false;
 
@@ -331,8 +335,6 @@ match_expression(const nir_algebraic_table *table, const nir_search_expression *
    if (expr->fp_math_ctrl_exclude & instr->fp_math_ctrl)
       return false;
 
-   state->fp_math_ctrl |= instr->fp_math_ctrl;
-
    assert(nir_op_infos[instr->op].num_inputs > 0);
 
    /* If we have an explicitly sized destination, we can only handle the
@@ -354,6 +356,20 @@ match_expression(const nir_algebraic_table *table, const nir_search_expression *
       }
    }
 
+   /* Conditions typically walk the uses of the instruction, so check them
+    * last.
+    */
+   if (expr->cond_index != -1 && !table->expression_cond[expr->cond_index](instr))
+      return false;
+
+   return true;
+}
+
+static bool
+match_expression_srcs(const nir_algebraic_table *table, const nir_search_expression *expr,
+                      nir_alu_instr *instr, unsigned num_components,
+                      const uint8_t *swizzle, struct match_state *state)
+{
    /* If this is a commutative expression and it's one of the first few, look
     * up its direction for the current search operation.  We'll use that value
     * to possibly flip the sources for the match.
@@ -364,7 +380,6 @@ match_expression(const nir_algebraic_table *table, const nir_search_expression *
          ? ((state->comm_op_direction >> expr->comm_expr_idx) & 1)
          : 0;
 
-   bool matched = true;
    for (unsigned i = 0; i < nir_op_infos[instr->op].num_inputs; i++) {
       /* If src1 of the search expression is a constant, check that first since it's faster. */
       unsigned src_idx = i < 2 ? i ^ expr->src1_is_const : i;
@@ -374,13 +389,25 @@ match_expression(const nir_algebraic_table *table, const nir_search_expression *
        */
       if (!match_value(table, &state->table->values[expr->srcs[src_idx]].value, instr,
                        i < 2 ? src_idx ^ comm_op_flip : src_idx,
-                       num_components, swizzle, state)) {
-         matched = false;
-         break;
-      }
+                       num_components, swizzle, state))
+         return false;
    }
 
-   return matched;
+   return true;
+}
+
+static bool
+match_expression(const nir_algebraic_table *table, const nir_search_expression *expr, nir_alu_instr *instr,
+                 unsigned num_components, const uint8_t *swizzle,
+                 struct match_state *state)
+{
+   if (!match_expression_instr(table, expr, instr, num_components, swizzle))
+      return false;
+
+   state->fp_math_ctrl |= instr->fp_math_ctrl;
+
+   return match_expression_srcs(table, expr, instr, num_components, swizzle,
+                                state);
 }
 
 static unsigned
@@ -645,6 +672,15 @@ nir_replace_instr(nir_builder *build, nir_alu_instr *instr,
 
    STATIC_ASSERT(sizeof(state.comm_op_direction) * 8 >= NIR_SEARCH_MAX_COMM_OPS);
 
+   /* Most candidate transforms are rejected by the root instruction alone,
+    * check it before trying every combination of commutative sources.
+    */
+   if (!match_expression_instr(table, search, instr,
+                               instr->def.num_components, identity_swizzle))
+      return false;
+
+   state.fp_math_ctrl |= instr->fp_math_ctrl;
+
    unsigned comm_expr_combinations =
       1 << MIN2(search->comm_exprs, NIR_SEARCH_MAX_COMM_OPS);
 
@@ -656,9 +692,9 @@ nir_replace_instr(nir_builder *build, nir_alu_instr *instr,
       state.comm_op_direction = comb;
       state.variables_seen = 0;
 
-      if (match_expression(table, search, instr,
-                           instr->def.num_components,
-                           identity_swizzle, &state)) {
+      if (match_expression_srcs(table, search, instr,
+                                instr->def.num_components,
+                                identity_swizzle, &state)) {
          found = true;
          break;
       }
@@ -903,5 +939,9 @@ nir_algebraic_impl(nir_function_impl *impl,
    nir_free_fp_analysis_state(&range_ht);
    util_dynarray_fini(&states);
 
-   return nir_progress(progress, impl, nir_metadata_control_flow);
+   /* Replacements are new instructions, and the uses of the old ones are
+    * changed with nir_src_rewrite().
+    */
+   return nir_progress(progress, impl, nir_metadata_control_flow |
+                                       nir_metadata_instr_hash);
 }
@@ -2168,8 +2168,68 @@ enum nir_serialize_shader_flags {
    NIR_SERIALIZE_SHADER_NAME = 1 << 0,
    NIR_SERIALIZE_SHADER_LABEL = 1 << 1,
    NIR_SERIALIZE_DEBUG_INFO = 1 << 2,
+   NIR_SERIALIZE_LAZY_IMPLS = 1 << 3,
 };
 
+/* With NIR_SERIALIZE_LAZY_IMPLS, the function impls are preceded by a table
+ * giving where each of them is, and each impl is written as if it was the
+ * first one, so that it can be read without reading the others.  Offsets
+ * are relative to the start of the serialized shader.
+ */
+struct lazy_impl_entry {
+   uint32_t first_idx;
+   uint32_t offset;
+   uint32_t size;
+};
+
+struct nir_lazy_impls {
+   nir_shader *nir;
+
+   /* Start of the serialized shader, which has to stay around until all the
+    * impls that will be needed have been loaded.
+    */
+   const uint8_t *base;
+
+   uint32_t idx_table_len;
+   void **idx_table;
+
+   /* nir_function -> lazy_impl_entry of the impls not loaded yet */
+   struct hash_table impls;
+};
+
+static void
+write_lazy_impls(write_ctx *ctx, size_t base)
+{
+   unsigned num_impls = 0;
+   nir_foreach_function_impl(impl, ctx->nir)
+      num_impls++;
+
+   intptr_t table =
+      blob_reserve_bytes(ctx->blob, num_impls * sizeof(struct lazy_impl_entry));
+
+   unsigned i = 0;
+   nir_foreach_function_impl(impl, ctx->nir) {
+      struct lazy_impl_entry entry = {
+         .first_idx = ctx->next_idx,
+         .offset = ctx->blob->size - base,
+      };
+
+      /* Don't encode anything relative to the previous impl. */
+      ctx->last_type = NULL;
+      ctx->last_interface_type = NULL;
+      memset(&ctx->last_var_data, 0, sizeof(ctx->last_var_data));
+
+      write_function_impl(ctx, impl);
+
+      entry.size = ctx->blob->size - base - entry.offset;
+      if (table >= 0) {
+         blob_overwrite_bytes(ctx->blob, table + i * sizeof(entry),
+                              &entry, sizeof(entry));
+      }
+      i++;
+   }
+}
+
 void
 nir_serialize_function(struct blob *blob, const nir_function *fxn)
 {
@@ -2192,7 +2252,8 @@ nir_serialize_function(struct blob *blob, const nir_function *fxn)
 }
 
 static void
-serialize_internal(struct blob *blob, const nir_shader *nir, bool strip, bool serialize_info)
+serialize_internal(struct blob *blob, const nir_shader *nir, bool strip,
+                   bool serialize_info, bool lazy)
 {
    write_ctx ctx = { 0 };
    _mesa_pointer_hash_table_init(&ctx.remap_table, NULL);
@@ -2215,6 +2276,8 @@ serialize_internal(struct blob *blob, const nir_shader *nir, bool strip, bool se
       flags |= NIR_SERIALIZE_SHADER_LABEL;
    if (ctx.debug_info)
       flags |= NIR_SERIALIZE_DEBUG_INFO;
+   if (lazy)
+      flags |= NIR_SERIALIZE_LAZY_IMPLS;
    blob_write_uint32(blob, flags);
 
    if (!strip && info.name)
@@ -2236,8 +2299,12 @@ serialize_internal(struct blob *blob, const nir_shader *nir, bool strip, bool se
       write_function(&ctx, fxn);
    }
 
-   nir_foreach_function_impl(impl, nir) {
-      write_function_impl(&ctx, impl);
+   if (lazy) {
+      write_lazy_impls(&ctx, idx_size_offset);
+   } else {
+      nir_foreach_function_impl(impl, nir) {
+         write_function_impl(&ctx, impl);
+      }
    }
 
    blob_write_uint32(blob, nir->constant_data_size);
@@ -2265,14 +2332,73 @@ serialize_internal(struct blob *blob, const nir_shader *nir, bool strip, bool se
 void
 nir_serialize(struct blob *blob, const nir_shader *nir, bool strip)
 {
-   serialize_internal(blob, nir, strip, true);
+   serialize_internal(blob, nir, strip, true, false);
 }
 
-nir_shader *
-nir_deserialize(void *mem_ctx,
-                const struct nir_shader_compiler_options *options,
-                struct blob_reader *blob)
+/**
+ * Serialize NIR in a layout which lets nir_deserialize_lazy() skip the
+ * function impls and only load the ones which turn out to be needed.  The
+ * result can be read by nir_deserialize() as well.
+ */
+void
+nir_serialize_lazy(struct blob *blob, const nir_shader *nir, bool strip)
 {
+   serialize_internal(blob, nir, strip, true, true);
+}
+
+static void
+read_lazy_impls(read_ctx *ctx, const uint8_t *base, nir_lazy_impls *lazy)
+{
+   unsigned num_impls = 0;
+   nir_foreach_function(fxn, ctx->nir) {
+      if (fxn->impl == NIR_SERIALIZE_FUNC_HAS_IMPL)
+         num_impls++;
+   }
+
+   struct lazy_impl_entry *entries =
+      ralloc_array(lazy, struct lazy_impl_entry, num_impls);
+   if (!entries) {
+      ctx->blob->overrun = true;
+      return;
+   }
+   blob_copy_bytes(ctx->blob, entries, num_impls * sizeof(*entries));
+
+   size_t end = ctx->blob->current - base;
+   for (unsigned i = 0; i < num_impls; i++)
+      end = MAX2(end, (size_t)entries[i].offset + entries[i].size);
+
+   unsigned i = 0;
+   nir_foreach_function(fxn, ctx->nir) {
+      if (fxn->impl != NIR_SERIALIZE_FUNC_HAS_IMPL)
+         continue;
+
+      if (lazy) {
+         fxn->impl = NULL;
+         _mesa_hash_table_insert(&lazy->impls, fxn, &entries[i++]);
+      } else {
+         ctx->last_type = NULL;
+         ctx->last_interface_type = NULL;
+         memset(&ctx->last_var_data, 0, sizeof(ctx->last_var_data));
+
+         nir_function_set_impl(fxn, read_function_impl(ctx));
+      }
+   }
+
+   /* Skip the impls. */
+   if (lazy && !ctx->blob->overrun)
+      blob_skip_bytes(ctx->blob, end - (ctx->blob->current - base));
+
+   if (!lazy)
+      ralloc_free(entries);
+}
+
+static nir_shader *
+deserialize_internal(void *mem_ctx,
+                     const struct nir_shader_compiler_options *options,
+                     struct blob_reader *blob, nir_lazy_impls *lazy)
+{
+   const uint8_t *base = blob->current;
+
    read_ctx ctx = { 0 };
    ctx.blob = blob;
    list_inithead(&ctx.phi_srcs);
@@ -2308,9 +2434,13 @@ nir_deserialize(void *mem_ctx,
    for (unsigned i = 0; i < num_functions; i++)
       read_function(&ctx);
 
-   nir_foreach_function(fxn, ctx.nir) {
-      if (fxn->impl == NIR_SERIALIZE_FUNC_HAS_IMPL)
-         nir_function_set_impl(fxn, read_function_impl(&ctx));
+   if (flags & NIR_SERIALIZE_LAZY_IMPLS) {
+      read_lazy_impls(&ctx, base, lazy);
+   } else {
+      nir_foreach_function(fxn, ctx.nir) {
+         if (fxn->impl == NIR_SERIALIZE_FUNC_HAS_IMPL)
+            nir_function_set_impl(fxn, read_function_impl(&ctx));
+      }
    }
 
    ctx.nir->constant_data_size = blob_read_uint32(blob);
@@ -2329,7 +2459,14 @@ nir_deserialize(void *mem_ctx,
                                    &ctx.nir->printf_info_count);
    }
 
-   free(ctx.idx_table);
+   if (lazy) {
+      lazy->nir = ctx.nir;
+      lazy->base = base;
+      lazy->idx_table_len = ctx.idx_table_len;
+      lazy->idx_table = ctx.idx_table;
+   } else {
+      free(ctx.idx_table);
+   }
    _mesa_hash_table_fini(&ctx.strings, NULL);
 
    nir_validate_shader(ctx.nir, "after deserialize");
@@ -2337,6 +2474,161 @@ nir_deserialize(void *mem_ctx,
    return ctx.nir;
 }
 
+nir_shader *
+nir_deserialize(void *mem_ctx,
+                const struct nir_shader_compiler_options *options,
+                struct blob_reader *blob)
+{
+   return deserialize_internal(mem_ctx, options, blob, NULL);
+}
+
+/**
+ * Deserialize NIR written by nir_serialize_lazy() without the function
+ * impls, which are left as declarations until loaded with
+ * nir_lazy_impls_load() or nir_lazy_impls_load_reachable().
+ *
+ * The impls are read from the blob data when loaded, so it must stay valid
+ * (e.g. the shader cache file stay mapped) until the returned nir_lazy_impls
+ * is freed.  Shaders in the regular layout are loaded completely.
+ *
+ * Returns NULL, with *lazy_out set to NULL, if the blob is truncated.
+ */
+nir_shader *
+nir_deserialize_lazy(void *mem_ctx,
+                     const struct nir_shader_compiler_options *options,
+                     struct blob_reader *blob, nir_lazy_impls **lazy_out)
+{
+   *lazy_out = NULL;
+
+   nir_lazy_impls *lazy = rzalloc(NULL, nir_lazy_impls);
+   if (!lazy)
+      return NULL;
+
+   _mesa_pointer_hash_table_init(&lazy->impls, lazy);
+
+   nir_shader *nir = deserialize_internal(mem_ctx, options, blob, lazy);
+   if (blob->overrun) {
+      nir_lazy_impls_free(lazy);
+      ralloc_free(nir);
+      return NULL;
+   }
+
+   *lazy_out = lazy;
+   return nir;
+}
+
+static bool
+load_impl(nir_lazy_impls *lazy, nir_function *fxn)
+{
+   struct hash_entry *entry = _mesa_hash_table_search(&lazy->impls, fxn);
+   if (!entry)
+      return true;
+
+   const struct lazy_impl_entry *impl = entry->data;
+   _mesa_hash_table_remove(&lazy->impls, entry);
+
+   struct blob_reader blob;
+   blob_reader_init(&blob, lazy->base + impl->offset, impl->size);
+
+   read_ctx ctx = { 0 };
+   ctx.nir = lazy->nir;
+   ctx.blob = &blob;
+   list_inithead(&ctx.phi_srcs);
+   ctx.next_idx = impl->first_idx;
+   ctx.idx_table_len = lazy->idx_table_len;
+   ctx.idx_table = lazy->idx_table;
+
+   if (ctx.nir->has_debug_info)
+      _mesa_hash_table_init(&ctx.strings, NULL, _mesa_hash_string, _mesa_key_string_equal);
+
+   nir_function_impl *fi = read_function_impl(&ctx);
+
+   /* The impl read from a truncated or corrupt blob is left unattached, it
+    * is freed with the shader.
+    */
+   if (!blob.overrun)
+      nir_function_set_impl(fxn, fi);
+
+   _mesa_hash_table_fini(&ctx.strings, NULL);
+
+   return !blob.overrun;
+}
+
+/**
+ * Load the impl of a function, if it wasn't loaded already.
+ *
+ * Returns false if the impl couldn't be read, in which case the function is
+ * left as a declaration and the shader should be discarded.
+ */
+bool
+nir_lazy_impls_load(nir_lazy_impls *lazy, nir_function *fxn)
+{
+   bool ok = load_impl(lazy, fxn);
+   nir_validate_shader(lazy->nir, "after loading an impl");
+   return ok;
+}
+
+/**
+ * Load the impls of a function and of everything it calls.
+ *
+ * Returns false if one of them couldn't be read, see nir_lazy_impls_load().
+ */
+bool
+nir_lazy_impls_load_reachable(nir_lazy_impls *lazy, nir_function *fxn)
+{
+   bool ok = true;
+   struct set *visited = _mesa_pointer_set_create(NULL);
+   struct util_dynarray worklist;
+   util_dynarray_init(&worklist, NULL);
+   util_dynarray_append(&worklist, fxn);
+
+   while (util_dynarray_num_elements(&worklist, nir_function *)) {
+      nir_function *f = util_dynarray_pop(&worklist, nir_function *);
+
+      bool found;
+      _mesa_set_search_or_add(visited, f, &found);
+      if (found)
+         continue;
+
+      if (!load_impl(lazy, f)) {
+         ok = false;
+         break;
+      }
+      if (!f->impl)
+         continue;
+
+      if (f->impl->preamble)
+         util_dynarray_append(&worklist, f->impl->preamble);
+
+      nir_foreach_block(block, f->impl) {
+         nir_foreach_instr(instr, block) {
+            if (instr->type == nir_instr_type_call)
+               util_dynarray_append(&worklist, nir_instr_as_call(instr)->callee);
+         }
+      }
+   }
+
+   util_dynarray_fini(&worklist);
+   _mesa_set_destroy(visited, NULL);
+
+   nir_validate_shader(lazy->nir, "after loading impls");
+
+   return ok;
+}
+
+/** Free the state of a lazily deserialized shader, the impls which haven't
+ * been loaded remain declarations.
+ */
+void
+nir_lazy_impls_free(nir_lazy_impls *lazy)
+{
+   if (!lazy)
+      return;
+
+   free(lazy->idx_table);
+   ralloc_free(lazy);
+}
+
 nir_function *
 nir_deserialize_function(void *mem_ctx,
                          const struct nir_shader_compiler_options *options,
@@ -2393,7 +2685,7 @@ nir_validate_progress_setup(nir_shader *shader)
 
    struct blob blob_before;
    blob_init(&blob_before);
-   serialize_internal(&blob_before, shader, false, false);
+   serialize_internal(&blob_before, shader, false, false, false);
    return blob_before;
 }
 
@@ -2406,7 +2698,7 @@ nir_validate_progress_finish(nir_shader *shader, struct blob *setup_blob, bool p
    if (!progress) {
       struct blob blob_after;
       blob_init(&blob_after);
-      serialize_internal(&blob_after, shader, false, false);
+      serialize_internal(&blob_after, shader, false, false, false);
       if (setup_blob->size != blob_after.size ||
           memcmp(setup_blob->data, blob_after.data, setup_blob->size)) {
          fprintf(stderr, "NIR changed but no progress reported %s\n", when);
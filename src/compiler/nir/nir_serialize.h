@@ -37,6 +37,17 @@ nir_shader *nir_deserialize(void *mem_ctx,
                             const struct nir_shader_compiler_options *options,
                             struct blob_reader *blob);
 
+typedef struct nir_lazy_impls nir_lazy_impls;
+
+void nir_serialize_lazy(struct blob *blob, const nir_shader *nir, bool strip);
+nir_shader *nir_deserialize_lazy(void *mem_ctx,
+                                 const struct nir_shader_compiler_options *options,
+                                 struct blob_reader *blob,
+                                 nir_lazy_impls **lazy);
+bool nir_lazy_impls_load(nir_lazy_impls *lazy, nir_function *fxn);
+bool nir_lazy_impls_load_reachable(nir_lazy_impls *lazy, nir_function *fxn);
+void nir_lazy_impls_free(nir_lazy_impls *lazy);
+
 void
 nir_serialize_function(struct blob *blob, const nir_function *fxn);
 
@@ -97,6 +97,58 @@ TEST_F(nir_opt_dce_test, return_before_loop)
    nir_validate_shader(b->shader, NULL);
 }
 
+static std::vector<bool>
+get_live_sets(nir_function_impl *impl)
+{
+   std::vector<bool> live;
+   nir_foreach_block(block, impl) {
+      for (unsigned i = 0; i < impl->ssa_alloc; i++) {
+         live.push_back(u_sparse_bitset_test(&block->live_in, i));
+         live.push_back(u_sparse_bitset_test(&block->live_out, i));
+      }
+   }
+   return live;
+}
+
+TEST_F(nir_opt_dce_test, preserve_live_defs)
+{
+   /* Test that the liveness information patched by nir_opt_dce() matches
+    * what a full recomputation gives.  %2 is live across the loop until its
+    * use inside the loop is removed.
+    */
+   nir_variable *cond = nir_variable_create(b->shader, nir_var_shader_in, glsl_bool_type(), "cond");
+   nir_variable *in = nir_variable_create(b->shader, nir_var_shader_in, glsl_int_type(), "in");
+   nir_variable *out = nir_variable_create(b->shader, nir_var_shader_out, glsl_int_type(), "out");
+
+   nir_def *val = nir_load_var(b, in);
+   nir_store_var(b, out, val, 0x1);
+
+   nir_loop *loop = nir_push_loop(b);
+   nir_def *dead = nir_iadd_imm(b, val, 1);
+   nir_imul(b, dead, val);
+   nir_break_if(b, nir_load_var(b, cond));
+   nir_pop_loop(b, NULL);
+
+   nir_store_var(b, out, nir_imm_int(b, 0), 0x1);
+
+   nir_metadata_require(b->impl, nir_metadata_block_index |
+                        nir_metadata_live_defs);
+   nir_block *header = nir_loop_first_block(loop);
+   ASSERT_TRUE(u_sparse_bitset_test(&header->live_in, val->index));
+
+   ASSERT_TRUE(nir_opt_dce(b->shader));
+   ASSERT_TRUE(b->impl->valid_metadata & nir_metadata_live_defs);
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_FALSE(u_sparse_bitset_test(&header->live_in, val->index));
+
+   std::vector<bool> patched = get_live_sets(b->impl);
+   nir_metadata_invalidate(b->shader);
+   nir_metadata_require(b->impl, nir_metadata_block_index |
+                        nir_metadata_live_defs);
+   EXPECT_EQ(patched, get_live_sets(b->impl));
+}
+
 TEST_F(nir_opt_dead_cf_test, jump_before_constant_if)
 {
    /*
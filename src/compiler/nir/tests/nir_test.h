@@ -24,6 +24,23 @@ delete_annotation(hash_entry *he)
    free(he->data);
 }
 
+/** Prints the shader to a string, to be freed with free(). */
+static inline char *
+nir_test_shader_to_string(nir_shader *shader)
+{
+   char *str = NULL;
+   size_t size = 0;
+   struct u_memstream mem;
+
+   if (!u_memstream_open(&mem, &str, &size))
+      return NULL;
+
+   nir_print_shader(shader, u_memstream_get(&mem));
+   u_memstream_close(&mem);
+
+   return str;
+}
+
 class nir_test : public ::testing::Test {
 public:
    nir_test(const char *name)
@@ -61,16 +78,10 @@ public:
    {
       nir_index_ssa_defs(b->impl);
 
-      char *result = NULL;
-      size_t result_size = 0;
-      struct u_memstream mem;
-      if (!u_memstream_open(&mem, &result, &result_size)) 
+      char *result = nir_test_shader_to_string(b->shader);
+      if (!result)
          return;
 
-      FILE * memf = u_memstream_get(&mem);
-      nir_print_shader(b->shader, memf);
-      u_memstream_close(&mem);
-
       const char *expected = reference.string;
 
       /* Use a custom comparison that ignores spaces since spaces are not
@@ -0,0 +1,110 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "nir_test.h"
+
+class nir_opt_cse_test : public nir_test {
+protected:
+   nir_opt_cse_test()
+      : nir_test::nir_test("nir_opt_cse_test")
+   {
+   }
+};
+
+static unsigned
+count_alu(nir_function_impl *impl, nir_op op)
+{
+   unsigned count = 0;
+
+   nir_foreach_block(block, impl) {
+      nir_foreach_instr(instr, block) {
+         if (instr->type == nir_instr_type_alu &&
+             nir_instr_as_alu(instr)->op == op)
+            count++;
+      }
+   }
+
+   return count;
+}
+
+static bool
+block_has_alu(nir_block *block)
+{
+   nir_foreach_instr(instr, block) {
+      if (instr->type == nir_instr_type_alu)
+         return true;
+   }
+
+   return false;
+}
+
+TEST_F(nir_opt_cse_test, if_branches)
+{
+   nir_def *zero = nir_imm_int(b, 0);
+   nir_def *a = nir_load_ssbo(b, 1, 32, zero, zero);
+   nir_def *c = nir_load_ssbo(b, 1, 32, zero, nir_imm_int(b, 4));
+
+   nir_if *nif = nir_push_if(b, nir_ieq(b, a, c));
+   nir_store_ssbo(b, nir_iadd(b, a, c), zero, zero);
+   nir_push_else(b, nif);
+   nir_store_ssbo(b, nir_iadd(b, a, c), zero, zero);
+   nir_pop_if(b, nif);
+
+   /* Neither iadd dominates the other. */
+   ASSERT_FALSE(nir_opt_cse(b->shader));
+   ASSERT_TRUE(nir_opt_cse_global(b->shader));
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_EQ(count_alu(b->impl, nir_op_iadd), 1);
+   EXPECT_FALSE(block_has_alu(nir_if_first_then_block(nif)));
+   EXPECT_FALSE(block_has_alu(nir_if_first_else_block(nif)));
+}
+
+TEST_F(nir_opt_cse_test, if_branches_chain)
+{
+   nir_def *zero = nir_imm_int(b, 0);
+   nir_def *a = nir_load_ssbo(b, 1, 32, zero, zero);
+   nir_def *c = nir_load_ssbo(b, 1, 32, zero, nir_imm_int(b, 4));
+
+   nir_if *nif = nir_push_if(b, nir_ieq(b, a, c));
+   nir_store_ssbo(b, nir_imul(b, nir_iadd(b, a, c), a), zero, zero);
+   nir_push_else(b, nif);
+   nir_store_ssbo(b, nir_imul(b, nir_iadd(b, c, a), a), zero, zero);
+   nir_pop_if(b, nif);
+
+   /* The imul only matches once the iadd has been merged. */
+   ASSERT_TRUE(nir_opt_cse_global(b->shader));
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_EQ(count_alu(b->impl, nir_op_iadd), 1);
+   EXPECT_EQ(count_alu(b->impl, nir_op_imul), 1);
+   EXPECT_FALSE(block_has_alu(nir_if_first_then_block(nif)));
+   EXPECT_FALSE(block_has_alu(nir_if_first_else_block(nif)));
+}
+
+TEST_F(nir_opt_cse_test, cached_hash_src_rewrite)
+{
+   nir_def *zero = nir_imm_int(b, 0);
+   nir_def *a = nir_load_ssbo(b, 1, 32, zero, zero);
+   nir_def *c = nir_load_ssbo(b, 1, 32, zero, nir_imm_int(b, 4));
+   nir_def *d = nir_load_ssbo(b, 1, 32, zero, nir_imm_int(b, 8));
+   nir_def *x = nir_iadd(b, a, c);
+   nir_def *y = nir_iadd(b, a, d);
+   nir_store_ssbo(b, nir_imul(b, x, y), zero, zero);
+
+   ASSERT_FALSE(nir_opt_cse(b->shader));
+   ASSERT_TRUE(b->impl->valid_metadata & nir_metadata_instr_hash);
+
+   /* Like a pass which preserves the hashes, the one of y has to be
+    * recomputed.
+    */
+   nir_src_rewrite(&nir_def_as_alu(y)->src[1].src, c);
+   nir_progress(true, b->impl, nir_metadata_control_flow |
+                               nir_metadata_instr_hash);
+
+   ASSERT_TRUE(nir_opt_cse(b->shader));
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_EQ(count_alu(b->impl, nir_op_iadd), 1);
+}
@@ -0,0 +1,98 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "nir_test.h"
+
+class nir_opt_gcm_test : public nir_test {
+protected:
+   nir_opt_gcm_test()
+      : nir_test::nir_test("nir_opt_gcm_test")
+   {
+   }
+
+   nir_def *build_loop_with_invariant();
+};
+
+/* Builds a loop storing a + c + i for 16 iterations and returns a + c. */
+nir_def *
+nir_opt_gcm_test::build_loop_with_invariant()
+{
+   nir_def *zero = nir_imm_int(b, 0);
+   nir_def *a = nir_load_ssbo(b, 1, 32, zero, zero);
+   nir_def *c = nir_load_ssbo(b, 1, 32, zero, nir_imm_int(b, 4));
+
+   nir_variable *i = nir_local_variable_create(b->impl, glsl_int_type(), "i");
+   nir_store_var(b, i, zero, 1);
+
+   nir_loop *loop = nir_push_loop(b);
+   nir_def *iv = nir_load_var(b, i);
+   nir_break_if(b, nir_ige_imm(b, iv, 16));
+   nir_def *inv = nir_iadd(b, a, c);
+   nir_store_ssbo(b, nir_iadd(b, inv, iv), zero, nir_ishl_imm(b, iv, 2));
+   nir_store_var(b, i, nir_iadd_imm(b, iv, 1), 1);
+   nir_pop_loop(b, loop);
+
+   nir_lower_vars_to_ssa(b->shader);
+   nir_validate_shader(b->shader, NULL);
+
+   return inv;
+}
+
+static bool
+def_in_loop(nir_def *def)
+{
+   for (nir_cf_node *node = &nir_def_block(def)->cf_node; node;
+        node = node->parent) {
+      if (node->type == nir_cf_node_loop)
+         return true;
+   }
+
+   return false;
+}
+
+TEST_F(nir_opt_gcm_test, max_pressure)
+{
+   nir_def *zero = nir_imm_int(b, 0);
+   nir_def *a = nir_load_ssbo(b, 4, 32, zero, zero);
+   nir_def *c = nir_load_ssbo(b, 1, 64, zero, zero);
+   nir_store_ssbo(b, a, zero, zero);
+   nir_store_ssbo(b, c, zero, zero);
+
+   nir_metadata_require(b->impl, nir_metadata_block_index |
+                                 nir_metadata_live_defs);
+
+   /* a, c and zero are all live at the first store. */
+   unsigned block_pressure[1];
+   ASSERT_EQ(b->impl->num_blocks, 1);
+   EXPECT_EQ(nir_live_defs_max_pressure(b->impl, block_pressure), 7);
+   EXPECT_EQ(block_pressure[0], 7);
+}
+
+TEST_F(nir_opt_gcm_test, hoist_within_budget)
+{
+   nir_def *inv = build_loop_with_invariant();
+
+   nir_opt_gcm_options options = {
+      .value_number = false,
+      .register_budget = 1000,
+   };
+   ASSERT_TRUE(nir_opt_gcm_pressure(b->shader, &options));
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_FALSE(def_in_loop(inv));
+}
+
+TEST_F(nir_opt_gcm_test, no_hoist_over_budget)
+{
+   nir_def *inv = build_loop_with_invariant();
+
+   nir_opt_gcm_options options = {
+      .value_number = false,
+      .register_budget = 1,
+   };
+   nir_opt_gcm_pressure(b->shader, &options);
+   nir_validate_shader(b->shader, NULL);
+
+   EXPECT_TRUE(def_in_loop(inv));
+}
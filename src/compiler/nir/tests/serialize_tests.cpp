@@ -26,6 +26,7 @@
 #include "nir.h"
 #include "nir_builder.h"
 #include "nir_serialize.h"
+#include "nir_test.h"
 
 namespace {
 
@@ -195,3 +196,188 @@ TEST_P(nir_serialize_all_but_one_test, single_channel)
 
    ASSERT_SWIZZLE_EQ(vec_alu, vec_alu_dup, 1, 0);
 }
+
+static void
+build_lazy_test_impl(nir_function_impl *impl, nir_variable *var, unsigned i)
+{
+   nir_builder b = nir_builder_at(nir_after_impl(impl));
+
+   /* Locals of the same type in every impl, which the serializer would
+    * otherwise encode relative to each other.
+    */
+   nir_variable *tmp =
+      nir_local_variable_create(impl, glsl_vec4_type(), "tmp");
+   nir_store_var(&b, tmp, nir_imm_vec4(&b, i, 0, 0, 0), 0xf);
+   nir_store_var(&b, var, nir_channel(&b, nir_load_var(&b, tmp), 0), 0x1);
+}
+
+/* main() calls callee(), unused() isn't called. */
+static nir_shader *
+create_lazy_test_shader(const nir_shader_compiler_options *options)
+{
+   nir_builder b = nir_builder_init_simple_shader(MESA_SHADER_COMPUTE, options,
+                                                  "lazy test");
+   nir_variable *var =
+      nir_variable_create(b.shader, nir_var_mem_shared, glsl_float_type(), "var");
+
+   nir_function *callee = nir_function_create(b.shader, "callee");
+   nir_function *unused = nir_function_create(b.shader, "unused");
+   build_lazy_test_impl(nir_function_impl_create(callee), var, 1);
+   build_lazy_test_impl(nir_function_impl_create(unused), var, 2);
+   build_lazy_test_impl(b.impl, var, 0);
+   nir_build_call(&b, callee, 0, NULL);
+
+   return b.shader;
+}
+
+TEST(nir_serialize_lazy_test, load_reachable)
+{
+   const nir_shader_compiler_options options = {};
+
+   glsl_type_singleton_init_or_ref();
+
+   nir_shader *shader = create_lazy_test_shader(&options);
+
+   struct blob blob;
+   struct blob_reader reader;
+   blob_init(&blob);
+   nir_serialize_lazy(&blob, shader, false);
+
+   nir_lazy_impls *lazy;
+   blob_reader_init(&reader, blob.data, blob.size);
+   nir_shader *lazy_nir = nir_deserialize_lazy(NULL, &options, &reader, &lazy);
+   ASSERT_TRUE(lazy);
+   EXPECT_FALSE(reader.overrun);
+   EXPECT_EQ(reader.current, reader.end);
+
+   nir_function *lazy_entry = nir_shader_get_function_for_name(lazy_nir, "main");
+   nir_function *lazy_callee = nir_shader_get_function_for_name(lazy_nir, "callee");
+   nir_function *lazy_unused = nir_shader_get_function_for_name(lazy_nir, "unused");
+   ASSERT_TRUE(lazy_entry && lazy_callee && lazy_unused);
+   EXPECT_EQ(lazy_entry->impl, nullptr);
+   EXPECT_EQ(lazy_callee->impl, nullptr);
+   EXPECT_EQ(lazy_unused->impl, nullptr);
+
+   EXPECT_TRUE(nir_lazy_impls_load_reachable(lazy, lazy_entry));
+   EXPECT_NE(lazy_entry->impl, nullptr);
+   EXPECT_NE(lazy_callee->impl, nullptr);
+   EXPECT_EQ(lazy_unused->impl, nullptr);
+
+   EXPECT_TRUE(nir_lazy_impls_load(lazy, lazy_unused));
+   EXPECT_NE(lazy_unused->impl, nullptr);
+   nir_lazy_impls_free(lazy);
+
+   /* The regular deserialization reads the lazy layout as well. */
+   blob_reader_init(&reader, blob.data, blob.size);
+   nir_shader *eager_nir = nir_deserialize(NULL, &options, &reader);
+   EXPECT_FALSE(reader.overrun);
+   blob_finish(&blob);
+
+   nir_shader *shaders[] = { shader, lazy_nir, eager_nir };
+   for (nir_shader *shader : shaders) {
+      nir_foreach_function_impl(impl, shader)
+         nir_index_ssa_defs(impl);
+   }
+
+   char *orig_str = nir_test_shader_to_string(shader);
+   char *lazy_str = nir_test_shader_to_string(lazy_nir);
+   char *eager_str = nir_test_shader_to_string(eager_nir);
+   EXPECT_STREQ(orig_str, lazy_str);
+   EXPECT_STREQ(orig_str, eager_str);
+   free(orig_str);
+   free(lazy_str);
+   free(eager_str);
+
+   ralloc_free(eager_nir);
+   ralloc_free(lazy_nir);
+   ralloc_free(shader);
+
+   glsl_type_singleton_decref();
+}
+
+TEST(nir_serialize_lazy_test, truncated_blob)
+{
+   const nir_shader_compiler_options options = {};
+
+   glsl_type_singleton_init_or_ref();
+
+   nir_shader *shader = create_lazy_test_shader(&options);
+
+   struct blob blob;
+   blob_init(&blob);
+   nir_serialize_lazy(&blob, shader, false);
+
+   /* Cut off the end of the last impl and what follows the impls, and
+    * check that lazy gets overwritten.
+    */
+   nir_lazy_impls *lazy = (nir_lazy_impls *)(uintptr_t)1;
+   struct blob_reader reader;
+   blob_reader_init(&reader, blob.data, blob.size - 8);
+   EXPECT_EQ(nir_deserialize_lazy(NULL, &options, &reader, &lazy), nullptr);
+   EXPECT_EQ(lazy, nullptr);
+
+   blob_finish(&blob);
+   ralloc_free(shader);
+
+   glsl_type_singleton_decref();
+}
+
+TEST(nir_serialize_lazy_test, truncated_impl)
+{
+   const nir_shader_compiler_options options = {};
+
+   glsl_type_singleton_init_or_ref();
+
+   nir_shader *shader = create_lazy_test_shader(&options);
+
+   struct blob blob;
+   blob_init(&blob);
+   nir_serialize_lazy(&blob, shader, false);
+
+   /* Find the table of the 3 impls, which is directly followed by the first
+    * one, and cut the second one (callee) short.
+    */
+   const unsigned num_impls = 3;
+   const size_t entry_size = 3 * sizeof(uint32_t);
+   size_t table = 0;
+   for (size_t i = 0; i + num_impls * entry_size <= blob.size; i++) {
+      uint32_t entry0[3], entry1[3];
+      memcpy(entry0, blob.data + i, entry_size);
+      memcpy(entry1, blob.data + i + entry_size, entry_size);
+      if (entry0[1] == i + num_impls * entry_size &&
+          entry1[1] == entry0[1] + entry0[2]) {
+         table = i;
+         break;
+      }
+   }
+   ASSERT_NE(table, 0u);
+   uint32_t size = 2;
+   memcpy(blob.data + table + entry_size + 2 * sizeof(uint32_t), &size,
+          sizeof(size));
+
+   nir_lazy_impls *lazy;
+   struct blob_reader reader;
+   blob_reader_init(&reader, blob.data, blob.size);
+   nir_shader *lazy_nir = nir_deserialize_lazy(NULL, &options, &reader, &lazy);
+   ASSERT_TRUE(lazy);
+
+   nir_function *lazy_entry = nir_shader_get_function_for_name(lazy_nir, "main");
+   nir_function *lazy_callee = nir_shader_get_function_for_name(lazy_nir, "callee");
+   nir_function *lazy_unused = nir_shader_get_function_for_name(lazy_nir, "unused");
+   ASSERT_TRUE(lazy_entry && lazy_callee && lazy_unused);
+
+   EXPECT_FALSE(nir_lazy_impls_load_reachable(lazy, lazy_entry));
+   EXPECT_NE(lazy_entry->impl, nullptr);
+   EXPECT_EQ(lazy_callee->impl, nullptr);
+
+   /* The other impls are unaffected. */
+   EXPECT_TRUE(nir_lazy_impls_load(lazy, lazy_unused));
+   EXPECT_NE(lazy_unused->impl, nullptr);
+
+   nir_lazy_impls_free(lazy);
+   blob_finish(&blob);
+   ralloc_free(lazy_nir);
+   ralloc_free(shader);
+
+   glsl_type_singleton_decref();
+}
@@ -55,6 +55,7 @@ struct gallivm_state;
 #define GALLIVM_PERF_NO_OPT          (1 << 3)
 #define GALLIVM_PERF_NO_AOS_SAMPLING (1 << 4)
 #define GALLIVM_PERF_NO_LOD_ELLIPSE  (1 << 5)
+#define GALLIVM_PERF_GCM             (1 << 6)
 
 #ifdef __cplusplus
 extern "C" {
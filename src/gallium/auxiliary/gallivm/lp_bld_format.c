@@ -26,6 +26,8 @@
  **************************************************************************/
 
 
+#include "util/format/u_format.h"
+
 #include "lp_bld_format.h"
 
 LLVMTypeRef lp_build_format_cache_elem_type(struct gallivm_state *gallivm, enum cache_member member) {
@@ -72,3 +74,33 @@ lp_build_format_cache_type(struct gallivm_state *gallivm)
 
    return s;
 }
+
+
+/**
+ * Whether fetches from the format go through the block cache when one is
+ * available.
+ *
+ * S3TC blocks are decoded by generated code, the other compressed formats
+ * with 4x4 blocks by their util_format unpack function, which is a lot
+ * slower than a cache lookup. Only formats which fit the 8 bit unorm cache
+ * entries once linearized qualify, and RGTC keeps its vectorized fetch.
+ */
+bool
+lp_build_format_use_cache(const struct util_format_description *format_desc)
+{
+   const struct util_format_description *linear_desc =
+      util_format_description(util_format_linear(format_desc->format));
+   const struct util_format_unpack_description *unpack;
+
+   if (format_desc->layout == UTIL_FORMAT_LAYOUT_S3TC)
+      return true;
+
+   if (format_desc->layout == UTIL_FORMAT_LAYOUT_PLAIN ||
+       format_desc->layout == UTIL_FORMAT_LAYOUT_RGTC ||
+       format_desc->block.width != 4 || format_desc->block.height != 4 ||
+       !util_format_fits_8unorm(linear_desc))
+      return false;
+
+   unpack = util_format_unpack_description(linear_desc->format);
+   return unpack && unpack->unpack_rgba_8unorm_rect;
+}
@@ -37,16 +37,26 @@
 #include "gallivm/lp_bld_init.h"
 #include "util/macros.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 struct util_format_description;
 struct lp_type;
 struct lp_build_context;
 
 
-#define LP_BUILD_FORMAT_CACHE_DEBUG 0
+/*
+ * Count the cache accesses and misses (only for debug builds)
+ */
+#define LP_BUILD_FORMAT_CACHE_DEBUG MESA_DEBUG
+
 /*
  * Block cache
  *
- * Optional block cache to be used when unpacking big pixel blocks.
+ * Optional block cache to be used when unpacking big pixel blocks, see
+ * lp_build_format_use_cache() for the formats which use it. Each entry holds
+ * a whole decoded 4x4 block, tagged with its address and format.
  * Must be a power of 2
  */
 
@@ -86,6 +96,9 @@ lp_build_format_cache_member_type(struct gallivm_state *gallivm, enum cache_memb
 LLVMTypeRef
 lp_build_format_cache_elem_type(struct gallivm_state *gallivm, enum cache_member member);
 
+bool
+lp_build_format_use_cache(const struct util_format_description *format_desc);
+
 /*
  * AoS
  */
@@ -192,6 +205,19 @@ lp_build_fetch_s3tc_rgba_aos(struct gallivm_state *gallivm,
                              LLVMValueRef j,
                              LLVMValueRef cache);
 
+LLVMValueRef
+lp_build_fetch_cached_rgba_aos(struct gallivm_state *gallivm,
+                               const struct util_format_description *format_desc,
+                               unsigned n,
+                               LLVMValueRef base_ptr,
+                               LLVMValueRef offset,
+                               LLVMValueRef i,
+                               LLVMValueRef j,
+                               LLVMValueRef cache);
+
+void
+lp_build_format_add_unpack_block_hook(struct gallivm_state *gallivm);
+
 /*
  * RGTC
  */
@@ -254,5 +280,8 @@ lp_build_srgb_to_linear(struct gallivm_state *gallivm,
                         unsigned chan_bits,
                         LLVMValueRef src);
 
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* !LP_BLD_FORMAT_H */
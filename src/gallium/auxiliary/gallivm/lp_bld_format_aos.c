@@ -784,6 +784,34 @@ lp_build_fetch_rgba_aos(struct gallivm_state *gallivm,
        return tmp;
    }
 
+   /*
+    * other compressed formats, decoded a whole block at a time into the cache
+    */
+
+   if (cache && lp_build_format_use_cache(format_desc)) {
+      struct lp_type tmp_type;
+      LLVMValueRef tmp;
+
+      memset(&tmp_type, 0, sizeof tmp_type);
+      tmp_type.width = 8;
+      tmp_type.length = num_pixels * 4;
+      tmp_type.norm = true;
+
+      tmp = lp_build_fetch_cached_rgba_aos(gallivm,
+                                           format_desc,
+                                           num_pixels,
+                                           base_ptr,
+                                           offset,
+                                           i, j,
+                                           cache);
+
+      lp_build_conv(gallivm,
+                    tmp_type, type,
+                    &tmp, 1, &tmp, 1);
+
+      return tmp;
+   }
+
    /*
     * Fallback to util_format_description::fetch_rgba_8unorm().
     */
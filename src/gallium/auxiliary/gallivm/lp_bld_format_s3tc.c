@@ -39,6 +39,7 @@
 #include "util/format/u_format.h"
 #include "util/u_math.h"
 #include "util/u_cpu_detect.h"
+#include "util/u_pointer.h"
 
 #include "lp_bld_arit.h"
 #include "lp_bld_type.h"
@@ -53,6 +54,8 @@
 #include "lp_bld_init.h"
 #include "lp_bld_debug.h"
 #include "lp_bld_intr.h"
+#include "lp_bld_misc.h"
+#include "lp_bld_struct.h"
 
 
 /**
@@ -1898,6 +1901,114 @@ s3tc_decode_block_dxt5(struct gallivm_state *gallivm,
 }
 
 
+/*
+ * The cache tag is the block address, with the format in the top bits which
+ * addresses don't use, so that views of the same memory with different
+ * formats don't share cache entries.
+ */
+static LLVMValueRef
+cache_tag(struct gallivm_state *gallivm,
+          const struct util_format_description *format_desc,
+          LLVMValueRef addr)
+{
+   LLVMTypeRef i64t = LLVMInt64TypeInContext(gallivm->context);
+
+   return LLVMBuildXor(gallivm->builder, addr,
+                       LLVMConstInt(i64t, (uint64_t)format_desc->format << 48, 0),
+                       "cache_tag");
+}
+
+
+/*
+ * Unpacks a block of a format without generated decode code to RGBA8, for
+ * unpack_block_to_cache().
+ */
+static void
+unpack_rgba_8unorm_block(uint8_t *dst, const uint8_t *src, uint32_t format)
+{
+   const struct util_format_unpack_description *unpack =
+      util_format_unpack_description(format);
+
+   unpack->unpack_rgba_8unorm_rect(dst, 16, src,
+                                   util_format_get_blocksize(format), 4, 4);
+}
+
+
+/*
+ * The generated code calls unpack_rgba_8unorm_block() through a declared
+ * function which is only mapped to it when the module is compiled, as for
+ * debug_printf. Unlike a constant function pointer, this keeps the code
+ * position independent, so it can go in the shader cache.
+ */
+void
+lp_build_format_add_unpack_block_hook(struct gallivm_state *gallivm)
+{
+   if (gallivm->unpack_block_hook)
+      gallivm_add_global_mapping(gallivm, gallivm->unpack_block_hook,
+                                 func_to_pointer((func_pointer) unpack_rgba_8unorm_block));
+}
+
+
+/*
+ * Decode a block of a format without generated decode code, using the
+ * util_format unpack function. It is slow, but only runs on cache misses.
+ * Returns the columns of the block, like the s3tc decode functions.
+ */
+static void
+unpack_block_to_cache(struct gallivm_state *gallivm,
+                      const struct util_format_description *format_desc,
+                      LLVMValueRef ptr_addr,
+                      LLVMValueRef *col)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   enum pipe_format format = util_format_linear(format_desc->format);
+   LLVMTypeRef i8t = LLVMInt8TypeInContext(gallivm->context);
+   LLVMTypeRef pi8t = LLVMPointerType(i8t, 0);
+   LLVMTypeRef i32t = LLVMInt32TypeInContext(gallivm->context);
+   LLVMTypeRef row_type = LLVMVectorType(i32t, 4);
+   LLVMTypeRef function_type, arg_types[3];
+   LLVMValueRef rows_ptr, args[3], rows[4];
+   unsigned y;
+
+   assert(util_format_unpack_description(format)->unpack_rgba_8unorm_rect);
+
+   /*
+    * Function to call looks like:
+    *   unpack_rgba_8unorm_block(uint8_t *dst, const uint8_t *src,
+    *                            uint32_t format)
+    */
+   arg_types[0] = pi8t;
+   arg_types[1] = pi8t;
+   arg_types[2] = i32t;
+   function_type = LLVMFunctionType(LLVMVoidTypeInContext(gallivm->context),
+                                    arg_types, ARRAY_SIZE(arg_types), 0);
+
+   if (!gallivm->unpack_block_hook)
+      gallivm->unpack_block_hook = LLVMAddFunction(gallivm->module,
+                                                   "unpack_block_hook",
+                                                   function_type);
+
+   rows_ptr = lp_build_array_alloca(gallivm, row_type,
+                                    lp_build_const_int32(gallivm, 4), "rows");
+
+   args[0] = LLVMBuildBitCast(builder, rows_ptr, pi8t, "");
+   args[1] = ptr_addr;
+   args[2] = lp_build_const_int32(gallivm, format);
+   LLVMBuildCall2(builder, function_type, gallivm->unpack_block_hook,
+                  args, ARRAY_SIZE(args), "");
+
+   for (y = 0; y < 4; y++) {
+      LLVMValueRef index = lp_build_const_int32(gallivm, y);
+      LLVMValueRef row_ptr = LLVMBuildGEP2(builder, row_type, rows_ptr,
+                                           &index, 1, "");
+      rows[y] = LLVMBuildLoad2(builder, row_type, row_ptr, "");
+   }
+
+   /* The cache is indexed by x first. */
+   lp_build_transpose_aos(gallivm, lp_type_uint_vec(32, 128), rows, col);
+}
+
+
 static void
 generate_update_cache_one_block(struct gallivm_state *gallivm,
                                 LLVMValueRef function,
@@ -1928,32 +2039,37 @@ generate_update_cache_one_block(struct gallivm_state *gallivm,
    gallivm->builder = LLVMCreateBuilderInContext(gallivm->context);
    LLVMPositionBuilderAtEnd(gallivm->builder, block);
 
-   lp_build_gather_s3tc_simple_scalar(gallivm, format_desc, &dxt_block,
-                                      ptr_addr);
-
-   switch (format_desc->format) {
-   case PIPE_FORMAT_DXT1_RGB:
-   case PIPE_FORMAT_DXT1_RGBA:
-   case PIPE_FORMAT_DXT1_SRGB:
-   case PIPE_FORMAT_DXT1_SRGBA:
-      s3tc_decode_block_dxt1(gallivm, format_desc->format, dxt_block, col);
-      break;
-   case PIPE_FORMAT_DXT3_RGBA:
-   case PIPE_FORMAT_DXT3_SRGBA:
-      s3tc_decode_block_dxt3(gallivm, format_desc->format, dxt_block, col);
-      break;
-   case PIPE_FORMAT_DXT5_RGBA:
-   case PIPE_FORMAT_DXT5_SRGBA:
-      s3tc_decode_block_dxt5(gallivm, format_desc->format, dxt_block, col);
-      break;
-   default:
-      assert(0);
-      s3tc_decode_block_dxt1(gallivm, format_desc->format, dxt_block, col);
-      break;
+   if (format_desc->layout == UTIL_FORMAT_LAYOUT_S3TC) {
+      lp_build_gather_s3tc_simple_scalar(gallivm, format_desc, &dxt_block,
+                                         ptr_addr);
+
+      switch (format_desc->format) {
+      case PIPE_FORMAT_DXT1_RGB:
+      case PIPE_FORMAT_DXT1_RGBA:
+      case PIPE_FORMAT_DXT1_SRGB:
+      case PIPE_FORMAT_DXT1_SRGBA:
+         s3tc_decode_block_dxt1(gallivm, format_desc->format, dxt_block, col);
+         break;
+      case PIPE_FORMAT_DXT3_RGBA:
+      case PIPE_FORMAT_DXT3_SRGBA:
+         s3tc_decode_block_dxt3(gallivm, format_desc->format, dxt_block, col);
+         break;
+      case PIPE_FORMAT_DXT5_RGBA:
+      case PIPE_FORMAT_DXT5_SRGBA:
+         s3tc_decode_block_dxt5(gallivm, format_desc->format, dxt_block, col);
+         break;
+      default:
+         assert(0);
+         s3tc_decode_block_dxt1(gallivm, format_desc->format, dxt_block, col);
+         break;
+      }
+   } else {
+      unpack_block_to_cache(gallivm, format_desc, ptr_addr, col);
    }
 
    tag_value = LLVMBuildPtrToInt(gallivm->builder, ptr_addr,
                                  LLVMInt64TypeInContext(gallivm->context), "");
+   tag_value = cache_tag(gallivm, format_desc, tag_value);
    s3tc_store_cached_block(gallivm, col, tag_value, hash_index, cache);
 
    LLVMBuildRetVoid(gallivm->builder);
@@ -2096,7 +2212,8 @@ compressed_fetch_cached(struct gallivm_state *gallivm,
          hash_indexx = LLVMBuildLShr(builder, block_indexx,
                                      lp_build_const_int32(gallivm, 4), "");
          offset_stored = s3tc_lookup_tag_data(gallivm, cache, hash_indexx);
-         cond = LLVMBuildICmp(builder, LLVMIntNE, offset_stored, addrx, "");
+         cond = LLVMBuildICmp(builder, LLVMIntNE, offset_stored,
+                              cache_tag(gallivm, format_desc, addrx), "");
 
          lp_build_if(&if_ctx, gallivm, cond);
          {
@@ -2123,7 +2240,8 @@ compressed_fetch_cached(struct gallivm_state *gallivm,
       tmp = LLVMBuildZExt(builder, offset, i64t, "");
       addr = LLVMBuildAdd(builder, tmp, addr, "");
       offset_stored = s3tc_lookup_tag_data(gallivm, cache, hash_index);
-      cond = LLVMBuildICmp(builder, LLVMIntNE, offset_stored, addr, "");
+      cond = LLVMBuildICmp(builder, LLVMIntNE, offset_stored,
+                           cache_tag(gallivm, format_desc, addr), "");
 
       lp_build_if(&if_ctx, gallivm, cond);
       {
@@ -2162,6 +2280,37 @@ s3tc_dxt5_to_rgba_aos(struct gallivm_state *gallivm,
 }
 
 
+/**
+ * Fetch pixels of a format for which lp_build_format_use_cache() is true
+ * through the block cache.
+ *
+ * @param n  number of pixels processed (n=1 or multiples of 4)
+ * @param base_ptr  base pointer (32bit or 64bit pointer depending on the architecture)
+ * @param offset <n x i32> vector with the relative offsets of the blocks
+ * @param i  is a <n x i32> vector with the x subpixel coordinate (0..3)
+ * @param j  is a <n x i32> vector with the y subpixel coordinate (0..3)
+ * @return  a <4*n x i8> vector with the pixel RGBA values in AoS, without
+ *          srgb conversion
+ */
+LLVMValueRef
+lp_build_fetch_cached_rgba_aos(struct gallivm_state *gallivm,
+                               const struct util_format_description *format_desc,
+                               unsigned n,
+                               LLVMValueRef base_ptr,
+                               LLVMValueRef offset,
+                               LLVMValueRef i,
+                               LLVMValueRef j,
+                               LLVMValueRef cache)
+{
+   assert(lp_build_format_use_cache(format_desc));
+   assert(cache);
+   assert((n == 1) || (n % 4 == 0));
+
+   return compressed_fetch_cached(gallivm, format_desc, n,
+                                  base_ptr, offset, i, j, cache);
+}
+
+
 /**
  * @param n  number of pixels processed (usually n=4, but it should also work with n=1
  *           and multiples of 4)
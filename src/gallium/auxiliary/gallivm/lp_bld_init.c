@@ -34,6 +34,7 @@
 #include "lp_bld_misc.h"
 #include "lp_bld_init.h"
 #include "lp_bld_coro.h"
+#include "lp_bld_format.h"
 #include "lp_bld_printf.h"
 #include "lp_bld_passmgr.h"
 
@@ -450,6 +451,7 @@ gallivm_compile_module(struct gallivm_state *gallivm)
    gallivm_add_global_mapping(gallivm, gallivm->get_time_hook, os_time_get_nano);
 
    lp_build_coro_add_malloc_hooks(gallivm);
+   lp_build_format_add_unpack_block_hook(gallivm);
 
    if (gallivm_debug & GALLIVM_DEBUG_ASM) {
       LLVMValueRef llvm_func = LLVMGetFirstFunction(gallivm->module);
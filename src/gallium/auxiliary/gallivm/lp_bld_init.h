@@ -86,6 +86,7 @@ struct gallivm_state
    LLVMMetadataRef file;
 
    LLVMValueRef get_time_hook;
+   LLVMValueRef unpack_block_hook;
 
    LLVMValueRef texture_descriptor;
    struct lp_jit_texture *texture_dynamic_state;
@@ -95,6 +96,9 @@ struct gallivm_state
 unsigned
 lp_build_init_native_width(void);
 
+unsigned
+lp_native_vector_registers(void);
+
 bool
 lp_build_init(void);
 
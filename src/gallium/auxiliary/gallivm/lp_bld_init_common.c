@@ -25,6 +25,7 @@
  *
  **************************************************************************/
 
+#include "util/detect_arch.h"
 #include "util/u_debug.h"
 #include "util/u_cpu_detect.h"
 #include "lp_bld_debug.h"
@@ -43,6 +44,7 @@ static const struct debug_named_value lp_bld_perf_flags[] = {
    { "no_aos_sampling", GALLIVM_PERF_NO_AOS_SAMPLING, "disable aos sampling optimization" },
    { "no_lod_ellipse", GALLIVM_PERF_NO_LOD_ELLIPSE, "disable LOD elliptical derivative transform" },
    { "nopt",   GALLIVM_PERF_NO_OPT, "disable optimization passes to speed up shader compilation" },
+   { "gcm",    GALLIVM_PERF_GCM, "schedule NIR code to fit the vector registers of the CPU" },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -79,6 +81,26 @@ lp_build_init_native_width(void)
    return lp_native_vector_width;
 }
 
+/**
+ * Number of SIMD registers of the CPU.  Every 32-bit SoA value of a shader
+ * takes one, so this is the number of values which can be live without
+ * spilling.
+ */
+unsigned
+lp_native_vector_registers(void)
+{
+#if DETECT_ARCH_X86_64
+   /* AVX-512 also doubles the number of xmm/ymm registers. */
+   return util_get_cpu_caps()->has_avx512f ? 32 : 16;
+#elif DETECT_ARCH_X86
+   return 8;
+#elif DETECT_ARCH_ARM
+   return 16;
+#else
+   return 32;
+#endif
+}
+
 void
 lp_init_env_options(void)
 {
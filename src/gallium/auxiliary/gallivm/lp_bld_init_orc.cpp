@@ -15,6 +15,7 @@
 #include "lp_bld_debug.h"
 #include "lp_bld_init.h"
 #include "lp_bld_coro.h"
+#include "lp_bld_format.h"
 #include "lp_bld_misc.h"
 #include "lp_bld_printf.h"
 #include "lp_bld_passmgr.h"
@@ -301,9 +302,19 @@ void lpjit_exit()
    delete LPJit::jit;
 }
 
+/* Module flag set on modules whose object code comes from the cache */
+#define LP_CACHED_OBJECT_FLAG "lp.cached_object"
+
 LLVMErrorRef module_transform(void *Ctx, LLVMModuleRef mod) {
    struct lp_passmgr *mgr;
 
+   /* The compile layer will pick up the cached object code and never look
+    * at the IR, so don't waste time optimizing it.
+    */
+   if (LLVMGetModuleFlag(mod, LP_CACHED_OBJECT_FLAG,
+                         strlen(LP_CACHED_OBJECT_FLAG)))
+      return LLVMErrorSuccess;
+
    lp_passmgr_create(mod, &mgr);
 
    lp_passmgr_run(mgr, mod,
@@ -646,6 +657,7 @@ gallivm_compile_module(struct gallivm_state *gallivm)
          (void *)os_time_get_nano);
 
    lp_build_coro_add_malloc_hooks(gallivm);
+   lp_build_format_add_unpack_block_hook(gallivm);
 
    /* Dump bitcode to a file */
    if (gallivm_debug & GALLIVM_DEBUG_DUMP_BC &&
@@ -664,6 +676,14 @@ gallivm_compile_module(struct gallivm_state *gallivm)
                    "[-mattr=<-mattr option(s)>]");
    }
 
+   if (gallivm->cache && gallivm->cache->data_size) {
+      LLVMValueRef one = LLVMConstInt(LLVMInt32TypeInContext(gallivm->context),
+                                      1, 0);
+      LLVMAddModuleFlag(gallivm->module, LLVMModuleFlagBehaviorOverride,
+                        LP_CACHED_OBJECT_FLAG, strlen(LP_CACHED_OBJECT_FLAG),
+                        LLVMValueAsMetadata(one));
+   }
+
    LPJit::add_ir_module_to_jd(gallivm->_ts_context, gallivm->module,
       gallivm->_per_module_jd);
    /* ownership of module is now transferred into orc jit,
@@ -487,6 +487,19 @@ do_alu_action(struct lp_build_nir_aos_context *bld,
    LLVMValueRef result = NULL;
 
    switch (instr->op) {
+   case nir_op_fadd:
+      /* Saturates, see llvmpipe_nir_fn_is_linear_compat() */
+      result = lp_build_add(get_flt_bld(bld, src_bit_size[0]),
+                            src[0], src[1]);
+      break;
+   case nir_op_fmax:
+      result = lp_build_max(get_flt_bld(bld, src_bit_size[0]),
+                            src[0], src[1]);
+      break;
+   case nir_op_fmin:
+      result = lp_build_min(get_flt_bld(bld, src_bit_size[0]),
+                            src[0], src[1]);
+      break;
    case nir_op_fmul:
       result = lp_build_mul(get_flt_bld(bld, src_bit_size[0]),
                             src[0], src[1]);
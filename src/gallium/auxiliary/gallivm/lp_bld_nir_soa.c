@@ -6146,6 +6146,13 @@ lp_build_nir_soa_prepasses(struct nir_shader *nir)
    NIR_PASS(_, nir, nir_remove_dead_derefs);
    NIR_PASS(_, nir, nir_remove_dead_variables, nir_var_function_temp, NULL);
 
+   if (gallivm_perf & GALLIVM_PERF_GCM) {
+      const nir_opt_gcm_options gcm_options = {
+         .register_budget = lp_native_vector_registers(),
+      };
+      NIR_PASS(_, nir, nir_opt_gcm_pressure, &gcm_options);
+   }
+
    NIR_PASS(_, nir, nir_lower_load_const_to_scalar);
 
    NIR_PASS(_, nir, nir_convert_to_lcssa, false, false);
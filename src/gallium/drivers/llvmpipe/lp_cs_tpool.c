@@ -86,6 +86,7 @@ lp_cs_tpool_worker(void *data)
             flush_denorms = true;
          }
       }
+      lmem.texture_cache_stale = true;
       for (unsigned i = 0; i < iter_per_thread; i++)
          task->work(task->data, this_iter + i, &lmem);
 
@@ -162,6 +163,7 @@ lp_cs_tpool_queue_task(struct lp_cs_tpool *pool,
       }
 
       memset(&lmem, 0, sizeof(lmem));
+      lmem.texture_cache_stale = true;
       for (unsigned t = 0; t < num_iters; t++) {
          work(data, t, &lmem);
       }
@@ -38,6 +38,7 @@
 
 #include "util/u_thread.h"
 #include "util/list.h"
+#include "gallivm/lp_bld_format.h"
 #include "lp_state_cs.h"
 
 #include "lp_limits.h"
@@ -55,6 +56,12 @@ struct lp_cs_tpool {
 struct lp_cs_local_mem {
    unsigned local_size;
    void *local_mem_ptr;
+
+   /* The texture block cache is cleared whenever the thread starts on a new
+    * batch of iterations, as the textures may have changed since the last.
+    */
+   bool texture_cache_stale;
+   struct lp_build_format_cache texture_cache;
 };
 
 typedef void (*lp_cs_tpool_task_func)(void *data, int iter_idx, struct lp_cs_local_mem *lmem);
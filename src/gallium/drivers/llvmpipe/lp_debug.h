@@ -65,6 +65,10 @@
 #define PERF_NO_ALPHATEST   0x80  	/* disable alpha testing */
 #define PERF_NO_RAST_LINEAR 0x100  	/* disable linear rast */
 #define PERF_NO_SHADE       0x200  	/* disable fragment shaders */
+#define PERF_NO_BIN_SORT    0x400  	/* rasterize bins in raster order */
+#define PERF_NO_SCENE_OVERLAP 0x800 	/* rasterize one scene at a time */
+#define PERF_NO_TEX_CACHE   0x1000 	/* decode compressed texels every time */
+#define PERF_DEFERRED       0x2000 	/* resolve visibility before shading */
 
 
 extern int LP_PERF;
@@ -219,7 +219,7 @@ typedef void
 
 
 #define LP_MAX_LINEAR_CONSTANTS 16
-#define LP_MAX_LINEAR_TEXTURES 2
+#define LP_MAX_LINEAR_TEXTURES 4
 #define LP_MAX_LINEAR_INPUTS 8
 
 
@@ -66,7 +66,13 @@
 
 #define LP_MAX_SAMPLES 8
 
-#define LP_MAX_THREADS 32
+#define LP_MAX_THREADS 128
+
+/**
+ * Max number of groups of rasterizer threads sharing a cache.  Each group
+ * is preferentially handed bins from its own band of tiles.
+ */
+#define LP_MAX_BIN_GROUPS 32
 
 
 /**
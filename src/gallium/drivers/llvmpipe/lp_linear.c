@@ -153,7 +153,8 @@ lp_fs_linear_run(const struct lp_rast_state *state,
                                  oow,
                                  a0[i+1],
                                  dadx[i+1],
-                                 dady[i+1])) {
+                                 dady[i+1],
+                                 rgba_order)) {
          if (LP_DEBUG & DEBUG_LINEAR2)
             debug_printf("  -- init_interp(%d) failed\n", i);
          goto fail;
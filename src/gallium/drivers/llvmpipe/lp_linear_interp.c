@@ -128,7 +128,8 @@ lp_linear_init_interp(struct lp_linear_interp *interp,
                       float oow,
                       const float *a0,
                       const float *dadx,
-                      const float *dady)
+                      const float *dady,
+                      bool rgba_order)
 {
    float s0[4];
    float dsdx[4];
@@ -202,15 +203,17 @@ lp_linear_init_interp(struct lp_linear_interp *interp,
    }
 
    interp->width = align(width, 4);
-   /* RGBA->BGRA swizzle here */
-   interp->a0    = _mm_setr_epi16(s0_fp[2], s0_fp[1], s0_fp[0], s0_fp[3],
-                                  s0_fp[6], s0_fp[5], s0_fp[4], s0_fp[7]);
+   /* RGBA->BGRA swizzle here, unless the framebuffer is RGBA too */
+   const unsigned r = rgba_order ? 0 : 2;
+   const unsigned b = rgba_order ? 2 : 0;
+   interp->a0    = _mm_setr_epi16(s0_fp[r], s0_fp[1], s0_fp[b], s0_fp[3],
+                                  s0_fp[r + 4], s0_fp[5], s0_fp[b + 4], s0_fp[7]);
 
-   interp->dadx  = _mm_setr_epi16(dsdx_fp[2], dsdx_fp[1], dsdx_fp[0], dsdx_fp[3],
-                                  dsdx_fp[2], dsdx_fp[1], dsdx_fp[0], dsdx_fp[3]);
+   interp->dadx  = _mm_setr_epi16(dsdx_fp[r], dsdx_fp[1], dsdx_fp[b], dsdx_fp[3],
+                                  dsdx_fp[r], dsdx_fp[1], dsdx_fp[b], dsdx_fp[3]);
 
-   interp->dady  = _mm_setr_epi16(dsdy_fp[2], dsdy_fp[1], dsdy_fp[0], dsdy_fp[3],
-                                  dsdy_fp[2], dsdy_fp[1], dsdy_fp[0], dsdy_fp[3]);
+   interp->dady  = _mm_setr_epi16(dsdy_fp[r], dsdy_fp[1], dsdy_fp[b], dsdy_fp[3],
+                                  dsdy_fp[r], dsdy_fp[1], dsdy_fp[b], dsdy_fp[3]);
 
    /* If the value is y-invariant, eagerly calculate it here and then
     * always return the precalculated value.
@@ -238,7 +241,8 @@ lp_linear_init_interp(struct lp_linear_interp *interp,
                       float oow,
                       const float *a0,
                       const float *dadx,
-                      const float *dady)
+                      const float *dady,
+                      bool rgba_order)
 {
    return false;
 }
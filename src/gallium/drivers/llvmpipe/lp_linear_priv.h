@@ -134,7 +134,8 @@ lp_linear_init_interp(struct lp_linear_interp *interp,
                       float oow,
                       const float *a0,
                       const float *dadx,
-                      const float *dady);
+                      const float *dady,
+                      bool rgba_order);
 
 bool
 lp_linear_init_sampler(struct lp_linear_sampler *samp,
@@ -25,6 +25,8 @@
  *
  **************************************************************************/
 
+#include <inttypes.h>
+
 #include "util/u_debug.h"
 #include "lp_debug.h"
 #include "lp_perf.h"
@@ -113,6 +115,12 @@ lp_print_counters(void)
       debug_printf("llvmpipe:   nr_rect_full_4x4:           %9u (%3.0f%% of %u)\n", lp_count.nr_rect_fully_covered_4, p1, total_4);
       debug_printf("llvmpipe:   nr_rect_part_4x4:           %9u (%3.0f%% of %u)\n", lp_count.nr_rect_partially_covered_4, p2, total_4);
 
+      debug_printf("llvmpipe: nr_hiz_rejected_64x64:        %9u\n", lp_count.nr_hiz_rejected_64);
+      debug_printf("llvmpipe: nr_hiz_rejected_16x16:        %9u\n", lp_count.nr_hiz_rejected_16);
+      debug_printf("llvmpipe: nr_deferred_64x64:            %9u\n", lp_count.nr_deferred_64);
+      debug_printf("llvmpipe:   nr_deferred_saved_4x4:      %9u\n", lp_count.nr_deferred_saved_4);
+      debug_printf("llvmpipe:   nr_deferred_saved_pixels:   %9" PRIu64 "\n", lp_count.nr_deferred_saved_pixels);
+
 
       debug_printf("llvmpipe: nr_color_tile_clear:          %9u\n", lp_count.nr_color_tile_clear);
       debug_printf("llvmpipe: nr_color_tile_load:           %9u\n", lp_count.nr_color_tile_load);
@@ -121,6 +129,18 @@ lp_print_counters(void)
       debug_printf("llvmpipe: nr_llvm_compiles:             %u\n", lp_count.nr_llvm_compiles);
       debug_printf("llvmpipe: total LLVM compile time:      %.2f sec\n", lp_count.llvm_compile_time / 1000000.0);
       debug_printf("llvmpipe: average LLVM compile time:    %.2f sec\n", lp_count.llvm_compile_time / 1000000.0 / lp_count.nr_llvm_compiles);
+      debug_printf("llvmpipe: nr_fs_async_compiles:         %u\n", lp_count.nr_fs_async_compiles);
+      debug_printf("llvmpipe: nr_fs_pending_draws:          %u\n", lp_count.nr_fs_pending_draws);
+      debug_printf("llvmpipe: nr_fs_compile_waits:          %u\n", lp_count.nr_fs_compile_waits);
+
+      p1 = 0.0;
+      if (lp_count.nr_tex_cache_access) {
+         p1 = 100.0 * (float) (lp_count.nr_tex_cache_access - lp_count.nr_tex_cache_miss) /
+              (float) lp_count.nr_tex_cache_access;
+      }
+
+      debug_printf("llvmpipe: nr_tex_cache_access:          %9" PRIu64 "\n", lp_count.nr_tex_cache_access);
+      debug_printf("llvmpipe:   nr_tex_cache_miss:          %9" PRIu64 " (%3.0f%% hits)\n", lp_count.nr_tex_cache_miss, p1);
 
    }
 }
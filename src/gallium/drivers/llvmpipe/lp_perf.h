@@ -62,12 +62,23 @@ struct lp_counters
    unsigned nr_rect_fully_covered_4;
    unsigned nr_rect_partially_covered_4;
    unsigned nr_non_empty_4;
+   unsigned nr_hiz_rejected_64;  /**< tiles not binned, behind the depth buffer */
+   unsigned nr_hiz_rejected_16;  /**< 16x16 blocks skipped by the rasterizer */
+   unsigned nr_deferred_64;      /**< tiles shaded after a visibility pass */
+   unsigned nr_deferred_saved_4; /**< 4x4 blocks not shaded, all hidden */
+   uint64_t nr_deferred_saved_pixels;  /**< hidden pixels not shaded */
    unsigned nr_llvm_compiles;
    int64_t llvm_compile_time;  /**< total, in microseconds */
+   unsigned nr_fs_async_compiles;  /**< fs variants compiled in background */
+   unsigned nr_fs_pending_draws;   /**< draws binned before their fs was ready */
+   unsigned nr_fs_compile_waits;   /**< scenes which waited for a fs compile */
 
    unsigned nr_color_tile_clear;
    unsigned nr_color_tile_load;
    unsigned nr_color_tile_store;
+
+   uint64_t nr_tex_cache_access;  /**< texels fetched through the block cache */
+   uint64_t nr_tex_cache_miss;    /**< blocks decoded into the block cache */
 };
 
 
@@ -28,6 +28,7 @@
 #include <limits.h>
 #include "util/u_memory.h"
 #include "util/u_math.h"
+#include "util/u_cpu_detect.h"
 #include "util/u_rect.h"
 #include "util/u_surface.h"
 #include "util/u_pack_color.h"
@@ -48,7 +49,6 @@
 #include "gallivm/lp_bld_debug.h"
 #include "lp_scene.h"
 #include "lp_screen.h"
-#include "lp_tex_sample.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -82,19 +82,10 @@ static void
 lp_rast_begin(struct lp_rasterizer *rast,
               struct lp_scene *scene)
 {
-   rast->curr_scene = scene;
-
    LP_DBG(DEBUG_RAST, "%s\n", __func__);
 
    lp_scene_begin_rasterization(scene);
-   lp_scene_bin_iter_begin(scene);
-}
-
-
-static void
-lp_rast_end(struct lp_rasterizer *rast)
-{
-   rast->curr_scene = NULL;
+   lp_scene_bin_iter_begin(scene, rast->num_bin_groups);
 }
 
 
@@ -123,6 +114,10 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
    task->thread_data.vis_counter = 0;
    task->thread_data.ps_invocations = 0;
 
+   /* The depth buffer contents are unknown until cleared. */
+   lp_rast_hiz_reset(task);
+   task->hiz_invalid = false;
+
    for (unsigned i = 0; i < scene->fb.nr_cbufs; i++) {
       if (scene->fb.cbufs[i].texture) {
          task->color_tiles[i] = scene->cbufs[i].map +
@@ -186,6 +181,40 @@ lp_rast_clear_color(struct lp_rasterizer_task *task,
 }
 
 
+/**
+ * Get the depth a z/stencil clear sets, if it clears all the depth bits.
+ */
+bool
+lp_rast_clear_zs_depth(enum pipe_format format,
+                       uint64_t value, uint64_t mask,
+                       float *depth)
+{
+   const uint64_t zmask = util_pack64_mask_z(format, ~0U);
+
+   if (!util_format_has_depth(util_format_description(format)) ||
+       (mask & zmask) != zmask)
+      return false;
+
+   switch (util_format_get_blocksize(format)) {
+   case 2: {
+      uint16_t z16 = (uint16_t) value;
+      util_format_unpack_z_float(format, depth, &z16, 1);
+      return true;
+   }
+   case 4: {
+      uint32_t z32 = (uint32_t) value;
+      util_format_unpack_z_float(format, depth, &z32, 1);
+      return true;
+   }
+   case 8:
+      util_format_unpack_z_float(format, depth, &value, 1);
+      return true;
+   default:
+      return false;
+   }
+}
+
+
 /**
  * Clear the rasterizer's current z/stencil tile.
  * This is a bin command called during bin processing.
@@ -294,6 +323,14 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
             dst_layer += scene->zsbuf.layer_stride;
          }
       }
+
+      float depth;
+      if (!task->hiz_invalid &&
+          lp_rast_clear_zs_depth(scene->fb.zsbuf.format,
+                                 clear_value64, clear_mask64, &depth)) {
+         for (unsigned i = 0; i < LP_HIZ_BLOCKS; i++)
+            task->hiz_zmax[i] = depth;
+      }
    }
 }
 
@@ -326,6 +363,21 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
 
    const struct lp_fragment_shader_variant *variant = state->variant;
 
+   if (task->hiz_cull &&
+       lp_rast_hiz_reject_16(task, inputs, 0xffff) == 0xffff)
+      return;
+
+   if (unlikely(task->deferred_pass != LP_DEFERRED_NONE)) {
+      for (unsigned y = 0; y < task->height; y += 4)
+         for (unsigned x = 0; x < task->width; x += 4)
+            lp_rast_shade_quads_mask(task, inputs, tile_x + x, tile_y + y,
+                                     0xffff);
+
+      if (task->hiz_occluder)
+         lp_rast_hiz_occlude_16(task, inputs, 0xffff);
+      return;
+   }
+
    unsigned view_index = inputs->view_index;
    /* render the whole 64x64 tile in 4x4 chunks */
    for (unsigned y = 0; y < task->height; y += 4){
@@ -389,6 +441,9 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
          END_JIT_CALL();
       }
    }
+
+   if (task->hiz_occluder)
+      lp_rast_hiz_occlude_16(task, inputs, 0xffff);
 }
 
 
@@ -474,6 +529,17 @@ lp_rast_shade_quads_mask_sample(struct lp_rasterizer_task *task,
     * allocated 4x4 blocks hence need to filter them out here.
     */
    if ((x % TILE_SIZE) < task->width && (y % TILE_SIZE) < task->height) {
+      uint64_t deferred_mask[2];
+
+      if (unlikely(task->deferred_pass != LP_DEFERRED_NONE)) {
+         deferred_mask[0] = lp_rast_deferred_block(task, inputs, x, y,
+                                                   mask[0] & 0xffff);
+         deferred_mask[1] = 0;
+         if (!deferred_mask[0])
+            return;
+         mask = deferred_mask;
+      }
+
       /* Propagate non-interpolated raster state. */
       task->thread_data.raster_state.viewport_index = inputs->viewport_index;
       task->thread_data.raster_state.view_index = inputs->view_index;
@@ -514,6 +580,70 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
 }
 
 
+/**
+ * Deferred shading of the pixels \p mask of the 4x4 block at x, y, called
+ * instead of the fragment shader.  The visibility pass records which
+ * fragments of the current command pass the depth test and returns 0, the
+ * shading pass returns the pixels to actually shade.
+ */
+unsigned
+lp_rast_deferred_block(struct lp_rasterizer_task *task,
+                       const struct lp_rast_shader_inputs *inputs,
+                       unsigned x, unsigned y,
+                       unsigned mask)
+{
+   struct lp_rast_deferred *deferred = task->deferred;
+   const unsigned tx = x % TILE_SIZE;
+   const unsigned ty = y % TILE_SIZE;
+   unsigned shade = 0;
+
+   if (task->deferred_pass == LP_DEFERRED_VISIBILITY) {
+      while (mask) {
+         const int i = u_bit_scan(&mask);
+         const unsigned px = tx + (i & 3);
+         const unsigned py = ty + (i >> 2);
+         const unsigned idx = py * TILE_SIZE + px;
+         float zmin, zmax;
+
+         if (deferred->fallback[py] & BITFIELD64_BIT(px))
+            continue;
+
+         lp_rast_depth_bounds(inputs, x + (i & 3), y + (i >> 2),
+                              x + (i & 3), y + (i >> 2),
+                              task->hiz_restrict, &zmin, &zmax);
+         if (zmax < deferred->zmin[idx]) {
+            /* Passes the depth test, hiding the previous fragments. */
+            deferred->zmin[idx] = zmin;
+            deferred->zmax[idx] = zmax;
+            deferred->prim[idx] = task->deferred_cmd;
+         } else if (!(zmin > deferred->zmax[idx])) {
+            /* Too close to tell, shade all the fragments in order. */
+            deferred->fallback[py] |= BITFIELD64_BIT(px);
+         }
+      }
+      return 0;
+   }
+
+   assert(task->deferred_pass == LP_DEFERRED_SHADE);
+
+   for (unsigned i = 0; i < 16; i++) {
+      const unsigned px = tx + (i & 3);
+      const unsigned py = ty + (i >> 2);
+
+      if ((mask & (1 << i)) &&
+          (deferred->prim[py * TILE_SIZE + px] == task->deferred_cmd ||
+           (deferred->fallback[py] & BITFIELD64_BIT(px))))
+         shade |= 1 << i;
+   }
+
+   LP_COUNT_ADD(nr_deferred_saved_pixels, util_bitcount(mask & ~shade));
+   if (!shade)
+      LP_COUNT(nr_deferred_saved_4);
+
+   return shade;
+}
+
+
 /**
  * Directly copy pixels from a texture to the destination color buffer.
  * This is a bin command called during bin processing.
@@ -697,7 +827,17 @@ void
 lp_rast_set_state(struct lp_rasterizer_task *task,
                   const union lp_rast_cmd_arg arg)
 {
+   const struct lp_fragment_shader_variant *variant = arg.set_state->variant;
+
    task->state = arg.set_state;
+
+   task->hiz_cull = variant->hiz_cull;
+   task->hiz_occluder = variant->hiz_occluder &&
+                        task->scene->fb_max_layer == 0;
+   task->hiz_restrict = variant->key.restrict_depth_values;
+   task->hiz_invalid = variant->hiz_invalidate;
+   if (task->hiz_invalid)
+      lp_rast_hiz_reset(task);
 }
 
 
@@ -976,6 +1116,174 @@ tri_rasterize_bin(struct lp_rasterizer_task *task,
 }
 
 
+/**
+ * Execute the commands [first, end) of a bin.
+ */
+static void
+rasterize_bin_range(struct lp_rasterizer_task *task,
+                    const struct cmd_bin *bin,
+                    unsigned first, unsigned end)
+{
+   unsigned j = 0;
+
+   for (const struct cmd_block *block = bin->head; block; block = block->next) {
+      for (unsigned k = 0; k < block->count; k++, j++) {
+         if (j < first)
+            continue;
+         if (j >= end)
+            return;
+
+         task->deferred_cmd = j;
+         dispatch_tri[block->cmd[k]](task, block->arg[k]);
+      }
+   }
+}
+
+
+/**
+ * Index of the first draw of a bin whose draws may be shaded deferred, or
+ * -1.  Only clears and states may precede it.
+ * \param count  returns the number of commands
+ */
+static int
+deferred_bin_start(const struct lp_rasterizer_task *task,
+                   const struct cmd_bin *bin,
+                   unsigned *count)
+{
+   const struct lp_scene *scene = task->scene;
+   unsigned j = 0, nr_draws = 0;
+   bool have_state = false;
+   int start = -1;
+
+   /* Queries count the fragments passing the depth test. */
+   if (!scene->zsbuf.map ||
+       scene->fb_max_layer > 0 ||
+       scene->fb_max_samples > 1 ||
+       scene->num_active_queries > 0)
+      return -1;
+
+   for (const struct cmd_block *block = bin->head; block; block = block->next) {
+      for (unsigned k = 0; k < block->count; k++, j++) {
+         switch (block->cmd[k]) {
+         case LP_RAST_OP_CLEAR_COLOR:
+         case LP_RAST_OP_CLEAR_ZSTENCIL:
+            if (start >= 0)
+               return -1;
+            break;
+         case LP_RAST_OP_SET_STATE:
+            if (!block->arg[k].set_state->variant->deferrable)
+               return -1;
+            have_state = true;
+            break;
+         case LP_RAST_OP_TRIANGLE_1:
+         case LP_RAST_OP_TRIANGLE_2:
+         case LP_RAST_OP_TRIANGLE_3:
+         case LP_RAST_OP_TRIANGLE_4:
+         case LP_RAST_OP_TRIANGLE_5:
+         case LP_RAST_OP_TRIANGLE_6:
+         case LP_RAST_OP_TRIANGLE_7:
+         case LP_RAST_OP_TRIANGLE_8:
+         case LP_RAST_OP_TRIANGLE_3_4:
+         case LP_RAST_OP_TRIANGLE_3_16:
+         case LP_RAST_OP_TRIANGLE_4_16:
+         case LP_RAST_OP_TRIANGLE_32_1:
+         case LP_RAST_OP_TRIANGLE_32_2:
+         case LP_RAST_OP_TRIANGLE_32_3:
+         case LP_RAST_OP_TRIANGLE_32_4:
+         case LP_RAST_OP_TRIANGLE_32_5:
+         case LP_RAST_OP_TRIANGLE_32_6:
+         case LP_RAST_OP_TRIANGLE_32_7:
+         case LP_RAST_OP_TRIANGLE_32_8:
+         case LP_RAST_OP_TRIANGLE_32_3_4:
+         case LP_RAST_OP_TRIANGLE_32_3_16:
+         case LP_RAST_OP_TRIANGLE_32_4_16:
+         case LP_RAST_OP_SHADE_TILE:
+         case LP_RAST_OP_RECTANGLE:
+            if (!have_state)
+               return -1;
+            if (start < 0)
+               start = j;
+            nr_draws++;
+            break;
+         default:
+            return -1;
+         }
+      }
+   }
+
+   /* Nothing to save without overdraw. */
+   if (nr_draws < 2 || j >= LP_DEFERRED_NO_PRIM)
+      return -1;
+
+   *count = j;
+   return start;
+}
+
+
+/**
+ * Rasterize a bin in two passes: the first one only finds which fragment
+ * of each pixel passes the depth test last, without running the fragment
+ * shaders, and the second one shades only those fragments.
+ *
+ * The visibility is resolved on conservative depth bounds: pixels where a
+ * depth test can't be decided are shaded for every fragment, as without
+ * deferring.  Returns false if the bin isn't suitable.
+ */
+static bool
+deferred_rasterize_bin(struct lp_rasterizer_task *task,
+                       const struct cmd_bin *bin)
+{
+   const struct lp_scene *scene = task->scene;
+   unsigned count;
+
+   const int start = deferred_bin_start(task, bin, &count);
+   if (start < 0)
+      return false;
+
+   if (!task->deferred) {
+      task->deferred = align_malloc(sizeof(*task->deferred), 64);
+      if (!task->deferred)
+         return false;
+   }
+
+   struct lp_rast_deferred *deferred = task->deferred;
+
+   /* Clears and states */
+   rasterize_bin_range(task, bin, 0, start);
+
+   const struct lp_rast_state *state = task->state;
+   float hiz_zmax[LP_HIZ_BLOCKS];
+   memcpy(hiz_zmax, task->hiz_zmax, sizeof(hiz_zmax));
+
+   /* Whole 4x4 blocks are shaded, past the edge of the framebuffer too. */
+   const unsigned width = align(task->width, TILE_VECTOR_WIDTH);
+   const unsigned height = align(task->height, TILE_VECTOR_HEIGHT);
+   for (unsigned y = 0; y < height; y++) {
+      float *zmin = &deferred->zmin[y * TILE_SIZE];
+
+      util_format_unpack_z_float(scene->fb.zsbuf.format, zmin,
+                                 task->depth_tile + y * scene->zsbuf.stride,
+                                 width);
+      memcpy(&deferred->zmax[y * TILE_SIZE], zmin, width * sizeof(*zmin));
+   }
+   memset(deferred->prim, 0xff, sizeof(deferred->prim));
+   memset(deferred->fallback, 0, sizeof(deferred->fallback));
+
+   task->deferred_pass = LP_DEFERRED_VISIBILITY;
+   rasterize_bin_range(task, bin, start, count);
+
+   /* Start over from the state after the clears. */
+   memcpy(task->hiz_zmax, hiz_zmax, sizeof(hiz_zmax));
+   lp_rast_set_state(task, lp_rast_arg_state(state));
+
+   task->deferred_pass = LP_DEFERRED_SHADE;
+   rasterize_bin_range(task, bin, start, count);
+
+   task->deferred_pass = LP_DEFERRED_NONE;
+   return true;
+}
+
+
 static void
 debug_rasterize_bin(struct lp_rasterizer_task *task,
                   const struct cmd_bin *bin)
@@ -1012,6 +1320,9 @@ rasterize_bin(struct lp_rasterizer_task *task,
             !(LP_PERF & PERF_NO_RAST_LINEAR) &&
             (info.type & LP_RAST_FLAGS_RECT)) {
       lp_linear_rasterize_bin(task, bin);
+   } else if ((LP_PERF & PERF_DEFERRED) &&
+              deferred_rasterize_bin(task, bin)) {
+      LP_COUNT(nr_deferred_64);
    } else {
       tri_rasterize_bin(task, bin, x, y);
    }
@@ -1057,16 +1368,14 @@ rasterize_scene(struct lp_rasterizer_task *task,
 {
    task->scene = scene;
 
-   /* Clear the cache tags. This should not always be necessary but
-    * simpler for now.
+   /* Clear the cache tags, as the textures may have been written or freed
+    * since the last scene.
     */
-#if LP_USE_TEXTURE_CACHE
    memset(task->thread_data.cache->cache_tags, 0,
           sizeof(task->thread_data.cache->cache_tags));
 #if LP_BUILD_FORMAT_CACHE_DEBUG
    task->thread_data.cache->cache_access_total = 0;
    task->thread_data.cache->cache_access_miss = 0;
-#endif
 #endif
 
    if (!task->rast->no_rast) {
@@ -1075,30 +1384,20 @@ rasterize_scene(struct lp_rasterizer_task *task,
       int i, j;
 
       assert(scene);
-      while ((bin = lp_scene_bin_iter_next(scene, &i, &j))) {
+      while ((bin = lp_scene_bin_iter_next(scene, task->bin_group,
+                                           &i, &j))) {
          if (!is_empty_bin(bin))
             rasterize_bin(task, bin, i, j);
       }
    }
 
 #if LP_BUILD_FORMAT_CACHE_DEBUG
-   {
-      uint64_t total, miss;
-      total = task->thread_data.cache->cache_access_total;
-      miss = task->thread_data.cache->cache_access_miss;
-      if (total) {
-         debug_printf("thread %d cache access %llu miss %llu hit rate %f\n",
-                 task->thread_index, (long long unsigned)total,
-                 (long long unsigned)miss,
-                 (float)(total - miss)/(float)total);
-      }
-   }
+   LP_COUNT_ADD(nr_tex_cache_access,
+                task->thread_data.cache->cache_access_total);
+   LP_COUNT_ADD(nr_tex_cache_miss,
+                task->thread_data.cache->cache_access_miss);
 #endif
 
-   if (scene->fence) {
-      lp_fence_signal(scene->fence);
-   }
-
    task->scene = NULL;
 }
 
@@ -1125,11 +1424,14 @@ lp_rast_queue_scene(struct lp_rasterizer *rast,
        */
       util_fpstate_set_denorms_to_zero(fpstate);
 
+      rast->curr_scene = scene;
+
       lp_rast_begin(rast, scene);
 
       rasterize_scene(&rast->tasks[0], scene);
 
-      lp_rast_end(rast);
+      if (scene->fence)
+         lp_fence_signal(scene->fence);
 
       util_fpstate_set(fpstate);
 
@@ -1162,6 +1464,100 @@ lp_rast_finish(struct lp_rasterizer *rast)
 }
 
 
+/**
+ * Get the next scene for a rasterizer thread.
+ *
+ * The first thread to get to a scene dequeues and begins it, so threads
+ * which are done with the previous scene can start on this one while the
+ * stragglers finish.  Only when the scene depends on a still unfinished
+ * earlier scene (see lp_scene_depends_on()) does the thread wait for that
+ * one to complete.
+ */
+static struct lp_scene *
+get_next_scene(struct lp_rasterizer *rast,
+               struct lp_rasterizer_task *task)
+{
+   const uint64_t seq = task->scene_seq;
+   const unsigned idx = seq % LP_RAST_MAX_SCENES_IN_FLIGHT;
+
+   mtx_lock(&rast->scene_mutex);
+
+   /* Don't reuse the slot of a scene other threads may still need to
+    * fetch.
+    */
+   while (rast->scenes_begun == seq &&
+          rast->scenes_done + LP_RAST_MAX_SCENES_IN_FLIGHT <= seq)
+      cnd_wait(&rast->scene_done_cond, &rast->scene_mutex);
+
+   if (rast->scenes_begun == seq) {
+      struct lp_scene *scene = lp_scene_dequeue(rast->full_scenes, true);
+      uint64_t wait_for = rast->scenes_done;
+
+      /* Unfinished scenes can't have been recycled by setup yet, as their
+       * fence is only signalled after scenes_done is updated.
+       */
+      for (uint64_t prev = seq; prev-- > rast->scenes_done; ) {
+         if ((LP_PERF & PERF_NO_SCENE_OVERLAP) ||
+             lp_scene_depends_on(scene,
+                rast->scenes[prev % LP_RAST_MAX_SCENES_IN_FLIGHT].scene)) {
+            wait_for = prev + 1;
+            break;
+         }
+      }
+
+      rast->scenes[idx].scene = scene;
+      rast->scenes[idx].wait_for = wait_for;
+      rast->scenes[idx].threads_done = 0;
+
+      lp_rast_begin(rast, scene);
+      rast->scenes_begun++;
+   }
+
+   while (rast->scenes_done < rast->scenes[idx].wait_for)
+      cnd_wait(&rast->scene_done_cond, &rast->scene_mutex);
+
+   struct lp_scene *scene = rast->scenes[idx].scene;
+
+   mtx_unlock(&rast->scene_mutex);
+
+   return scene;
+}
+
+
+/**
+ * Called by each rasterizer thread when it is done with its share of
+ * a scene.  The last thread to finish marks the scene done.
+ */
+static void
+finish_scene(struct lp_rasterizer *rast,
+             struct lp_rasterizer_task *task,
+             struct lp_scene *scene)
+{
+   const uint64_t seq = task->scene_seq;
+   const unsigned idx = seq % LP_RAST_MAX_SCENES_IN_FLIGHT;
+
+   /* The scene may be recycled as soon as the fence is signalled, so
+    * grab the fence first and only signal it once scenes_done is
+    * up to date.
+    */
+   struct lp_fence *fence = scene->fence;
+
+   mtx_lock(&rast->scene_mutex);
+   if (++rast->scenes[idx].threads_done == rast->num_threads) {
+      /* Threads rasterize scenes in order, so scenes complete in order */
+      assert(rast->scenes_done == seq);
+      rast->scenes_done = seq + 1;
+      cnd_broadcast(&rast->scene_done_cond);
+   }
+   mtx_unlock(&rast->scene_mutex);
+
+   if (fence)
+      lp_fence_signal(fence);
+
+   task->scene_seq++;
+}
+
+
 /**
  * This is the thread's main entrypoint.
  * It's a simple loop:
@@ -1186,6 +1582,14 @@ thread_function(void *init_data)
    unsigned fpstate = util_fpstate_get();
    util_fpstate_set_denorms_to_zero(fpstate);
 
+   /* Keep each thread on the L3 cache of its bin group.
+    */
+   if (rast->num_bin_groups > 1) {
+      const struct util_cpu_caps_t *caps = util_get_cpu_caps();
+      util_set_current_thread_affinity(caps->L3_affinity_mask[task->bin_group],
+                                       NULL, caps->num_cpu_mask_bits);
+   }
+
    while (1) {
       /* wait for work */
       if (debug)
@@ -1195,33 +1599,18 @@ thread_function(void *init_data)
       if (rast->exit_flag)
          break;
 
-      if (task->thread_index == 0) {
-         /* thread[0]:
-          *  - get next scene to rasterize
-          *  - map the framebuffer surfaces
-          */
-         lp_rast_begin(rast, lp_scene_dequeue(rast->full_scenes, true));
-      }
-
-      /* Wait for all threads to get here so that threads[1+] don't
-       * get a null rast->curr_scene pointer.
+      /* get the next scene to rasterize, mapping the framebuffer
+       * surfaces if we're the first thread to get there
        */
-      util_barrier_wait(&rast->barrier);
+      struct lp_scene *scene = get_next_scene(rast, task);
 
       /* do work */
       if (debug)
          debug_printf("thread %d doing work\n", task->thread_index);
 
-      rasterize_scene(task, rast->curr_scene);
+      rasterize_scene(task, scene);
 
-      /* wait for all threads to finish with this scene */
-      util_barrier_wait(&rast->barrier);
-
-      /* XXX: shouldn't be necessary:
-       */
-      if (task->thread_index == 0) {
-         lp_rast_end(rast);
-      }
+      finish_scene(rast, task, scene);
 
       /* signal done with work */
       if (debug)
@@ -1260,6 +1649,32 @@ create_rast_threads(struct lp_rasterizer *rast)
 }
 
 
+/**
+ * Split the rasterizer threads into groups, one per L3 cache, when
+ * LP_THREAD_AFFINITY is set.  Consecutive threads go to the same group,
+ * get pinned to that cache's CPUs and preferentially rasterize the same
+ * band of tiles.
+ */
+static void
+init_bin_groups(struct lp_rasterizer *rast)
+{
+   const struct util_cpu_caps_t *caps = util_get_cpu_caps();
+
+   rast->num_bin_groups = 1;
+
+   if (rast->num_threads < 2 ||
+       caps->num_L3_caches < 2 || !caps->L3_affinity_mask ||
+       !debug_get_bool_option("LP_THREAD_AFFINITY", false))
+      return;
+
+   rast->num_bin_groups = MIN3(caps->num_L3_caches, rast->num_threads,
+                               LP_MAX_BIN_GROUPS);
+
+   for (unsigned i = 0; i < rast->num_threads; i++)
+      rast->tasks[i].bin_group = i * rast->num_bin_groups / rast->num_threads;
+}
+
+
 /**
  * Create new lp_rasterizer.  If num_threads is zero, don't create any
  * new threads, do rendering synchronously.
@@ -1293,11 +1708,18 @@ lp_rast_create(unsigned num_threads)
 
    rast->no_rast = debug_get_bool_option("LP_NO_RAST", false);
 
+#ifdef USE_AVX512
+   rast->use_avx512 = util_get_cpu_caps()->has_avx512f;
+#endif
+
+   init_bin_groups(rast);
+
    create_rast_threads(rast);
 
    /* for synchronizing rasterization threads */
    if (rast->num_threads > 0) {
-      util_barrier_init(&rast->barrier, rast->num_threads);
+      (void) mtx_init(&rast->scene_mutex, mtx_plain);
+      cnd_init(&rast->scene_done_cond);
    }
 
    memset(lp_dummy_tile, 0, sizeof lp_dummy_tile);
@@ -1361,13 +1783,15 @@ lp_rast_destroy(struct lp_rasterizer *rast)
    }
    for (unsigned i = 0; i < MAX2(1, rast->num_threads); i++) {
       align_free(rast->tasks[i].thread_data.cache);
+      align_free(rast->tasks[i].deferred);
    }
 
    lp_fence_reference(&rast->last_fence, NULL);
 
    /* for synchronizing rasterization threads */
    if (rast->num_threads > 0) {
-      util_barrier_destroy(&rast->barrier);
+      mtx_destroy(&rast->scene_mutex);
+      cnd_destroy(&rast->scene_done_cond);
    }
 
    lp_scene_queue_destroy(rast->full_scenes);
@@ -38,6 +38,7 @@
 #define LP_RAST_H
 
 #include "util/compiler.h"
+#include "util/u_math.h"
 #include "util/u_pack_color.h"
 #include "util/u_rect.h"
 #include "lp_jit.h"
@@ -240,6 +241,74 @@ GET_PLANES(const struct lp_rast_triangle *tri)
 }
 
 
+/*
+ * Hierarchical Z.
+ *
+ * Setup (per tile) and the rasterizer (per 16x16 block) keep an upper bound
+ * of the depth buffer, which is valid as long as the depth values only
+ * decrease: it is set by depth clears, lowered by primitives fully
+ * covering a tile or block, and forgotten when a state that may increase
+ * the depth is used.  Primitives whose depth is above it fail a LESS or
+ * LEQUAL depth test everywhere and are skipped.
+ */
+
+/**
+ * Slack added to the depth bounds, which covers the quantization of the
+ * unorm depth formats (1/65535 for Z16) and rounding differences with the
+ * depth interpolation of the fragment shader.
+ */
+#define LP_HIZ_EPSILON (1.0f / (1 << 14))
+
+
+/**
+ * Conservative bounds of the depth the fragment shader interpolates for
+ * the primitive over the pixels [x0, x1) x [y0, y1), in window coordinates.
+ * Unknown bounds are returned as -inf, +inf.
+ */
+static inline void
+lp_rast_depth_bounds(const struct lp_rast_shader_inputs *inputs,
+                     int x0, int y0, int x1, int y1,
+                     bool restrict_depth,
+                     float *zmin, float *zmax)
+{
+   /* The polygon offset is kept in the x component of a0. */
+   const float a0 = GET_A0(inputs)[0][2] + GET_A0(inputs)[0][0];
+   const float zx0 = GET_DADX(inputs)[0][2] * (float)x0;
+   const float zx1 = GET_DADX(inputs)[0][2] * (float)x1;
+   const float zy0 = GET_DADY(inputs)[0][2] * (float)y0;
+   const float zy1 = GET_DADY(inputs)[0][2] * (float)y1;
+
+   /* Allow for the rounding of the float interpolation too. */
+   const float slack = LP_HIZ_EPSILON +
+      (fabsf(a0) + MAX2(fabsf(zx0), fabsf(zx1)) +
+       MAX2(fabsf(zy0), fabsf(zy1))) * (1.0f / (1 << 20));
+
+   float lo = a0 + MIN2(zx0, zx1) + MIN2(zy0, zy1) - slack;
+   float hi = a0 + MAX2(zx0, zx1) + MAX2(zy0, zy1) + slack;
+
+   if (!(lo <= hi)) {
+      /* NaN or infinite coefficients */
+      *zmin = -INFINITY;
+      *zmax = INFINITY;
+      return;
+   }
+
+   if (restrict_depth) {
+      lo = CLAMP(lo, 0.0f, 1.0f);
+      hi = CLAMP(hi, 0.0f, 1.0f);
+   }
+
+   *zmin = lo;
+   *zmax = hi;
+}
+
+
+bool
+lp_rast_clear_zs_depth(enum pipe_format format,
+                       uint64_t value, uint64_t mask,
+                       float *depth);
+
+
 struct lp_rasterizer *
 lp_rast_create(unsigned num_threads);
 
@@ -32,6 +32,7 @@
 #include "util/u_thread.h"
 #include "gallivm/lp_bld_debug.h"
 #include "lp_memory.h"
+#include "lp_perf.h"
 #include "lp_rast.h"
 #include "lp_scene.h"
 #include "lp_state.h"
@@ -42,6 +43,9 @@
 #define TILE_VECTOR_HEIGHT 4
 #define TILE_VECTOR_WIDTH 4
 
+/** Number of 16x16 blocks in a tile, with hierarchical Z bounds */
+#define LP_HIZ_BLOCKS ((TILE_SIZE / 16) * (TILE_SIZE / 16))
+
 /* If we crash in a jitted function, we can examine jit_line and jit_state
  * to get some info.  This is not thread-safe, however.
  */
@@ -76,6 +80,37 @@ extern const struct lp_rasterizer_task *jit_task;
 struct lp_rasterizer;
 struct cmd_bin;
 
+
+/** lp_rast_deferred::prim of pixels no fragment passes the depth test at */
+#define LP_DEFERRED_NO_PRIM 0xffff
+
+/**
+ * Visibility of the pixels of a tile, see deferred_rasterize_bin().
+ */
+struct lp_rast_deferred
+{
+   /** Bounds of the depth buffer contents */
+   float zmin[TILE_SIZE * TILE_SIZE];
+   float zmax[TILE_SIZE * TILE_SIZE];
+
+   /** Index of the command whose fragment ends up in the pixel */
+   uint16_t prim[TILE_SIZE * TILE_SIZE];
+
+   /** Pixels where the depth test result isn't known, to shade serially */
+   uint64_t fallback[TILE_SIZE];
+};
+
+enum lp_rast_deferred_pass {
+   LP_DEFERRED_NONE,
+   LP_DEFERRED_VISIBILITY,  /**< only record the visibility of fragments */
+   LP_DEFERRED_SHADE,       /**< only shade the visible fragments */
+};
+
+/**
+ * Max number of scenes the rasterizer threads may be spread across.
+ */
+#define LP_RAST_MAX_SCENES_IN_FLIGHT 8
+
 /**
  * Per-thread rasterization state
  */
@@ -97,6 +132,24 @@ struct lp_rasterizer_task
    /** "my" index */
    unsigned thread_index;
 
+   /** Sequence number of the next scene this thread will rasterize */
+   uint64_t scene_seq;
+
+   /** Group of threads sharing a cache this thread belongs to */
+   unsigned bin_group;
+
+   /** Hierarchical Z, see lp_rast_depth_bounds() */
+   float hiz_zmax[LP_HIZ_BLOCKS];  /**< depth upper bound of 16x16 blocks */
+   bool hiz_cull;       /**< current state skips blocks behind hiz_zmax */
+   bool hiz_occluder;   /**< current state lowers hiz_zmax */
+   bool hiz_restrict;   /**< current state clamps the depth to [0, 1] */
+   bool hiz_invalid;    /**< current state may increase the depth */
+
+   /** Deferred shading, see deferred_rasterize_bin() */
+   struct lp_rast_deferred *deferred;
+   enum lp_rast_deferred_pass deferred_pass;
+   unsigned deferred_cmd;  /**< index of the current command in the bin */
+
    /** Non-interpolated passthru state and occlude counter for visible pixels */
    struct lp_jit_thread_data thread_data;
 
@@ -117,11 +170,12 @@ struct lp_rasterizer
 {
    bool exit_flag;
    bool no_rast;  /**< For debugging/profiling */
+   bool use_avx512;  /**< Evaluate triangle coverage with AVX-512 */
 
    /** The incoming queue of scenes ready to rasterize */
    struct lp_scene_queue *full_scenes;
 
-   /** The scene currently being rasterized by the threads */
+   /** The scene currently being rasterized, when not threaded */
    struct lp_scene *curr_scene;
 
    /** A task object for each rasterization thread */
@@ -130,8 +184,27 @@ struct lp_rasterizer
    unsigned num_threads;
    thrd_t threads[LP_MAX_THREADS];
 
+   /** Number of bin groups, see lp_rasterizer_task::bin_group */
+   unsigned num_bin_groups;
+
+   /**
+    * Scenes being rasterized by the threads, indexed by sequence number
+    * modulo LP_RAST_MAX_SCENES_IN_FLIGHT.  Threads done with one scene
+    * move on to the next one while other threads still finish the
+    * previous ones, unless the next scene depends on them.
+    */
+   struct {
+      struct lp_scene *scene;
+      uint64_t wait_for;      /**< scenes_done needed before starting */
+      unsigned threads_done;  /**< threads finished with this scene */
+   } scenes[LP_RAST_MAX_SCENES_IN_FLIGHT];
+
+   uint64_t scenes_begun;  /**< number of scenes dequeued and begun */
+   uint64_t scenes_done;   /**< number of scenes finished by all threads */
+
    /** For synchronizing the rasterization threads */
-   util_barrier barrier;
+   mtx_t scene_mutex;
+   cnd_t scene_done_cond;
 
    struct lp_fence *last_fence;
 };
@@ -149,6 +222,12 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
                          unsigned x, unsigned y,
                          unsigned mask);
 
+unsigned
+lp_rast_deferred_block(struct lp_rasterizer_task *task,
+                       const struct lp_rast_shader_inputs *inputs,
+                       unsigned x, unsigned y,
+                       unsigned mask);
+
 
 /**
  * Get the pointer to a 4x4 color block (within a 64x64 tile).
@@ -239,6 +318,12 @@ lp_rast_shade_quads_all(struct lp_rasterizer_task *task,
    unsigned depth_sample_stride = 0;
    unsigned view_index = inputs->view_index;
 
+   if (unlikely(task->deferred_pass != LP_DEFERRED_NONE)) {
+      /* Only some pixels may need shading. */
+      lp_rast_shade_quads_mask(task, inputs, x, y, 0xffff);
+      return;
+   }
+
    /* color buffer */
    for (unsigned i = 0; i < scene->fb.nr_cbufs; i++) {
       if (scene->fb.cbufs[i].texture) {
@@ -294,6 +379,102 @@ lp_rast_shade_quads_all(struct lp_rasterizer_task *task,
    }
 }
 
+
+/**
+ * Forget the depth bounds of the current tile.
+ */
+static inline void
+lp_rast_hiz_reset(struct lp_rasterizer_task *task)
+{
+   for (unsigned i = 0; i < LP_HIZ_BLOCKS; i++)
+      task->hiz_zmax[i] = INFINITY;
+}
+
+
+/**
+ * Return the 16x16 blocks of the current tile, among \p mask, where the
+ * primitive is entirely behind the depth buffer.
+ * \param mask  bit (iy * 4 + ix) for the block at (ix * 16, iy * 16)
+ */
+static inline unsigned
+lp_rast_hiz_reject_16(const struct lp_rasterizer_task *task,
+                      const struct lp_rast_shader_inputs *inputs,
+                      unsigned mask)
+{
+   unsigned rejected = 0;
+
+   while (mask) {
+      const int i = u_bit_scan(&mask);
+      const int x = task->x + (i & 3) * 16;
+      const int y = task->y + (i >> 2) * 16;
+      float zmin, zmax;
+
+      lp_rast_depth_bounds(inputs, x, y, x + 16, y + 16,
+                           task->hiz_restrict, &zmin, &zmax);
+      if (zmin > task->hiz_zmax[i])
+         rejected |= 1 << i;
+   }
+
+   LP_COUNT_ADD(nr_hiz_rejected_16, util_bitcount(rejected));
+   return rejected;
+}
+
+
+/**
+ * Whether a primitive contained in the size x size block at x, y (in window
+ * coords, within the current tile) is entirely behind the depth buffer.
+ */
+static inline bool
+lp_rast_hiz_reject_block(const struct lp_rasterizer_task *task,
+                         const struct lp_rast_shader_inputs *inputs,
+                         int x, int y, unsigned size)
+{
+   const unsigned ix0 = (x - task->x) / 16;
+   const unsigned iy0 = (y - task->y) / 16;
+   const unsigned ix1 = (x - task->x + size - 1) / 16;
+   const unsigned iy1 = (y - task->y + size - 1) / 16;
+   float hiz_zmax = -INFINITY, zmin, zmax;
+
+   assert(ix1 < TILE_SIZE / 16 && iy1 < TILE_SIZE / 16);
+
+   for (unsigned iy = iy0; iy <= iy1; iy++)
+      for (unsigned ix = ix0; ix <= ix1; ix++)
+         hiz_zmax = MAX2(hiz_zmax, task->hiz_zmax[iy * (TILE_SIZE / 16) + ix]);
+
+   lp_rast_depth_bounds(inputs, x, y, x + size, y + size,
+                        task->hiz_restrict, &zmin, &zmax);
+   if (zmin > hiz_zmax) {
+      LP_COUNT(nr_hiz_rejected_16);
+      return true;
+   }
+
+   return false;
+}
+
+
+/**
+ * Lower the depth bounds of the 16x16 blocks in \p mask, which the
+ * primitive fully covers.
+ */
+static inline void
+lp_rast_hiz_occlude_16(struct lp_rasterizer_task *task,
+                       const struct lp_rast_shader_inputs *inputs,
+                       unsigned mask)
+{
+   while (mask) {
+      const int i = u_bit_scan(&mask);
+      const int x = task->x + (i & 3) * 16;
+      const int y = task->y + (i >> 2) * 16;
+      float zmin, zmax;
+
+      lp_rast_depth_bounds(inputs, x, y, x + 16, y + 16,
+                           task->hiz_restrict, &zmin, &zmax);
+      if (zmax < task->hiz_zmax[i])
+         task->hiz_zmax[i] = zmax;
+   }
+}
+
+
 void
 lp_rast_triangle_1(struct lp_rasterizer_task *, const union lp_rast_cmd_arg);
 
@@ -363,6 +544,37 @@ void
 lp_rast_triangle_32_4_16(struct lp_rasterizer_task *,
                          const union lp_rast_cmd_arg);
 
+/**
+ * Coverage of a 4x4 block, as found by the specialized small triangle
+ * rasterizers.
+ */
+struct lp_rast_block_mask {
+   unsigned mask:16;  /**< pixels outside of the triangle */
+   unsigned i:8;      /**< row of the block, in 4 pixel units */
+   unsigned j:8;      /**< column of the block, in 4 pixel units */
+};
+
+#if DETECT_ARCH_SSE
+unsigned
+lp_rast_tri_32_3_16_masks(const struct lp_rast_plane *plane, int x, int y,
+                          struct lp_rast_block_mask out[16]);
+
+unsigned
+lp_rast_tri_32_3_4_mask(const struct lp_rast_plane *plane, int x, int y);
+#endif
+
+#ifdef USE_AVX512
+/* Defined in lp_rast_tri_avx512.c, only to be called if has_avx512f */
+unsigned
+lp_rast_tri_32_3_16_masks_avx512(const struct lp_rast_plane *plane,
+                                 int x, int y,
+                                 struct lp_rast_block_mask out[16]);
+
+unsigned
+lp_rast_tri_32_3_4_mask_avx512(const struct lp_rast_plane *plane,
+                               int x, int y);
+#endif
+
 void
 lp_rast_rectangle(struct lp_rasterizer_task *,
                   const union lp_rast_cmd_arg);
@@ -201,16 +201,15 @@ build_mask_linear_32(int c, int dcdx, int dcdy)
 
 #define HAS_RAST_TRIANGLE_3_16_SIMD 1
 
-void
-lp_rast_triangle_32_3_16(struct lp_rasterizer_task *task,
-                         const union lp_rast_cmd_arg arg)
+/**
+ * Find the 4x4 blocks of the 16x16 block at x, y which are not entirely
+ * outside of a 3 plane triangle, and their masks.
+ * \return number of blocks written to out
+ */
+unsigned
+lp_rast_tri_32_3_16_masks(const struct lp_rast_plane *plane, int x, int y,
+                          struct lp_rast_block_mask out[16])
 {
-   const struct lp_rast_triangle *tri = arg.triangle.tri;
-   const struct lp_rast_plane *plane = GET_PLANES(tri);
-   const int x = (arg.triangle.plane_mask & 0xff) + task->x;
-   const int y = (arg.triangle.plane_mask >> 8) + task->y;
-
-   struct { unsigned mask:16; unsigned i:8; unsigned j:8; } out[16];
    unsigned nr = 0;
 
    /* p0 and p2 are aligned, p1 is not (plane size 24 bytes). */
@@ -309,6 +308,31 @@ lp_rast_triangle_32_3_16(struct lp_rasterizer_task *task,
       c = _mm_add_epi32(c, _mm_slli_epi32(dcdy, 2));
    }
 
+   return nr;
+}
+
+void
+lp_rast_triangle_32_3_16(struct lp_rasterizer_task *task,
+                         const union lp_rast_cmd_arg arg)
+{
+   const struct lp_rast_triangle *tri = arg.triangle.tri;
+   const struct lp_rast_plane *plane = GET_PLANES(tri);
+   const int x = (arg.triangle.plane_mask & 0xff) + task->x;
+   const int y = (arg.triangle.plane_mask >> 8) + task->y;
+   struct lp_rast_block_mask out[16];
+   unsigned nr;
+
+   if (task->hiz_cull &&
+       lp_rast_hiz_reject_block(task, &tri->inputs, x, y, 16))
+      return;
+
+#ifdef USE_AVX512
+   if (task->rast->use_avx512)
+      nr = lp_rast_tri_32_3_16_masks_avx512(plane, x, y, out);
+   else
+#endif
+      nr = lp_rast_tri_32_3_16_masks(plane, x, y, out);
+
    for (unsigned i = 0; i < nr; i++)
       lp_rast_shade_quads_mask(task,
                                &tri->inputs,
@@ -319,15 +343,13 @@ lp_rast_triangle_32_3_16(struct lp_rasterizer_task *task,
 
 #define HAS_RAST_TRIANGLE_3_4_SIMD 1
 
-void
-lp_rast_triangle_32_3_4(struct lp_rasterizer_task *task,
-                        const union lp_rast_cmd_arg arg)
+/**
+ * Mask of the pixels of the 4x4 block at x, y which are outside of a
+ * 3 plane triangle.
+ */
+unsigned
+lp_rast_tri_32_3_4_mask(const struct lp_rast_plane *plane, int x, int y)
 {
-   const struct lp_rast_triangle *tri = arg.triangle.tri;
-   const struct lp_rast_plane *plane = GET_PLANES(tri);
-   const unsigned x = (arg.triangle.plane_mask & 0xff) + task->x;
-   const unsigned y = (arg.triangle.plane_mask >> 8) + task->y;
-
    /* p0 and p2 are aligned, p1 is not (plane size 24 bytes). */
    __m128i p0 = _mm_load_si128((__m128i *)&plane[0]); /* clo, chi, dcdx, dcdy */
    __m128i p1 = _mm_loadu_si128((__m128i *)&plane[1]);
@@ -394,17 +416,39 @@ lp_rast_triangle_32_3_4(struct lp_rasterizer_task *task,
       __m128i c_23 = _mm_packs_epi32(c_2, c_3);
       __m128i c_0123 = _mm_packs_epi16(c_01, c_23);
 
-      unsigned mask = _mm_movemask_epi8(c_0123);
-
-      if (mask != 0xffff)
-         lp_rast_shade_quads_mask(task,
-                                  &tri->inputs,
-                                  x,
-                                  y,
-                                  0xffff & ~mask);
+      return _mm_movemask_epi8(c_0123);
    }
 }
 
+void
+lp_rast_triangle_32_3_4(struct lp_rasterizer_task *task,
+                        const union lp_rast_cmd_arg arg)
+{
+   const struct lp_rast_triangle *tri = arg.triangle.tri;
+   const struct lp_rast_plane *plane = GET_PLANES(tri);
+   const int x = (arg.triangle.plane_mask & 0xff) + task->x;
+   const int y = (arg.triangle.plane_mask >> 8) + task->y;
+   unsigned mask;
+
+   if (task->hiz_cull &&
+       lp_rast_hiz_reject_block(task, &tri->inputs, x, y, 4))
+      return;
+
+#ifdef USE_AVX512
+   if (task->rast->use_avx512)
+      mask = lp_rast_tri_32_3_4_mask_avx512(plane, x, y);
+   else
+#endif
+      mask = lp_rast_tri_32_3_4_mask(plane, x, y);
+
+   if (mask != 0xffff)
+      lp_rast_shade_quads_mask(task,
+                               &tri->inputs,
+                               x,
+                               y,
+                               0xffff & ~mask);
+}
+
 /* Defined in lp_rast_tri_tmp.h */
 #define HAS_RAST_TRIANGLE_4_16_SIMD 1
 
@@ -552,6 +596,10 @@ lp_rast_triangle_32_3_16(struct lp_rasterizer_task *task,
    struct { unsigned mask:16; unsigned i:8; unsigned j:8; } out[16];
    unsigned nr = 0;
 
+   if (task->hiz_cull &&
+       lp_rast_hiz_reject_block(task, &tri->inputs, x, y, 16))
+      return;
+
    __m128i p0 = lp_plane_to_m128i(&plane[0]); /* c, dcdx, dcdy, eo */
    __m128i p1 = lp_plane_to_m128i(&plane[1]); /* c, dcdx, dcdy, eo */
    __m128i p2 = lp_plane_to_m128i(&plane[2]); /* c, dcdx, dcdy, eo */
@@ -0,0 +1,122 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * AVX-512 versions of the small triangle coverage functions of
+ * lp_rast_tri.c.
+ *
+ * A 512 bit vector holds the edge function values of all the pixels of a
+ * 4x4 block (or of all the 4x4 blocks of a 16x16 block), so the coverage
+ * is a single compare into a mask register, instead of the saturating
+ * packs and movemask needed with SSE.
+ *
+ * This file is built with -mavx512f: its functions may only be called when
+ * util_get_cpu_caps()->has_avx512f is set.
+ */
+
+#include <immintrin.h>
+
+#include "util/u_math.h"
+#include "lp_rast_priv.h"
+
+
+/**
+ * dcdx * i + dcdy * j for each pixel (i, j) of a 4x4 block, in the order of
+ * the coverage masks.
+ */
+static inline __m512i
+span_4x4(int32_t dcdx, int32_t dcdy)
+{
+   const __m512i i = _mm512_setr_epi32(0, 1, 2, 3, 0, 1, 2, 3,
+                                       0, 1, 2, 3, 0, 1, 2, 3);
+   const __m512i j = _mm512_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1,
+                                       2, 2, 2, 2, 3, 3, 3, 3);
+
+   return _mm512_add_epi32(_mm512_mullo_epi32(i, _mm512_set1_epi32(dcdx)),
+                           _mm512_mullo_epi32(j, _mm512_set1_epi32(dcdy)));
+}
+
+
+/**
+ * Edge function value at pixel x, y, biased so that only the sign bit needs
+ * to be checked, with the same 32 bit arithmetic as the SSE code.
+ */
+static inline int32_t
+plane_c(const struct lp_rast_plane *plane, int x, int y)
+{
+   uint32_t c = (uint32_t)plane->c -
+                (uint32_t)plane->dcdx * ((uint32_t)x << FIXED_ORDER) +
+                (uint32_t)plane->dcdy * ((uint32_t)y << FIXED_ORDER) - 1;
+
+   return (int32_t)c >> FIXED_ORDER;
+}
+
+
+unsigned
+lp_rast_tri_32_3_16_masks_avx512(const struct lp_rast_plane *plane,
+                                 int x, int y,
+                                 struct lp_rast_block_mask out[16])
+{
+   const __m512i zero = _mm512_setzero_si512();
+   __m512i cblock[3];   /* value at the top left pixel of each 4x4 block */
+   __m512i span[3];     /* offsets of the pixels within a 4x4 block */
+   __mmask16 live = 0xffff;
+   unsigned nr = 0;
+
+   for (unsigned j = 0; j < 3; j++) {
+      const int32_t dcdx = -plane[j].dcdx;
+      const int32_t dcdy = plane[j].dcdy;
+      const int32_t rej = (MAX2(dcdy, 0) - MIN2(plane[j].dcdx, 0)) * 4 + 1;
+
+      cblock[j] = _mm512_add_epi32(_mm512_set1_epi32(plane_c(&plane[j], x, y)),
+                                   span_4x4(dcdx * 4, dcdy * 4));
+      span[j] = span_4x4(dcdx, dcdy);
+
+      /* Trivially reject the blocks entirely outside of the plane. */
+      live &= ~_mm512_cmplt_epi32_mask(
+         _mm512_add_epi32(cblock[j], _mm512_set1_epi32(rej)), zero);
+   }
+
+   while (live) {
+      const unsigned k = ffs(live) - 1;
+      const __m512i lane = _mm512_set1_epi32(k);
+
+      live &= live - 1;
+
+      __m512i c0 = _mm512_add_epi32(_mm512_permutexvar_epi32(lane, cblock[0]),
+                                    span[0]);
+      __m512i c1 = _mm512_add_epi32(_mm512_permutexvar_epi32(lane, cblock[1]),
+                                    span[1]);
+      __m512i c2 = _mm512_add_epi32(_mm512_permutexvar_epi32(lane, cblock[2]),
+                                    span[2]);
+
+      /* c0 | c1 | c2 is negative if the pixel is outside of any plane. */
+      __m512i c = _mm512_ternarylogic_epi32(c0, c1, c2, 0xfe);
+      unsigned mask = _mm512_cmplt_epi32_mask(c, zero);
+
+      out[nr].i = k >> 2;
+      out[nr].j = k & 3;
+      out[nr].mask = mask;
+      if (mask != 0xffff)
+         nr++;
+   }
+
+   return nr;
+}
+
+
+unsigned
+lp_rast_tri_32_3_4_mask_avx512(const struct lp_rast_plane *plane,
+                               int x, int y)
+{
+   __m512i c = _mm512_setzero_si512();
+
+   for (unsigned j = 0; j < 3; j++) {
+      c = _mm512_or_si512(c, _mm512_add_epi32(
+                                _mm512_set1_epi32(plane_c(&plane[j], x, y)),
+                                span_4x4(-plane[j].dcdx, plane[j].dcdy)));
+   }
+
+   return _mm512_cmplt_epi32_mask(c, _mm512_setzero_si512());
+}
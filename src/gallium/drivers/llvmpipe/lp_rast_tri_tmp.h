@@ -237,6 +237,17 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
 
    LP_COUNT_ADD(nr_empty_16, util_bitcount(0xffff & ~(partial_mask | inmask)));
 
+   /* Skip the blocks behind the depth buffer:
+    */
+   if (task->hiz_cull) {
+      const unsigned rejected =
+         lp_rast_hiz_reject_16(task, &tri->inputs, partial_mask | inmask);
+      partial_mask &= ~rejected;
+      inmask &= ~rejected;
+   }
+
+   const unsigned full_mask = inmask;
+
    /* Iterate over partials:
     */
    while (partial_mask) {
@@ -272,6 +283,9 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
       LP_COUNT(nr_fully_covered_16);
       block_full_16(task, tri, px, py);
    }
+
+   if (task->hiz_occluder)
+      lp_rast_hiz_occlude_16(task, &tri->inputs, full_mask);
 }
 
 
@@ -305,6 +319,10 @@ TRI_16(struct lp_rasterizer_task *task,
    x += task->x;
    y += task->y;
 
+   if (task->hiz_cull &&
+       lp_rast_hiz_reject_block(task, &tri->inputs, x, y, 16))
+      return;
+
    for (unsigned j = 0; j < NR_PLANES; j++) {
       const int64_t c = plane[j].c +
          IMUL64_FIXED(plane[j].dcdy, y) -
@@ -25,6 +25,9 @@
  *
  **************************************************************************/
 
+#include <stdlib.h>
+
+#include "util/u_atomic.h"
 #include "util/u_framebuffer.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
@@ -34,6 +37,7 @@
 #include "lp_scene.h"
 #include "lp_fence.h"
 #include "lp_debug.h"
+#include "lp_perf.h"
 #include "lp_context.h"
 #include "lp_state_fs.h"
 #include "lp_setup_context.h"
@@ -103,6 +107,7 @@ lp_scene_destroy(struct lp_scene *scene)
    lp_scene_end_rasterization(scene);
    mtx_destroy(&scene->mutex);
    free(scene->tiles);
+   free(scene->bin_order);
    assert(scene->data.head == &scene->data.first);
    slab_free_st(&scene->setup->scene_slab, scene);
 }
@@ -147,6 +152,7 @@ lp_scene_bin_reset(struct lp_scene *scene, unsigned x, unsigned y)
    struct cmd_bin *bin = lp_scene_get_bin(scene, x, y);
 
    bin->last_state = NULL;
+   bin->cost = 0;
    bin->head = bin->tail;
    if (bin->tail) {
       bin->tail->next = NULL;
@@ -185,6 +191,25 @@ init_scene_texture(struct lp_scene_surface *ssurf, struct pipe_surface *psurf)
 }
 
 
+/**
+ * Wait for the fragment shader variants of the scene which are still
+ * compiling in the background.  Done before queuing the scene, so that
+ * rasterizer threads never block on a compile.
+ */
+void
+lp_scene_wait_fs_variants(struct lp_scene *scene)
+{
+   for (struct shader_ref *ref = scene->frag_shaders; ref; ref = ref->next) {
+      for (int i = 0; i < ref->count; i++) {
+         if (!lp_fs_variant_is_ready(ref->variant[i])) {
+            LP_COUNT(nr_fs_compile_waits);
+            util_queue_fence_wait(&ref->variant[i]->ready);
+         }
+      }
+   }
+}
+
+
 void
 lp_scene_begin_rasterization(struct lp_scene *scene)
 {
@@ -534,60 +559,157 @@ lp_scene_is_resource_referenced(const struct lp_scene *scene,
 }
 
 
-/** advance curr_x,y to the next bin */
+/**
+ * Does \p scene write \p resource?  Unlike lp_scene_is_resource_referenced(),
+ * this doesn't stop at the read references, a resource bound for both reading
+ * and writing is in both lists.
+ */
 static bool
-next_bin(struct lp_scene *scene)
+lp_scene_writes_resource(const struct lp_scene *scene,
+                         const struct pipe_resource *resource)
 {
-   scene->curr_x++;
-   if (scene->curr_x >= scene->tiles_x) {
-      scene->curr_x = 0;
-      scene->curr_y++;
+   const struct resource_ref *ref;
+
+   for (unsigned j = 0; j < scene->fb.nr_cbufs; j++) {
+      if (scene->fb.cbufs[j].texture == resource)
+         return true;
    }
-   if (scene->curr_y >= scene->tiles_y) {
-      /* no more bins */
-      return false;
+   if (scene->fb.zsbuf.texture == resource)
+      return true;
+
+   for (ref = scene->writeable_resources; ref; ref = ref->next) {
+      for (int i = 0; i < ref->count; i++)
+         if (ref->resource[i] == resource)
+            return true;
    }
-   return true;
+
+   return false;
 }
 
 
+/**
+ * Does rasterizing \p scene have to wait for \p prev to complete?
+ * That's the case when either scene writes a resource the other one
+ * references.  Framebuffer attachments count as written.
+ */
+bool
+lp_scene_depends_on(const struct lp_scene *scene,
+                    const struct lp_scene *prev)
+{
+   const struct resource_ref *ref;
+
+   for (unsigned i = 0; i < scene->fb.nr_cbufs; i++) {
+      const struct pipe_resource *tex = scene->fb.cbufs[i].texture;
+      if (tex && lp_scene_is_resource_referenced(prev, tex))
+         return true;
+   }
+   if (scene->fb.zsbuf.texture &&
+       lp_scene_is_resource_referenced(prev, scene->fb.zsbuf.texture))
+      return true;
+
+   for (ref = scene->resources; ref; ref = ref->next) {
+      for (int i = 0; i < ref->count; i++)
+         if (lp_scene_writes_resource(prev, ref->resource[i]))
+            return true;
+   }
+
+   for (ref = scene->writeable_resources; ref; ref = ref->next) {
+      for (int i = 0; i < ref->count; i++)
+         if (lp_scene_is_resource_referenced(prev, ref->resource[i]))
+            return true;
+   }
+
+   return false;
+}
+
+
+static int
+compare_bin_order(const void *a, const void *b)
+{
+   const uint32_t ka = *(const uint32_t *)a;
+   const uint32_t kb = *(const uint32_t *)b;
+   return (ka > kb) - (ka < kb);
+}
+
+
+/**
+ * Prepare the lists of bins handed out by lp_scene_bin_iter_next().
+ * Called once per scene by one thread, before the rasterizer threads
+ * start pulling bins.
+ *
+ * The tile rows are split into \p num_groups horizontal bands, one per
+ * group of threads sharing a cache, so that each group works on
+ * spatially adjacent tiles.  Within a band, empty bins are dropped and
+ * the remaining ones are sorted so that the most expensive bins are
+ * started first (ties keep raster order).  This keeps a single late,
+ * expensive bin from leaving the other threads idle at the end of the
+ * scene.
+ */
 void
-lp_scene_bin_iter_begin(struct lp_scene *scene)
+lp_scene_bin_iter_begin(struct lp_scene *scene, unsigned num_groups)
 {
-   scene->curr_x = scene->curr_y = -1;
+   unsigned n = 0;
+
+   STATIC_ASSERT(TILES_X * TILES_Y <= (1 << 16));
+   assert(num_groups >= 1 && num_groups <= LP_MAX_BIN_GROUPS);
+
+   for (unsigned g = 0; g < num_groups; g++) {
+      struct lp_bin_group *group = &scene->bin_groups[g];
+      const unsigned row_begin = g * scene->tiles_y / num_groups;
+      const unsigned row_end = (g + 1) * scene->tiles_y / num_groups;
+
+      group->begin = n;
+      for (unsigned i = row_begin * scene->tiles_x;
+           i < row_end * scene->tiles_x; i++) {
+         const struct cmd_bin *bin = &scene->tiles[i];
+         if (bin->head) {
+            const uint32_t cost = MIN2(bin->cost, UINT16_MAX);
+            scene->bin_order[n++] = ((UINT16_MAX - cost) << 16) | i;
+         }
+      }
+      group->end = n;
+      group->next = group->begin;
+
+      if (group->end - group->begin > 1 && !(LP_PERF & PERF_NO_BIN_SORT))
+         qsort(scene->bin_order + group->begin, group->end - group->begin,
+               sizeof(scene->bin_order[0]), compare_bin_order);
+   }
+
+   scene->num_bin_groups = num_groups;
 }
 
 
 /**
  * Return pointer to next bin to be rendered.
- * The lp_scene::curr_x and ::curr_y fields will be advanced.
  * Multiple rendering threads will call this function to get a chunk
- * of work (a bin) to work on.
+ * of work (a bin) to work on.  Bins are claimed with an atomic
+ * increment so no lock is taken.  A thread drains its own \p group
+ * first and then steals from the other groups.
  */
 struct cmd_bin *
-lp_scene_bin_iter_next(struct lp_scene *scene , int *x, int *y)
+lp_scene_bin_iter_next(struct lp_scene *scene, unsigned group,
+                       int *x, int *y)
 {
-   struct cmd_bin *bin = NULL;
+   for (unsigned g = 0; g < scene->num_bin_groups; g++) {
+      struct lp_bin_group *grp =
+         &scene->bin_groups[(group + g) % scene->num_bin_groups];
 
-   mtx_lock(&scene->mutex);
+      if (p_atomic_read(&grp->next) >= grp->end)
+         continue;
 
-   if (scene->curr_x < 0) {
-      /* first bin */
-      scene->curr_x = 0;
-      scene->curr_y = 0;
-   } else if (!next_bin(scene)) {
-      /* no more bins left */
-      goto end;
-   }
+      const unsigned slot = p_atomic_inc_return(&grp->next) - 1;
+      if (slot >= grp->end)
+         continue;
 
-   bin = lp_scene_get_bin(scene, scene->curr_x, scene->curr_y);
-   *x = scene->curr_x;
-   *y = scene->curr_y;
+      const unsigned idx = scene->bin_order[slot] & UINT16_MAX;
+      *x = idx % scene->tiles_x;
+      *y = idx / scene->tiles_x;
 
-end:
-   /*printf("return bin %p at %d, %d\n", (void *) bin, *bin_x, *bin_y);*/
-   mtx_unlock(&scene->mutex);
-   return bin;
+      /*printf("return bin %u at %d, %d\n", idx, *x, *y);*/
+      return &scene->tiles[idx];
+   }
+
+   return NULL;
 }
 
 
@@ -610,6 +732,10 @@ lp_scene_begin_binning(struct lp_scene *scene,
                                   sizeof(struct cmd_bin));
       if (!scene->tiles)
          return;
+      scene->bin_order = reallocarray(scene->bin_order, num_required_tiles,
+                                      sizeof(uint32_t));
+      if (!scene->bin_order)
+         return;
       memset(scene->tiles, 0, sizeof(struct cmd_bin) * num_required_tiles);
       scene->num_alloced_tiles = num_required_tiles;
    }
@@ -35,6 +35,7 @@
 #ifndef LP_SCENE_H
 #define LP_SCENE_H
 
+#include "util/u_memory.h"
 #include "util/u_thread.h"
 #include "lp_rast.h"
 #include "lp_debug.h"
@@ -98,6 +99,9 @@ struct cmd_bin {
    const struct lp_rast_state *last_state;  /* most recent state set in bin */
    struct cmd_block *head;
    struct cmd_block *tail;
+   unsigned cost;  /* estimated rasterization cost (commands binned) */
+   float hiz_zmax;  /* depth upper bound after the commands binned so far */
+   bool hiz_valid;  /* whether hiz_zmax is known */
 };
 
 
@@ -120,6 +124,16 @@ struct resource_ref;
 
 struct shader_ref;
 
+/**
+ * A range of lp_scene::bin_order handed out to the rasterizer threads
+ * of one bin group.
+ */
+struct lp_bin_group {
+   unsigned begin, end;
+   /** next bin_order slot to hand out (atomic) */
+   EXCLUSIVE_CACHELINE(unsigned next);
+};
+
 struct lp_scene_surface {
    uint8_t *map;
    unsigned stride;
@@ -197,7 +211,15 @@ struct lp_scene {
     */
    unsigned tiles_x, tiles_y;
 
-   int curr_x, curr_y;  /**< for iterating over bins */
+   /**
+    * Non-empty bins, filled in by lp_scene_bin_iter_begin().  Each entry
+    * packs the inverted cost in the high 16 bits and the bin index in the
+    * low 16 bits.  The array is split into one range per bin group, each
+    * covering a horizontal band of tiles and sorted most expensive first.
+    */
+   uint32_t *bin_order;
+   struct lp_bin_group bin_groups[LP_MAX_BIN_GROUPS];
+   unsigned num_bin_groups;
    mtx_t mutex;
 
    unsigned num_alloced_tiles;
@@ -231,6 +253,9 @@ unsigned lp_scene_is_resource_referenced(const struct lp_scene *scene,
 bool lp_scene_add_frag_shader_reference(struct lp_scene *scene,
                                         struct lp_fragment_shader_variant *variant);
 
+bool lp_scene_depends_on(const struct lp_scene *scene,
+                         const struct lp_scene *prev);
+
 
 
 /**
@@ -346,6 +371,8 @@ lp_scene_bin_command(struct lp_scene *scene,
       tail->count++;
    }
 
+   bin->cost++;
+
    return true;
 }
 
@@ -400,10 +427,11 @@ lp_scene_get_num_bins(const struct lp_scene *scene)
 
 
 void
-lp_scene_bin_iter_begin(struct lp_scene *scene);
+lp_scene_bin_iter_begin(struct lp_scene *scene, unsigned num_groups);
 
 struct cmd_bin *
-lp_scene_bin_iter_next(struct lp_scene *scene, int *x, int *y);
+lp_scene_bin_iter_next(struct lp_scene *scene, unsigned group,
+                       int *x, int *y);
 
 
 
@@ -419,6 +447,9 @@ lp_scene_end_binning(struct lp_scene *scene);
 
 /* Begin/end rasterization of a scene
  */
+void
+lp_scene_wait_fs_variants(struct lp_scene *scene);
+
 void
 lp_scene_begin_rasterization(struct lp_scene *scene);
 
@@ -102,6 +102,10 @@ static const struct debug_named_value lp_perf_flags[] = {
    { "no_alphatest",   PERF_NO_ALPHATEST, NULL },
    { "no_rast_linear", PERF_NO_RAST_LINEAR, NULL },
    { "no_shade",       PERF_NO_SHADE, NULL },
+   { "no_bin_sort",    PERF_NO_BIN_SORT, NULL },
+   { "no_scene_overlap", PERF_NO_SCENE_OVERLAP, NULL },
+   { "no_tex_cache",   PERF_NO_TEX_CACHE, NULL },
+   { "deferred",       PERF_DEFERRED, NULL },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -799,6 +803,9 @@ llvmpipe_destroy_screen(struct pipe_screen *_screen)
    if (screen->rast)
       lp_rast_destroy(screen->rast);
 
+   if (util_queue_is_initialized(&screen->fs_compile_queue))
+      util_queue_destroy(&screen->fs_compile_queue);
+
    lp_jit_screen_cleanup(screen);
 
    disk_cache_destroy(screen->disk_shader_cache);
@@ -994,6 +1001,18 @@ llvmpipe_screen_late_init(struct llvmpipe_screen *screen)
    lp_build_init(); /* get lp_native_vector_width initialised */
 
    lp_disk_cache_create(screen);
+
+   unsigned num_compile_threads =
+      MIN2(debug_get_num_option("LP_FS_COMPILE_THREADS", 0), LP_MAX_THREADS);
+   if (num_compile_threads &&
+       !util_queue_init(&screen->fs_compile_queue, "lpfs", 64,
+                        num_compile_threads,
+                        UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                        UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY, NULL)) {
+      mesa_loge("llvmpipe: failed to create shader compiler queue, "
+                "compiling on the draw thread\n");
+   }
+
    screen->late_init_done = true;
 out:
    mtx_unlock(&screen->late_mutex);
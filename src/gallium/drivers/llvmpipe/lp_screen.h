@@ -38,6 +38,7 @@
 #include "pipe/p_defines.h"
 #include "util/u_thread.h"
 #include "util/list.h"
+#include "util/u_queue.h"
 #include "util/mesa-blake3.h"
 #include "util/vma.h"
 #include "gallivm/lp_bld.h"
@@ -64,6 +65,9 @@ struct llvmpipe_screen
    struct lp_cs_tpool *cs_tpool;
    mtx_t cs_mutex;
 
+   /* Background fragment shader variant compilation (LP_FS_COMPILE_THREADS) */
+   struct util_queue fs_compile_queue;
+
    mtx_t late_mutex;
    bool late_init_done;
 
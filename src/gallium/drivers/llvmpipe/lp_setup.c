@@ -49,6 +49,7 @@
 #include "lp_texture.h"
 #include "lp_debug.h"
 #include "lp_fence.h"
+#include "lp_perf.h"
 #include "lp_query.h"
 #include "lp_rast.h"
 #include "lp_setup_context.h"
@@ -238,6 +239,8 @@ lp_setup_rasterize_scene(struct lp_setup_context *setup)
 
    lp_scene_end_binning(scene);
 
+   lp_scene_wait_fs_variants(scene);
+
    mtx_lock(&screen->rast_mutex);
    lp_rast_queue_scene(screen->rast, scene);
    mtx_unlock(&screen->rast_mutex);
@@ -248,6 +251,113 @@ lp_setup_rasterize_scene(struct lp_setup_context *setup)
 }
 
 
+/**
+ * Set the depth bounds of all the tiles after a z/stencil clear.
+ */
+static void
+lp_setup_hiz_clear(struct lp_setup_context *setup,
+                   uint64_t zsvalue, uint64_t zsmask)
+{
+   const struct lp_fragment_shader_variant *variant =
+      setup->fs.current.variant;
+   struct lp_scene *scene = setup->scene;
+   float depth;
+
+   if (!lp_rast_clear_zs_depth(setup->fb.zsbuf.format, zsvalue, zsmask,
+                               &depth))
+      return;
+
+   /* Nothing is known if the next draws may increase the depth. */
+   const bool valid = !variant || !variant->hiz_invalidate;
+
+   for (unsigned y = 0; y < scene->tiles_y; y++) {
+      for (unsigned x = 0; x < scene->tiles_x; x++) {
+         struct cmd_bin *bin = lp_scene_get_bin(scene, x, y);
+         bin->hiz_zmax = valid ? depth : INFINITY;
+         bin->hiz_valid = valid;
+      }
+   }
+}
+
+
+/**
+ * Forget the depth bounds of all the tiles.
+ */
+static void
+lp_setup_hiz_invalidate(struct lp_setup_context *setup)
+{
+   struct lp_scene *scene = setup->scene;
+
+   for (unsigned y = 0; y < scene->tiles_y; y++)
+      for (unsigned x = 0; x < scene->tiles_x; x++)
+         lp_scene_get_bin(scene, x, y)->hiz_valid = false;
+}
+
+
+/**
+ * Whether the primitive is entirely behind the depth buffer on the part of
+ * tile tx, ty within \p box, so that it needn't be binned there.
+ */
+bool
+lp_setup_hiz_reject(const struct lp_setup_context *setup,
+                    const struct lp_rast_shader_inputs *inputs,
+                    int tx, int ty, const struct u_rect *box)
+{
+   const struct lp_fragment_shader_variant *variant =
+      setup->fs.current.variant;
+
+   if (!variant->hiz_cull)
+      return false;
+
+   const struct cmd_bin *bin = lp_scene_get_bin(setup->scene, tx, ty);
+   if (!bin->hiz_valid)
+      return false;
+
+   float zmin, zmax;
+   lp_rast_depth_bounds(inputs,
+                        MAX2(box->x0, tx * TILE_SIZE),
+                        MAX2(box->y0, ty * TILE_SIZE),
+                        MIN2(box->x1 + 1, (tx + 1) * TILE_SIZE),
+                        MIN2(box->y1 + 1, (ty + 1) * TILE_SIZE),
+                        variant->key.restrict_depth_values, &zmin, &zmax);
+   if (zmin > bin->hiz_zmax) {
+      LP_COUNT(nr_hiz_rejected_64);
+      return true;
+   }
+
+   return false;
+}
+
+
+/**
+ * Lower the depth bound of tile tx, ty, which the primitive fully covers.
+ */
+void
+lp_setup_hiz_occlude(struct lp_setup_context *setup,
+                     const struct lp_rast_shader_inputs *inputs,
+                     int tx, int ty)
+{
+   const struct lp_fragment_shader_variant *variant =
+      setup->fs.current.variant;
+   struct lp_scene *scene = setup->scene;
+
+   if (!variant->hiz_occluder || scene->fb_max_layer > 0)
+      return;
+
+   struct cmd_bin *bin = lp_scene_get_bin(scene, tx, ty);
+   float zmin, zmax;
+   lp_rast_depth_bounds(inputs, tx * TILE_SIZE, ty * TILE_SIZE,
+                        (tx + 1) * TILE_SIZE, (ty + 1) * TILE_SIZE,
+                        variant->key.restrict_depth_values, &zmin, &zmax);
+   if (bin->hiz_valid) {
+      bin->hiz_zmax = MIN2(bin->hiz_zmax, zmax);
+   } else if (zmax < INFINITY) {
+      bin->hiz_zmax = zmax;
+      bin->hiz_valid = true;
+   }
+}
+
+
 static bool
 begin_binning(struct lp_setup_context *setup)
 {
@@ -312,6 +422,7 @@ begin_binning(struct lp_setup_context *setup)
                                          setup->clear.zsmask))) {
             return false;
          }
+         lp_setup_hiz_clear(setup, setup->clear.zsvalue, setup->clear.zsmask);
       }
    }
 
@@ -560,6 +671,7 @@ lp_setup_try_clear_zs(struct lp_setup_context *setup,
                                    LP_RAST_OP_CLEAR_ZSTENCIL,
                                    lp_rast_arg_clearzs(zsvalue, zsmask)))
          return false;
+      lp_setup_hiz_clear(setup, zsvalue, zsmask);
    } else {
       /* Put ourselves into the 'pre-clear' state, specifically to try
        * and accumulate multiple clears to color and depth_stencil
@@ -1162,6 +1274,9 @@ try_update_scene_state(struct lp_setup_context *setup)
 
          stored->variant = setup->fs.current.variant;
 
+         if (stored->variant->hiz_invalidate)
+            lp_setup_hiz_invalidate(setup);
+
          if (!lp_scene_add_frag_shader_reference(scene,
                                                  setup->fs.current.variant)) {
             return false;
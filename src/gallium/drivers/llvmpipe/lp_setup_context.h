@@ -253,6 +253,16 @@ bool
 lp_setup_is_blit(const struct lp_setup_context *setup,
                  const struct lp_rast_shader_inputs *inputs);
 
+bool
+lp_setup_hiz_reject(const struct lp_setup_context *setup,
+                    const struct lp_rast_shader_inputs *inputs,
+                    int tx, int ty, const struct u_rect *box);
+
+void
+lp_setup_hiz_occlude(struct lp_setup_context *setup,
+                     const struct lp_rast_shader_inputs *inputs,
+                     int tx, int ty);
+
 void
 lp_setup_print_triangle(struct lp_setup_context *setup,
                         const float (*v0)[4],
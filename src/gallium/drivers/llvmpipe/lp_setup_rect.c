@@ -89,6 +89,8 @@ lp_setup_whole_tile(struct lp_setup_context *setup,
 
    LP_COUNT(nr_fully_covered_64);
 
+   lp_setup_hiz_occlude(setup, inputs, tx, ty);
+
    /* if variant is opaque and scissor doesn't effect the tile */
    if (opaque) {
       /* Several things prevent this optimization from working:
@@ -813,6 +813,9 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
       assert(iy0 == bbox->y1 / TILE_SIZE &&
              ix0 == bbox->x1 / TILE_SIZE);
 
+      if (lp_setup_hiz_reject(setup, &tri->inputs, ix0, iy0, &trimmed_box))
+         return true;
+
       if (nr_planes == 3) {
          if (sz < 4) {
             /* Triangle is contained in a single 4x4 stamp:
@@ -934,6 +937,10 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
                if (in)
                   break;  /* exiting triangle, all done with this row */
                LP_COUNT(nr_empty_64);
+            } else if (lp_setup_hiz_reject(setup, &tri->inputs, x, y,
+                                           &trimmed_box)) {
+               /* triangle is behind the depth buffer in this tile */
+               in = true;
             } else if (partial) {
                /* Not trivially accepted by at least one plane -
                 * rasterize/shade partial tile
@@ -182,6 +182,13 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const uint16_t *indices, uint nr
    if (!lp_setup_update_state(setup, true))
       return;
 
+   struct lp_fragment_shader_variant *fs_variant =
+      setup->fs.current.variant;
+   if (!lp_fs_variant_is_ready(fs_variant))
+      LP_COUNT(nr_fs_pending_draws);
+   else if (fs_variant->compile_failed)
+      return;
+
    const bool uses_constant_interp =
       setup->setup.variant->key.uses_constant_interp;
 
@@ -390,6 +397,13 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
    if (!lp_setup_update_state(setup, true))
       return;
 
+   struct lp_fragment_shader_variant *fs_variant =
+      setup->fs.current.variant;
+   if (!lp_fs_variant_is_ready(fs_variant))
+      LP_COUNT(nr_fs_pending_draws);
+   else if (fs_variant->compile_failed)
+      return;
+
    const bool uses_constant_interp =
       setup->setup.variant->key.uses_constant_interp;
 
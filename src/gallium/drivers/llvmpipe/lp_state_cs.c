@@ -1692,6 +1692,13 @@ cs_exec_fn(void *init_data, int iter_idx, struct lp_cs_local_mem *lmem)
 
    thread_data.payload = job_info->payload;
 
+   if (lmem->texture_cache_stale) {
+      memset(lmem->texture_cache.cache_tags, 0,
+             sizeof(lmem->texture_cache.cache_tags));
+      lmem->texture_cache_stale = false;
+   }
+   thread_data.cache = &lmem->texture_cache;
+
    unsigned grid_z, grid_y, grid_x;
 
    if (job_info->use_iters) {
@@ -1726,6 +1733,13 @@ cs_exec_fn(void *init_data, int iter_idx, struct lp_cs_local_mem *lmem)
                          job_info->work_dim, job_info->draw_id,
                          io_ptr,
                          &thread_data);
+
+#if LP_BUILD_FORMAT_CACHE_DEBUG
+   LP_COUNT_ADD(nr_tex_cache_access, lmem->texture_cache.cache_access_total);
+   LP_COUNT_ADD(nr_tex_cache_miss, lmem->texture_cache.cache_access_miss);
+   lmem->texture_cache.cache_access_total = 0;
+   lmem->texture_cache.cache_access_miss = 0;
+#endif
 }
 
 
@@ -710,6 +710,7 @@ fs_fb_fetch(const struct lp_build_fs_iface *iface,
 static void
 generate_fs_loop(struct gallivm_state *gallivm,
                  struct lp_fragment_shader *shader,
+                 struct nir_shader *nir,
                  const struct lp_fragment_shader_variant_key *key,
                  LLVMBuilderRef builder,
                  struct lp_type type,
@@ -746,7 +747,6 @@ generate_fs_loop(struct gallivm_state *gallivm,
    LLVMValueRef min_depth_bounds = NULL, max_depth_bounds = NULL;
    struct lp_build_for_loop_state loop_state, sample_loop_state = {0};
    struct lp_build_mask_context mask;
-   struct nir_shader *nir = shader->base.ir.nir;
    const bool dual_source_blend = key->blend.rt[0].blend_enable &&
                                   util_blend_state_is_dual(&key->blend, 0);
    const bool post_depth_coverage = nir->info.fs.post_depth_coverage;
@@ -3166,13 +3166,13 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
 static void
 generate_fragment(struct llvmpipe_context *lp,
                   struct lp_fragment_shader *shader,
+                  struct nir_shader *nir,
                   struct lp_fragment_shader_variant *variant,
                   unsigned partial_mask)
 {
    assert(partial_mask == RAST_WHOLE ||
           partial_mask == RAST_EDGE_TEST);
 
-   struct nir_shader *nir = shader->base.ir.nir;
    struct gallivm_state *gallivm = variant->gallivm;
    struct lp_fragment_shader_variant_key *key = &variant->key;
    struct lp_shader_input inputs[PIPE_MAX_SHADER_INPUTS];
@@ -3513,7 +3513,7 @@ generate_fragment(struct llvmpipe_context *lp,
                                x, y);
 
       generate_fs_loop(gallivm,
-                       shader, key,
+                       shader, nir, key,
                        builder,
                        fs_type,
                        variant->jit_context_type,
@@ -3807,6 +3807,10 @@ lp_debug_fs_variant(struct lp_fragment_shader_variant *variant)
    debug_printf("variant->opaque = %u\n", variant->opaque);
    debug_printf("variant->potentially_opaque = %u\n", variant->potentially_opaque);
    debug_printf("variant->blit = %u\n", variant->blit);
+   debug_printf("variant->hiz_cull = %u\n", variant->hiz_cull);
+   debug_printf("variant->hiz_occluder = %u\n", variant->hiz_occluder);
+   debug_printf("variant->hiz_invalidate = %u\n", variant->hiz_invalidate);
+   debug_printf("variant->deferrable = %u\n", variant->deferrable);
    debug_printf("shader->kind = %s\n", lp_debug_fs_kind(variant->shader->kind));
    debug_printf("\n");
 }
@@ -3835,9 +3839,242 @@ lp_fs_get_ir_cache_key(struct lp_fragment_shader_variant *variant,
 }
 
 
+/**
+ * Return why the pipeline state of a variant rules out the linear path,
+ * or NULL if it doesn't.
+ */
+static const char *
+linear_pipeline_reject_reason(const struct lp_fragment_shader_variant_key *key,
+                              const struct nir_shader *nir)
+{
+   if (key->stencil[0].enabled)
+      return "stencil test";
+   if (key->depth.enabled)
+      return "depth test";
+   if (key->depth.depth_bounds_test)
+      return "depth bounds test";
+   if (nir->info.fs.uses_discard)
+      return "discard";
+   if (key->blend.logicop_enable)
+      return "logic op";
+   if (key->cbuf_format[0] != PIPE_FORMAT_B8G8R8A8_UNORM &&
+       key->cbuf_format[0] != PIPE_FORMAT_B8G8R8X8_UNORM &&
+       key->cbuf_format[0] != PIPE_FORMAT_R8G8B8A8_UNORM &&
+       key->cbuf_format[0] != PIPE_FORMAT_R8G8B8X8_UNORM)
+      return "color buffer format";
+   return NULL;
+}
+
+
+/**
+ * State needed to finish compiling a variant once its analysis is done.
+ */
+struct lp_fs_compile_job
+{
+   struct llvmpipe_context *lp;
+   struct llvmpipe_screen *screen;
+   struct lp_fragment_shader_variant *variant;
+   bool linear_pipeline;
+   bool fullcolormask;
+};
+
+
+/**
+ * Generate and compile the LLVM code of a fragment shader variant.
+ *
+ * Only touches the variant, the disk cache and a private clone of its
+ * shader's NIR (the NIR->LLVM translation rewrites the NIR in place), so
+ * that it can run on a compiler thread with the variant's own LLVM
+ * context.  Returns false on failure, leaving no jit functions set.
+ */
+static bool
+compile_variant(const struct lp_fs_compile_job *job,
+                lp_context_ref *context)
+{
+   struct llvmpipe_context *lp = job->lp;
+   struct lp_fragment_shader_variant *variant = job->variant;
+   struct lp_fragment_shader *shader = variant->shader;
+   const struct lp_fragment_shader_variant_key *key = &variant->key;
+
+   struct lp_cached_code cached = { 0 };
+   unsigned char ir_blake3_cache_key[BLAKE3_KEY_LEN];
+   bool needs_caching = false;
+   if (shader->base.ir.nir) {
+      lp_fs_get_ir_cache_key(variant, ir_blake3_cache_key);
+
+      lp_disk_cache_find_shader(job->screen, &cached, ir_blake3_cache_key);
+      if (!cached.data_size)
+         needs_caching = true;
+   }
+
+   char module_name[64];
+   snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
+            shader->no, variant->no);
+   variant->gallivm = gallivm_create(module_name, context, &cached);
+   if (!variant->gallivm)
+      return false;
+
+   llvmpipe_fs_variant_fastpath(variant);
+
+   lp_jit_init_types(variant);
+
+   if (variant->jit_function[RAST_EDGE_TEST] == NULL ||
+       (variant->jit_function[RAST_WHOLE] == NULL && variant->opaque)) {
+      nir_shader *nir = nir_shader_clone(NULL, shader->base.ir.nir);
+
+      if (variant->jit_function[RAST_EDGE_TEST] == NULL)
+         generate_fragment(lp, shader, nir, variant, RAST_EDGE_TEST);
+
+      if (variant->jit_function[RAST_WHOLE] == NULL) {
+         if (variant->opaque) {
+            /* Specialized shader, which doesn't need to read the color buffer. */
+            generate_fragment(lp, shader, nir, variant, RAST_WHOLE);
+         }
+      }
+
+      ralloc_free(nir);
+   }
+
+   if (job->linear_pipeline) {
+      /* Currently keeping both the old fastpaths and new linear path
+       * active.  The older code is still somewhat faster for the cases
+       * it covers.
+       *
+       * XXX: consider restricting this to aero-mode only.
+       */
+      if (job->fullcolormask &&
+          !key->alpha.enabled &&
+          !key->blend.alpha_to_coverage) {
+         llvmpipe_fs_variant_linear_fastpath(variant);
+      }
+
+      /* If the original fastpath doesn't cover this variant, try the new
+       * code:
+       */
+      if (variant->jit_linear == NULL) {
+         if (shader->kind == LP_FS_KIND_BLIT_RGBA ||
+             shader->kind == LP_FS_KIND_BLIT_RGB1 ||
+             shader->kind == LP_FS_KIND_LLVM_LINEAR) {
+            llvmpipe_fs_variant_linear_llvm(lp, shader, variant);
+         }
+      }
+   } else {
+      if (LP_DEBUG & DEBUG_LINEAR) {
+         lp_debug_fs_variant(variant);
+         debug_printf("    ----> no linear path for this variant: %s\n",
+                      linear_pipeline_reject_reason(key, shader->base.ir.nir));
+      }
+   }
+
+   /*
+    * Compile everything
+    */
+
+#if GALLIVM_USE_ORCJIT
+/* module has been moved into ORCJIT after gallivm_compile_module */
+   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
+
+   gallivm_compile_module(variant->gallivm);
+#else
+   gallivm_compile_module(variant->gallivm);
+
+   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
+#endif
+
+   if (variant->function[RAST_EDGE_TEST]) {
+      variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
+            gallivm_jit_function(variant->gallivm,
+                                 variant->function[RAST_EDGE_TEST],
+                                 variant->function_name[RAST_EDGE_TEST]);
+   }
+
+   if (variant->function[RAST_WHOLE]) {
+      variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
+         gallivm_jit_function(variant->gallivm,
+                              variant->function[RAST_WHOLE],
+                              variant->function_name[RAST_WHOLE]);
+   } else if (!variant->jit_function[RAST_WHOLE]) {
+      variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
+         variant->jit_function[RAST_EDGE_TEST];
+   }
+
+   if (job->linear_pipeline) {
+      if (variant->linear_function) {
+         variant->jit_linear_llvm = (lp_jit_linear_llvm_func)
+            gallivm_jit_function(variant->gallivm, variant->linear_function,
+                                 variant->linear_function_name);
+      }
+
+      /*
+       * This must be done after LLVM compilation, as it will call the JIT'ed
+       * code to determine active inputs.
+       */
+      lp_linear_check_variant(variant);
+   }
+
+   if (needs_caching) {
+      lp_disk_cache_insert_shader(job->screen, &cached, ir_blake3_cache_key);
+   }
+
+   gallivm_free_ir(variant->gallivm);
+
+   return true;
+}
+
+
+static void
+skip_fragments(const struct lp_jit_context *context,
+               const struct lp_jit_resources *resources,
+               uint32_t x,
+               uint32_t y,
+               uint32_t facing,
+               const void *a0,
+               const void *dadx,
+               const void *dady,
+               uint8_t **cbufs,
+               uint8_t *depth,
+               uint64_t mask0,
+               uint64_t mask1,
+               struct lp_jit_thread_data *thread_data,
+               unsigned *strides,
+               unsigned depth_stride,
+               unsigned *color_sample_stride,
+               unsigned depth_sample_stride)
+{
+}
+
+
+static void
+compile_variant_async(void *data, void *gdata, int thread_index)
+{
+   struct lp_fs_compile_job *job = data;
+   struct lp_fragment_shader_variant *variant = job->variant;
+
+   if (!compile_variant(job, &variant->context)) {
+      mesa_loge("llvmpipe: failed to compile fs variant %u in background\n",
+                variant->no);
+
+      /* The variant is already bound and may be used by queued scenes. */
+      variant->jit_function[RAST_EDGE_TEST] = skip_fragments;
+      variant->jit_function[RAST_WHOLE] = skip_fragments;
+      variant->jit_linear = NULL;
+      variant->jit_linear_llvm = NULL;
+      variant->jit_linear_blit = NULL;
+      variant->compile_failed = true;
+   }
+
+   FREE(job);
+}
+
+
 /**
  * Generate a new fragment shader variant from the shader code and
  * other state indicated by the key.
+ *
+ * The state analysis the setup code depends on (opaque, blit, ...) is
+ * always done here.  If the screen has a compiler queue, code generation
+ * is handed to it and the variant is returned before it is ready, see
+ * lp_fs_variant_is_ready().
  */
 static struct lp_fragment_shader_variant *
 generate_variant(struct llvmpipe_context *lp,
@@ -3853,30 +4090,12 @@ generate_variant(struct llvmpipe_context *lp,
    memset(variant, 0, sizeof(*variant));
 
    pipe_reference_init(&variant->reference, 1);
+   util_queue_fence_init(&variant->ready);
    lp_fs_reference(lp, &variant->shader, shader);
 
    memcpy(&variant->key, key, shader->variant_key_size);
 
    struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
-   struct lp_cached_code cached = { 0 };
-   unsigned char ir_blake3_cache_key[BLAKE3_KEY_LEN];
-   bool needs_caching = false;
-   if (shader->base.ir.nir) {
-      lp_fs_get_ir_cache_key(variant, ir_blake3_cache_key);
-
-      lp_disk_cache_find_shader(screen, &cached, ir_blake3_cache_key);
-      if (!cached.data_size)
-         needs_caching = true;
-   }
-
-   char module_name[64];
-   snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
-            shader->no, shader->variants_created);
-   variant->gallivm = gallivm_create(module_name, &lp->context, &cached);
-   if (!variant->gallivm) {
-      FREE(variant);
-      return NULL;
-   }
 
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
@@ -3932,6 +4151,53 @@ generate_variant(struct llvmpipe_context *lp,
          shader->info.cbuf[0][3].file != TGSI_FILE_NULL
          ? true : false;
 
+   /* Hierarchical Z only tracks an upper bound of the depth buffer, which
+    * holds while the depth values can only decrease.
+    */
+   const bool depth_less =
+         key->depth.enabled &&
+         (key->depth.func == PIPE_FUNC_LESS ||
+          key->depth.func == PIPE_FUNC_LEQUAL) &&
+         !key->stencil[0].enabled &&
+         !key->depth_clamp &&
+         !(nir->info.outputs_written & BITFIELD64_BIT(FRAG_RESULT_DEPTH));
+
+   variant->hiz_cull =
+         depth_less &&
+         (!nir->info.writes_memory || nir->info.fs.early_fragment_tests);
+
+   variant->hiz_occluder =
+         depth_less &&
+         key->depth.writemask &&
+         key->restrict_depth_values &&
+         !key->alpha.enabled &&
+         !key->multisample &&
+         !key->blend.alpha_to_coverage &&
+         !key->depth.depth_bounds_test &&
+         !nir->info.fs.uses_discard &&
+         !(nir->info.outputs_written & BITFIELD64_BIT(FRAG_RESULT_SAMPLE_MASK));
+
+   variant->hiz_invalidate =
+         key->depth.enabled &&
+         key->depth.writemask &&
+         key->depth.func != PIPE_FUNC_NEVER &&
+         key->depth.func != PIPE_FUNC_LESS &&
+         key->depth.func != PIPE_FUNC_LEQUAL &&
+         key->depth.func != PIPE_FUNC_EQUAL;
+
+   /* Only the fragments winning the depth test of a tile get shaded when
+    * deferring, so fragments must not depend on or affect anything else.
+    */
+   bool blend = key->blend.logicop_enable;
+   for (unsigned i = 0; i < key->nr_cbufs; i++)
+      blend |= key->blend.rt[i].blend_enable;
+
+   variant->deferrable =
+         variant->hiz_occluder &&
+         !blend &&
+         !nir->info.writes_memory &&
+         !nir->info.fs.uses_fbfetch_output;
+
    /* We only care about opaque blits for now */
    if (variant->opaque &&
        (shader->kind == LP_FS_KIND_BLIT_RGBA ||
@@ -3972,15 +4238,7 @@ generate_variant(struct llvmpipe_context *lp,
     * the linear path.
     */
    const bool linear_pipeline =
-         !key->stencil[0].enabled &&
-         !key->depth.enabled &&
-         !key->depth.depth_bounds_test &&
-         !nir->info.fs.uses_discard &&
-         !key->blend.logicop_enable &&
-         (key->cbuf_format[0] == PIPE_FORMAT_B8G8R8A8_UNORM ||
-          key->cbuf_format[0] == PIPE_FORMAT_B8G8R8X8_UNORM ||
-          key->cbuf_format[0] == PIPE_FORMAT_R8G8B8A8_UNORM ||
-          key->cbuf_format[0] == PIPE_FORMAT_R8G8B8X8_UNORM);
+         linear_pipeline_reject_reason(key, nir) == NULL;
 
    memcpy(&variant->key, key, sizeof *key);
 
@@ -3988,102 +4246,33 @@ generate_variant(struct llvmpipe_context *lp,
       lp_debug_fs_variant(variant);
    }
 
-   llvmpipe_fs_variant_fastpath(variant);
-
-   lp_jit_init_types(variant);
-
-   if (variant->jit_function[RAST_EDGE_TEST] == NULL)
-      generate_fragment(lp, shader, variant, RAST_EDGE_TEST);
-
-   if (variant->jit_function[RAST_WHOLE] == NULL) {
-      if (variant->opaque) {
-         /* Specialized shader, which doesn't need to read the color buffer. */
-         generate_fragment(lp, shader, variant, RAST_WHOLE);
-      }
-   }
-
-   if (linear_pipeline) {
-      /* Currently keeping both the old fastpaths and new linear path
-       * active.  The older code is still somewhat faster for the cases
-       * it covers.
-       *
-       * XXX: consider restricting this to aero-mode only.
-       */
-      if (fullcolormask &&
-          !key->alpha.enabled &&
-          !key->blend.alpha_to_coverage) {
-         llvmpipe_fs_variant_linear_fastpath(variant);
-      }
-
-      /* If the original fastpath doesn't cover this variant, try the new
-       * code:
-       */
-      if (variant->jit_linear == NULL) {
-         if (shader->kind == LP_FS_KIND_BLIT_RGBA ||
-             shader->kind == LP_FS_KIND_BLIT_RGB1 ||
-             shader->kind == LP_FS_KIND_LLVM_LINEAR) {
-            llvmpipe_fs_variant_linear_llvm(lp, shader, variant);
-         }
-      }
-   } else {
-      if (LP_DEBUG & DEBUG_LINEAR) {
-         lp_debug_fs_variant(variant);
-         debug_printf("    ----> no linear path for this variant\n");
-      }
-   }
-
-   /*
-    * Compile everything
-    */
-
-#if GALLIVM_USE_ORCJIT
-/* module has been moved into ORCJIT after gallivm_compile_module */
-   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
-
-   gallivm_compile_module(variant->gallivm);
-#else
-   gallivm_compile_module(variant->gallivm);
-
-   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
-#endif
-
-   if (variant->function[RAST_EDGE_TEST]) {
-      variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
-            gallivm_jit_function(variant->gallivm,
-                                 variant->function[RAST_EDGE_TEST],
-                                 variant->function_name[RAST_EDGE_TEST]);
-   }
-
-   if (variant->function[RAST_WHOLE]) {
-      variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
-         gallivm_jit_function(variant->gallivm,
-                              variant->function[RAST_WHOLE],
-                              variant->function_name[RAST_WHOLE]);
-   } else if (!variant->jit_function[RAST_WHOLE]) {
-      variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
-         variant->jit_function[RAST_EDGE_TEST];
-   }
+   struct lp_fs_compile_job job = {
+      .lp = lp,
+      .screen = screen,
+      .variant = variant,
+      .linear_pipeline = linear_pipeline,
+      .fullcolormask = fullcolormask,
+   };
 
-   if (linear_pipeline) {
-      if (variant->linear_function) {
-         variant->jit_linear_llvm = (lp_jit_linear_llvm_func)
-            gallivm_jit_function(variant->gallivm, variant->linear_function,
-                                 variant->linear_function_name);
+   if (util_queue_is_initialized(&screen->fs_compile_queue)) {
+      struct lp_fs_compile_job *async_job = MALLOC_STRUCT(lp_fs_compile_job);
+      if (async_job) {
+         *async_job = job;
+         lp_context_create(&variant->context);
+         util_queue_add_job(&screen->fs_compile_queue, async_job,
+                            &variant->ready, compile_variant_async,
+                            NULL, 0);
+         return variant;
       }
-
-      /*
-       * This must be done after LLVM compilation, as it will call the JIT'ed
-       * code to determine active inputs.
-       */
-      lp_linear_check_variant(variant);
    }
 
-   if (needs_caching) {
-      lp_disk_cache_insert_shader(screen, &cached, ir_blake3_cache_key);
+   if (!compile_variant(&job, &lp->context)) {
+      util_queue_fence_destroy(&variant->ready);
+      lp_fs_reference(lp, &variant->shader, NULL);
+      FREE(variant);
+      return NULL;
    }
 
-   gallivm_free_ir(variant->gallivm);
-
    return variant;
 }
 
@@ -4234,7 +4423,8 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
    /* remove from context's list */
    list_del(&variant->list_item_global.list);
    lp->nr_fs_variants--;
-   lp->nr_fs_instrs -= variant->nr_instrs;
+   if (variant->nr_instrs_counted)
+      lp->nr_fs_instrs -= variant->nr_instrs;
 }
 
 
@@ -4242,7 +4432,13 @@ void
 llvmpipe_destroy_shader_variant(struct llvmpipe_context *lp,
                                 struct lp_fragment_shader_variant *variant)
 {
-   gallivm_destroy(variant->gallivm);
+   /* Can't pull the code out from under a background compile */
+   util_queue_fence_wait(&variant->ready);
+   util_queue_fence_destroy(&variant->ready);
+
+   if (variant->gallivm)
+      gallivm_destroy(variant->gallivm);
+   lp_context_destroy(&variant->context);
    lp_fs_reference(lp, &variant->shader, NULL);
    FREE(variant->function_name[RAST_EDGE_TEST]);
    FREE(variant->function_name[RAST_WHOLE]);
@@ -4779,6 +4975,12 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
        * deletion of shader's when we have too many.
        */
       list_move_to(&variant->list_item_global.list, &lp->fs_variants_list.list);
+
+      /* Background compiles only know their size once they are done */
+      if (!variant->nr_instrs_counted && lp_fs_variant_is_ready(variant)) {
+         lp->nr_fs_instrs += variant->nr_instrs;
+         variant->nr_instrs_counted = true;
+      }
    } else {
       /* variant not found, create it now */
 
@@ -4832,6 +5034,9 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
 
       /*
        * Generate the new variant.
+       *
+       * When compiling in the background this only measures the time the
+       * draw thread was blocked for.
        */
       int64_t t0 = os_time_get();
       variant = generate_variant(lp, shader, key);
@@ -4845,7 +5050,12 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
          list_add(&variant->list_item_local.list, &shader->variants.list);
          list_add(&variant->list_item_global.list, &lp->fs_variants_list.list);
          lp->nr_fs_variants++;
-         lp->nr_fs_instrs += variant->nr_instrs;
+         if (lp_fs_variant_is_ready(variant)) {
+            lp->nr_fs_instrs += variant->nr_instrs;
+            variant->nr_instrs_counted = true;
+         } else {
+            LP_COUNT(nr_fs_async_compiles);
+         }
          shader->variants_cached++;
       }
    }
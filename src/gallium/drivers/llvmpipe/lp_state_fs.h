@@ -32,6 +32,7 @@
 
 #include "util/list.h"
 #include "util/compiler.h"
+#include "util/u_queue.h"
 #include "pipe/p_state.h"
 #include "gallivm/lp_bld_sample.h" /* for struct lp_sampler_static_state */
 #include "gallivm/lp_bld_jit_sample.h"
@@ -153,6 +154,25 @@ struct lp_fragment_shader_variant
 
    unsigned opaque:1;
    unsigned blit:1;
+
+   /*
+    * Hierarchical Z, see lp_rast_depth_bounds().
+    *
+    * hiz_cull: fragments failing the depth test have no side effects, so
+    * blocks behind the depth buffer may be skipped.
+    * hiz_occluder: every covered pixel ends up with a depth no greater
+    * than the fragment's one.
+    * hiz_invalidate: depth buffer values may increase.
+    */
+   unsigned hiz_cull:1;
+   unsigned hiz_occluder:1;
+   unsigned hiz_invalidate:1;
+   /*
+    * The color and depth of a pixel only depend on the last fragment passing
+    * the depth test, so only that one needs to be shaded, see
+    * lp_rast_deferred_block().
+    */
+   unsigned deferrable:1;
    unsigned linear_input_mask:16;
    struct pipe_reference reference;
 
@@ -189,6 +209,25 @@ struct lp_fragment_shader_variant
 
    /* Total number of LLVM instructions generated */
    unsigned nr_instrs;
+   /* Whether nr_instrs has been added to llvmpipe_context::nr_fs_instrs */
+   bool nr_instrs_counted;
+
+   /*
+    * Signalled once the code above has been generated.  Variants compiled
+    * in the background (LP_FS_COMPILE_THREADS) are bound right away, the
+    * scene using them waits on this before being queued for rasterization.
+    */
+   struct util_queue_fence ready;
+
+   /*
+    * Set if the background compile failed.  The jit functions then do
+    * nothing, so that draws already binned with the variant are dropped,
+    * and setup skips the later ones.
+    */
+   bool compile_failed;
+
+   /* LLVM context owned by this variant when compiled in the background */
+   lp_context_ref context;
 
    struct lp_fs_variant_list_item list_item_global, list_item_local;
    struct lp_fragment_shader *shader;
@@ -267,6 +306,12 @@ lp_fs_reference(struct llvmpipe_context *llvmpipe,
    *ptr = shader;
 }
 
+static inline bool
+lp_fs_variant_is_ready(struct lp_fragment_shader_variant *variant)
+{
+   return util_queue_fence_is_signalled(&variant->ready);
+}
+
 void
 llvmpipe_destroy_shader_variant(struct llvmpipe_context *lp,
                                 struct lp_fragment_shader_variant *variant);
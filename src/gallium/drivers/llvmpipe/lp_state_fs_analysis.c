@@ -33,47 +33,21 @@
 #include "nir.h"
 
 /*
- * Check if the given nir_src comes directly from a FS input.
+ * Log why a shader can't use the linear path, with LP_DEBUG=linear.
+ * Always returns false.
  */
 static bool
-is_fs_input(const nir_src *src)
+linear_reject(const nir_instr *instr, const char *reason)
 {
-   const nir_instr *parent = nir_def_instr(&src->ssa[0]);
-   if (!parent) {
-      return false;
-   }
-
-   if (parent->type == nir_instr_type_alu) {
-      const nir_alu_instr *alu = nir_instr_as_alu(parent);
-      if (alu->op == nir_op_vec2 ||
-          alu->op == nir_op_vec3 ||
-          alu->op == nir_op_vec4) {
-         /* Check if any of the components come from an FS input */
-         unsigned num_src = nir_op_infos[alu->op].num_inputs;
-         for (unsigned i = 0; i < num_src; i++) {
-            if (is_fs_input(&alu->src[i].src)) {
-               return true;
-            }
-         }
-      }
-   } else if (parent->type == nir_instr_type_intrinsic) {
-      const nir_intrinsic_instr *intrin = nir_instr_as_intrinsic(parent);
-      /* loading from an FS input? */
-      if (intrin->intrinsic == nir_intrinsic_load_deref) {
-         if (is_fs_input(&intrin->src[0])) {
-            return true;
-         }
-      }
-   } else if (parent->type == nir_instr_type_deref) {
-      const nir_deref_instr *deref = nir_instr_as_deref(parent);
-      /* deref'ing an FS input? */
-      if (deref &&
-          deref->deref_type == nir_deref_type_var &&
-          deref->modes == nir_var_shader_in) {
-         return true;
+   if (LP_DEBUG & DEBUG_LINEAR) {
+      if (instr) {
+         char *str = nir_instr_as_str(instr, NULL);
+         debug_printf("llvmpipe: fs not linear: %s: %s\n", reason, str);
+         ralloc_free(str);
+      } else {
+         debug_printf("llvmpipe: fs not linear: %s\n", reason);
       }
    }
-
    return false;
 }
 
@@ -202,13 +176,58 @@ check_load_const_in_zero_one(const nir_load_const_instr *load)
 }
 
 
+/*
+ * The linear path computes in unorm8, where additions saturate.  Check that
+ * all the uses of a sum, which may exceed 1.0, get the same result whether
+ * it was clamped or not: they either store it to the color output, which
+ * is clamped to the unorm8 render target, or clamp it with a fmin against
+ * a constant, maybe after other fmax, mov or vec ops.
+ */
+static bool
+is_clamped_on_use(const nir_def *def)
+{
+   nir_foreach_use_including_if(src, def) {
+      if (nir_src_is_if(src))
+         return false;
+
+      const nir_instr *use = nir_src_parent_instr(src);
+      if (use->type == nir_instr_type_intrinsic &&
+          nir_instr_as_intrinsic(use)->intrinsic ==
+             nir_intrinsic_store_deref)
+         continue;
+
+      if (use->type != nir_instr_type_alu)
+         return false;
+
+      const nir_alu_instr *alu = nir_instr_as_alu(use);
+      switch (alu->op) {
+      case nir_op_fmin:
+         if (!nir_src_is_const(alu->src[0].src) &&
+             !nir_src_is_const(alu->src[1].src))
+            return false;
+         break;
+      case nir_op_fmax:
+      case nir_op_mov:
+      case nir_op_vec2:
+      case nir_op_vec4:
+         if (!is_clamped_on_use(&alu->def))
+            return false;
+         break;
+      default:
+         return false;
+      }
+   }
+   return true;
+}
+
+
 /*
  * Examine the NIR shader to determine if it's "linear".
  * For the linear path, we're optimizing the case of rendering a window-
- * aligned, textured quad.  Basically, FS must get the output color from
- * a texture lookup and, possibly, a constant color.  If the color comes
- * from some other sort of computation or from a VS output (FS input), we
- * can't use the linear path.
+ * aligned, textured or shaded quad.  Basically, FS must compute the output
+ * color from texture lookups, constant colors and FS inputs with
+ * operations which keep values in [0,1], so that it can work on unorm8
+ * values.  FS inputs are checked to be in [0,1] when the quad is drawn.
  */
 static bool
 llvmpipe_nir_fn_is_linear_compat(const struct nir_shader *shader,
@@ -221,16 +240,16 @@ llvmpipe_nir_fn_is_linear_compat(const struct nir_shader *shader,
          case nir_instr_type_deref: {
             nir_deref_instr *deref = nir_instr_as_deref(instr);
             if (deref->deref_type != nir_deref_type_var)
-               return false;
+               return linear_reject(instr, "indirect deref");
             if (deref->var->data.mode == nir_var_shader_out &&
                 deref->var->data.location_frac != 0)
-               return false;
+               return linear_reject(instr, "partial output");
             break;
          }
          case nir_instr_type_load_const: {
             nir_load_const_instr *load = nir_instr_as_load_const(instr);
             if (!check_load_const_in_zero_one(load)) {
-               return false;
+               return linear_reject(instr, "constant not in [0,1]");
             }
             break;
          }
@@ -239,46 +258,38 @@ llvmpipe_nir_fn_is_linear_compat(const struct nir_shader *shader,
             if (intrin->intrinsic != nir_intrinsic_load_deref &&
                 intrin->intrinsic != nir_intrinsic_store_deref &&
                 intrin->intrinsic != nir_intrinsic_load_ubo)
-               return false;
+               return linear_reject(instr, "unsupported intrinsic");
 
             if (intrin->intrinsic == nir_intrinsic_load_ubo) {
                if (!nir_src_is_const(intrin->src[0]))
-                  return false;
+                  return linear_reject(instr, "indirect ubo");
                nir_load_const_instr *load =
                   nir_def_as_load_const(intrin->src[0].ssa);
                if (load->value[0].u32 != 0 || load->def.num_components > 1)
-                  return false;
-            } else if (intrin->intrinsic == nir_intrinsic_store_deref) {
-               /*
-                * Assume the store destination is the FS output color.
-                * Check if the store src comes directly from a FS input.
-                * If so, we cannot use the linear path since we don't have
-                * code to convert VS outputs / FS inputs to ubyte with the
-                * needed swizzling.
-                */
-               if (is_fs_input(&intrin->src[1])) {
-                  return false;
-               }
+                  return linear_reject(instr, "ubo other than constants");
             }
             break;
          }
          case nir_instr_type_tex: {
             nir_tex_instr *tex = nir_instr_as_tex(instr);
-            struct lp_tgsi_texture_info *tex_info = &info->tex[info->num_texs];
             int texcoord_swizzle[4] = {-1, -1, -1, -1};
             unsigned coord_fs_input_index = 0;
 
+            if (info->num_texs >= LP_MAX_LINEAR_TEXTURES)
+               return linear_reject(instr, "too many texture fetches");
+
+            struct lp_tgsi_texture_info *tex_info = &info->tex[info->num_texs];
+
             for (unsigned i = 0; i < tex->num_srcs; i++) {
                if (tex->src[i].src_type == nir_tex_src_coord) {
                   if (!get_texcoord_provenance(&tex->src[i],
                                                &coord_fs_input_index,
                                                texcoord_swizzle)) {
-                     //debug nir_print_shader((nir_shader *) shader, stdout);
-                     return false;
+                     return linear_reject(instr, "texcoord not an FS input");
                   }
                } else if (tex->src[i].src_type == nir_tex_src_texture_handle ||
                           tex->src[i].src_type == nir_tex_src_sampler_handle) {
-                  return false;
+                  return linear_reject(instr, "bindless texture");
                }
             }
 
@@ -289,7 +300,7 @@ llvmpipe_nir_fn_is_linear_compat(const struct nir_shader *shader,
             default:
                /* inaccurate but sufficient. */
                tex_info->modifier = LP_BLD_TEX_MODIFIER_EXPLICIT_LOD;
-               return false;
+               return linear_reject(instr, "texture op other than tex");
             }
             switch (tex->sampler_dim) {
             case GLSL_SAMPLER_DIM_2D:
@@ -298,7 +309,7 @@ llvmpipe_nir_fn_is_linear_compat(const struct nir_shader *shader,
             default:
                /* inaccurate but sufficient. */
                tex_info->target = TGSI_TEXTURE_1D;
-               return false;
+               return linear_reject(instr, "texture not 2D");
             }
 
             tex_info->sampler_unit = tex->sampler_index;
@@ -323,35 +334,24 @@ llvmpipe_nir_fn_is_linear_compat(const struct nir_shader *shader,
             case nir_op_mov:
             case nir_op_vec2:
             case nir_op_vec4:
-               // these instructions are OK
+            case nir_op_fmul:
+            case nir_op_fmin:
+            case nir_op_fmax:
+               /* These keep values in [0,1], as long as their
+                * operands are.
+                */
                break;
-            case nir_op_fmul: {
-               unsigned num_src = nir_op_infos[alu->op].num_inputs;;
-               for (unsigned s = 0; s < num_src; s++) {
-                  /* If the MUL uses immediate values, the values must
-                   * be 32-bit floats in the range [0,1].
-                   */
-                  if (nir_src_is_const(alu->src[s].src)) {
-                     nir_load_const_instr *load =
-                        nir_def_as_load_const(alu->src[s].src.ssa);
-                     if (!check_load_const_in_zero_one(load)) {
-                        return false;
-                     }
-                  } else if (is_fs_input(&alu->src[s].src)) {
-                     /* we don't know if the fs inputs are in [0,1] */
-                     return false;
-                  }
-               }
+            case nir_op_fadd:
+               if (!is_clamped_on_use(&alu->def))
+                  return linear_reject(instr, "unclamped fadd");
                break;
-            }
             default:
-               // disallowed instruction
-               return false;
+               return linear_reject(instr, "unsupported alu op");
             }
             break;
          }
          default:
-            return false;
+            return linear_reject(instr, "unsupported instruction");
          }
       }
    }
@@ -366,11 +366,11 @@ llvmpipe_nir_is_linear_compat(struct nir_shader *shader,
    int num_tex = info->num_texs;
 
    if (util_bitcount64(shader->info.inputs_read) > LP_MAX_LINEAR_INPUTS)
-      return false;
+      return linear_reject(NULL, "too many inputs");
 
    if (!shader->info.outputs_written || shader->info.fs.color_is_dual_source ||
        (shader->info.outputs_written & ~BITFIELD64_BIT(FRAG_RESULT_DATA0)))
-      return false;
+      return linear_reject(NULL, "outputs other than color 0");
 
    info->num_texs = 0;
    nir_foreach_function_impl(impl, shader) {
@@ -389,13 +389,24 @@ llvmpipe_nir_is_linear_compat(struct nir_shader *shader,
 void
 llvmpipe_fs_analyse_nir(struct lp_fragment_shader *shader)
 {
-   if (!shader->info.indirect_textures &&
-       !shader->info.sampler_texture_units_different &&
-       shader->info.num_texs <= LP_MAX_LINEAR_TEXTURES &&
-       llvmpipe_nir_is_linear_compat(shader->base.ir.nir, &shader->info)) {
-      shader->kind = LP_FS_KIND_LLVM_LINEAR;
-   } else {
-      shader->kind = LP_FS_KIND_GENERAL;
+   shader->kind = LP_FS_KIND_GENERAL;
+
+   if (shader->info.indirect_textures) {
+      linear_reject(NULL, "indirect textures");
+      return;
    }
+
+   if (shader->info.sampler_texture_units_different) {
+      linear_reject(NULL, "sampler and texture units differ");
+      return;
+   }
+
+   if (shader->info.num_texs > LP_MAX_LINEAR_TEXTURES) {
+      linear_reject(NULL, "too many textures");
+      return;
+   }
+
+   if (llvmpipe_nir_is_linear_compat(shader->base.ir.nir, &shader->info))
+      shader->kind = LP_FS_KIND_LLVM_LINEAR;
 }
 
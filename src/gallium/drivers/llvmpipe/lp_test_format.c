@@ -179,6 +179,10 @@ test_format_float(unsigned verbose, FILE *fp,
          /* To ensure it's 16-byte aligned */
          memcpy(packed, test->packed, sizeof packed);
 
+         /* The cache is tagged by address, and the contents changed. */
+         if (use_cache)
+            memset(cache_ptr->cache_tags, 0, sizeof cache_ptr->cache_tags);
+
          for (i = 0; i < desc->block.height; ++i) {
             for (j = 0; j < desc->block.width; ++j) {
                bool match = true;
@@ -281,6 +285,9 @@ test_format_unorm8(unsigned verbose, FILE *fp,
          /* Could skip this and use unaligned lp_build_fetch_rgba_aos */
          memcpy(packed, test->packed, sizeof packed);
 
+         if (use_cache)
+            memset(cache_ptr->cache_tags, 0, sizeof cache_ptr->cache_tags);
+
          for (i = 0; i < desc->block.height; ++i) {
             for (j = 0; j < desc->block.width; ++j) {
                bool match;
@@ -340,6 +347,86 @@ test_format_unorm8(unsigned verbose, FILE *fp,
 
 
 
+/*
+ * There are no test cases for most of the formats going through the block
+ * cache, so compare the cached fetches against the unpack function on
+ * pseudo-random blocks instead. The cache is cleared between blocks, like at
+ * the start of a scene, as they all live at the same address.
+ */
+UTIL_ALIGN_STACK
+static bool
+test_format_cached(unsigned verbose, FILE *fp,
+                   const struct util_format_description *desc)
+{
+   const struct util_format_unpack_description *unpack =
+      util_format_unpack_description(util_format_linear(desc->format));
+   lp_context_ref context;
+   struct gallivm_state *gallivm;
+   LLVMValueRef fetch = NULL;
+   char fetch_name[MAX_NAME];
+   fetch_ptr_t fetch_ptr;
+   alignas(16) uint8_t packed[UTIL_FORMAT_MAX_PACKED_BYTES];
+   uint8_t expected[4][4][4];
+   uint8_t unpacked[4];
+   bool success = true;
+   unsigned i, j, k, l;
+
+   printf("Testing %s (cached unorm8) ...\n", desc->name);
+   fflush(stdout);
+
+   lp_context_create(&context);
+   gallivm = gallivm_create("test_module_cached", &context, NULL);
+
+   fetch = add_fetch_rgba_test(gallivm, verbose, desc,
+                               lp_unorm8_vec4_type(), true, fetch_name);
+
+   gallivm_compile_module(gallivm);
+
+   fetch_ptr = (fetch_ptr_t) gallivm_jit_function(gallivm, fetch, fetch_name);
+
+   gallivm_free_ir(gallivm);
+
+   srand(desc->format);
+
+   for (l = 0; l < 16; ++l) {
+      for (k = 0; k < desc->block.bits / 8; ++k)
+         packed[k] = rand();
+
+      unpack->unpack_rgba_8unorm_rect(&expected[0][0][0], sizeof expected[0],
+                                      packed, desc->block.bits / 8, 4, 4);
+
+      memset(cache_ptr->cache_tags, 0, sizeof cache_ptr->cache_tags);
+
+      for (i = 0; i < 4; ++i) {
+         for (j = 0; j < 4; ++j) {
+            memset(unpacked, 0, sizeof unpacked);
+
+            fetch_ptr(unpacked, packed, j, i, cache_ptr);
+
+            if (memcmp(unpacked, expected[i][j], sizeof unpacked) != 0) {
+               printf("FAILED\n");
+               printf("  Unpacked (%u,%u): %02x %02x %02x %02x obtained\n",
+                      j, i,
+                      unpacked[0], unpacked[1], unpacked[2], unpacked[3]);
+               printf("                  %02x %02x %02x %02x expected\n",
+                      expected[i][j][0], expected[i][j][1],
+                      expected[i][j][2], expected[i][j][3]);
+               success = false;
+            }
+         }
+      }
+   }
+
+   gallivm_destroy(gallivm);
+   lp_context_destroy(&context);
+
+   if (fp)
+      write_tsv_row(fp, desc, success);
+
+   return success;
+}
+
+
 static bool
 test_one(unsigned verbose, FILE *fp,
          const struct util_format_description *format_desc,
@@ -395,7 +482,7 @@ test_all(unsigned verbose, FILE *fp)
             continue;
 
          /* only test twice with formats which can use cache */
-         if (format_desc->layout != UTIL_FORMAT_LAYOUT_S3TC && use_cache) {
+         if (use_cache && !lp_build_format_use_cache(format_desc)) {
             continue;
          }
 
@@ -404,6 +491,22 @@ test_all(unsigned verbose, FILE *fp)
          }
       }
    }
+
+   for (format = 1; format < PIPE_FORMAT_COUNT; ++format) {
+      const struct util_format_description *format_desc;
+
+      format_desc = util_format_description(format);
+
+      /* The S3TC decoding only approximates the unpack function. */
+      if (format_desc->layout == UTIL_FORMAT_LAYOUT_S3TC ||
+          !lp_build_format_use_cache(format_desc))
+         continue;
+
+      if (!test_format_cached(verbose, fp, format_desc)) {
+         success = false;
+      }
+   }
+
    align_free(cache_ptr);
 
    return success;
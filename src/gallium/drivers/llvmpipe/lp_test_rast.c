@@ -0,0 +1,291 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * @file
+ * Unit tests and benchmark for the coverage evaluation of the small
+ * triangle rasterizers, comparing the SSE and AVX-512 paths against a
+ * scalar reference.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "util/u_cpu_detect.h"
+#include "util/u_math.h"
+
+#include "lp_rast_priv.h"
+#include "lp_test.h"
+
+
+#define NUM_TRIANGLES 4096
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "cycles_per_triangle\t"
+           "function\t"
+           "path\n");
+
+   fflush(fp);
+}
+
+
+#if DETECT_ARCH_SSE
+
+struct tri_case {
+   struct lp_rast_plane plane[3];
+   int x, y;   /**< position of the 16x16 block containing the triangle */
+};
+
+
+static void
+write_tsv_row(FILE *fp, const char *function, const char *path,
+              double cycles, bool success)
+{
+   fprintf(fp, "%s\t", success ? "pass" : "fail");
+   fprintf(fp, "%.1f\t", cycles);
+   fprintf(fp, "%s\t%s\n", function, path);
+
+   fflush(fp);
+}
+
+
+/**
+ * A triangle within a 16x16 block of a tile, with planes computed like
+ * lp_setup_tri.c does for the 32 bit rasterizers.
+ */
+static void
+random_triangle(struct tri_case *t)
+{
+   int64_t vx[3], vy[3];
+
+   t->x = (rand() % (TILE_SIZE / 4 - 3)) * 4;
+   t->y = (rand() % (TILE_SIZE / 4 - 3)) * 4;
+
+   for (unsigned i = 0; i < 3; i++) {
+      vx[i] = ((int64_t)t->x << FIXED_ORDER) + rand() % (16 << FIXED_ORDER);
+      vy[i] = ((int64_t)t->y << FIXED_ORDER) + rand() % (16 << FIXED_ORDER);
+   }
+
+   /* Pick the winding for which the inside is on the positive side. */
+   if ((vy[0] - vy[1]) * (vx[0] - vx[2]) < (vx[0] - vx[1]) * (vy[0] - vy[2])) {
+      int64_t tmp;
+      tmp = vx[1]; vx[1] = vx[2]; vx[2] = tmp;
+      tmp = vy[1]; vy[1] = vy[2]; vy[2] = tmp;
+   }
+
+   for (unsigned i = 0; i < 3; i++) {
+      struct lp_rast_plane *plane = &t->plane[i];
+      unsigned k = (i + 1) % 3;
+
+      plane->dcdx = (int32_t)(vy[i] - vy[k]);
+      plane->dcdy = (int32_t)(vx[i] - vx[k]);
+      plane->c = plane->dcdx * vx[i] - plane->dcdy * vy[i];
+      if (plane->dcdx < 0 || (plane->dcdx == 0 && plane->dcdy > 0))
+         plane->c++;
+      plane->eo = plane->dcdx < 0 ? -plane->dcdx : 0;
+      plane->pad = 0;
+   }
+}
+
+
+/**
+ * Scalar reference of lp_rast_tri_32_3_4_mask().
+ */
+static unsigned
+ref_3_4_mask(const struct lp_rast_plane *plane, int x, int y)
+{
+   unsigned mask = 0;
+
+   for (unsigned j = 0; j < 3; j++) {
+      int64_t c = plane[j].c - (int64_t)plane[j].dcdx * (x << FIXED_ORDER) +
+                  (int64_t)plane[j].dcdy * (y << FIXED_ORDER);
+      int32_t c0 = (int32_t)((c - 1) >> FIXED_ORDER);
+
+      for (unsigned i = 0; i < 16; i++) {
+         int32_t ci = c0 - plane[j].dcdx * (int32_t)(i & 3) +
+                      plane[j].dcdy * (int32_t)(i >> 2);
+         if (ci < 0)
+            mask |= 1 << i;
+      }
+   }
+
+   return mask;
+}
+
+
+/**
+ * Scalar reference of lp_rast_tri_32_3_16_masks().
+ */
+static unsigned
+ref_3_16_masks(const struct lp_rast_plane *plane, int x, int y,
+               struct lp_rast_block_mask out[16])
+{
+   unsigned nr = 0;
+
+   for (unsigned i = 0; i < 4; i++) {
+      for (unsigned j = 0; j < 4; j++) {
+         bool reject = false;
+
+         for (unsigned k = 0; k < 3; k++) {
+            int32_t dcdx = plane[k].dcdx, dcdy = plane[k].dcdy;
+            int32_t rej = (MAX2(dcdy, 0) - MIN2(dcdx, 0)) * 4 + 1;
+            int64_t c = plane[k].c -
+                        (int64_t)dcdx * ((x + 4 * j) << FIXED_ORDER) +
+                        (int64_t)dcdy * ((y + 4 * i) << FIXED_ORDER);
+
+            if ((int32_t)((c - 1) >> FIXED_ORDER) + rej < 0)
+               reject = true;
+         }
+
+         if (reject)
+            continue;
+
+         unsigned mask = ref_3_4_mask(plane, x + 4 * j, y + 4 * i);
+         if (mask != 0xffff) {
+            out[nr].i = i;
+            out[nr].j = j;
+            out[nr].mask = mask;
+            nr++;
+         }
+      }
+   }
+
+   return nr;
+}
+
+
+typedef unsigned (*masks_func)(const struct lp_rast_plane *plane, int x, int y,
+                               struct lp_rast_block_mask out[16]);
+
+typedef unsigned (*mask_func)(const struct lp_rast_plane *plane, int x, int y);
+
+
+static bool
+test_path(unsigned verbose, FILE *fp, const char *path,
+          masks_func masks_16, mask_func mask_4,
+          const struct tri_case *tris, unsigned num_tris)
+{
+   bool success_16 = true, success_4 = true;
+   int64_t cycles_16, cycles_4;
+   volatile unsigned sink = 0;
+   unsigned nr_16 = 0;
+
+   for (unsigned t = 0; t < num_tris; t++) {
+      const struct tri_case *tri = &tris[t];
+      struct lp_rast_block_mask ref[16], res[16];
+      unsigned ref_nr = ref_3_16_masks(tri->plane, tri->x, tri->y, ref);
+      unsigned res_nr = masks_16(tri->plane, tri->x, tri->y, res);
+      bool match = ref_nr == res_nr;
+
+      for (unsigned i = 0; match && i < ref_nr; i++) {
+         match = ref[i].i == res[i].i && ref[i].j == res[i].j &&
+                 ref[i].mask == res[i].mask;
+      }
+
+      if (!match) {
+         if (verbose || success_16)
+            printf("%s 16x16: triangle %u mismatch\n", path, t);
+         success_16 = false;
+      }
+
+      unsigned ref_mask = ref_3_4_mask(tri->plane, tri->x, tri->y);
+      unsigned res_mask = mask_4(tri->plane, tri->x, tri->y);
+      if (ref_mask != res_mask) {
+         if (verbose || success_4)
+            printf("%s 4x4: triangle %u mask 0x%04x, expected 0x%04x\n",
+                   path, t, res_mask, ref_mask);
+         success_4 = false;
+      }
+   }
+
+   /* Time whole loops, rdtsc is too slow for a single call. */
+   int64_t start = rdtsc();
+   for (unsigned t = 0; t < num_tris; t++) {
+      struct lp_rast_block_mask res[16];
+      nr_16 += masks_16(tris[t].plane, tris[t].x, tris[t].y, res);
+   }
+   cycles_16 = rdtsc() - start;
+
+   start = rdtsc();
+   for (unsigned t = 0; t < num_tris; t++)
+      sink += mask_4(tris[t].plane, tris[t].x, tris[t].y);
+   cycles_4 = rdtsc() - start;
+
+   if (verbose) {
+      printf("%-8s 16x16: %6.1f cycles (%.1f partial blocks)  "
+             "4x4: %6.1f cycles\n", path,
+             (double)cycles_16 / num_tris, (double)nr_16 / num_tris,
+             (double)cycles_4 / num_tris);
+   }
+
+   if (fp) {
+      write_tsv_row(fp, "3_16", path, (double)cycles_16 / num_tris,
+                    success_16);
+      write_tsv_row(fp, "3_4", path, (double)cycles_4 / num_tris, success_4);
+   }
+
+   return success_16 && success_4;
+}
+
+#endif /* DETECT_ARCH_SSE */
+
+
+static bool
+test_triangles(unsigned verbose, FILE *fp, unsigned num_tris)
+{
+   bool success = true;
+
+#if DETECT_ARCH_SSE
+   struct tri_case *tris = malloc(num_tris * sizeof(*tris));
+   if (!tris)
+      return false;
+
+   srand(0);
+   for (unsigned t = 0; t < num_tris; t++)
+      random_triangle(&tris[t]);
+
+   success &= test_path(verbose, fp, "sse", lp_rast_tri_32_3_16_masks,
+                        lp_rast_tri_32_3_4_mask, tris, num_tris);
+
+#ifdef USE_AVX512
+   if (util_get_cpu_caps()->has_avx512f) {
+      success &= test_path(verbose, fp, "avx512",
+                           lp_rast_tri_32_3_16_masks_avx512,
+                           lp_rast_tri_32_3_4_mask_avx512, tris, num_tris);
+   }
+#endif
+
+   free(tris);
+#endif
+
+   return success;
+}
+
+
+bool
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_triangles(verbose, fp, NUM_TRIANGLES);
+}
+
+
+bool
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_triangles(verbose, fp, n);
+}
+
+
+bool
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_triangles(verbose, fp, 1);
+}
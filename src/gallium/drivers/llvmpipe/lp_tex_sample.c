@@ -53,7 +53,6 @@
 #include "lp_debug.h"
 
 
-#if LP_USE_TEXTURE_CACHE
 static LLVMValueRef
 lp_llvm_texture_cache_ptr(struct gallivm_state *gallivm,
                           LLVMTypeRef thread_data_type,
@@ -65,7 +64,8 @@ lp_llvm_texture_cache_ptr(struct gallivm_state *gallivm,
 
    return lp_jit_thread_data_cache(gallivm, thread_data_type, thread_data_ptr);
 }
-#endif
+
+
 struct lp_build_sampler_soa *
 lp_llvm_sampler_soa_create(const struct lp_sampler_static_state *static_state,
                            unsigned nr_samplers)
@@ -74,10 +74,14 @@ lp_llvm_sampler_soa_create(const struct lp_sampler_static_state *static_state,
 
    sampler = lp_bld_llvm_sampler_soa_create(static_state, nr_samplers);
 
-#if LP_USE_TEXTURE_CACHE
-   struct lp_sampler_dynamic_state *dynamic_state = lp_build_sampler_soa_dynamic_state(sampler);
-   dynamic_state->cache_ptr = lp_llvm_texture_cache_ptr;
-#endif
+   /* Compressed textures are decoded a block at a time into the per-thread
+    * block cache, see lp_build_format_use_cache().
+    */
+   if (!(LP_PERF & PERF_NO_TEX_CACHE)) {
+      struct lp_sampler_dynamic_state *dynamic_state = lp_build_sampler_soa_dynamic_state(sampler);
+      dynamic_state->cache_ptr = lp_llvm_texture_cache_ptr;
+   }
+
    return sampler;
 }
 
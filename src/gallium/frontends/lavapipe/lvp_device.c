@@ -43,6 +43,7 @@
 #include "util/os_time.h"
 #include "util/u_thread.h"
 #include "util/u_atomic.h"
+#include "util/u_cpu_detect.h"
 #include "util/timespec.h"
 #include "util/ptralloc.h"
 #include "nir.h"
@@ -1949,6 +1950,7 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateDevice(
    device->noop_fs = device->queue.ctx->create_fs_state(device->queue.ctx, &shstate);
    _mesa_hash_table_init(&device->bda, NULL, _mesa_hash_pointer, _mesa_key_pointer_equal);
    simple_mtx_init(&device->bda_lock, mtx_plain);
+   simple_mtx_init(&device->pipeline_queue_lock, mtx_plain);
 
    uint32_t zero = 0;
    device->zero_buffer = pipe_buffer_create_with_data(device->queue.ctx, 0, PIPE_USAGE_IMMUTABLE, sizeof(uint32_t), &zero);
@@ -1971,6 +1973,12 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateDevice(
 
    lvp_device_init_accel_struct_state(device);
 
+   const struct util_cpu_caps_t *cpu_caps = util_get_cpu_caps();
+   unsigned num_compile_threads =
+      debug_get_num_option("LVP_PIPELINE_COMPILE_THREADS",
+                           cpu_caps->nr_cpus > 1 ? cpu_caps->nr_cpus : 0);
+   device->pipeline_queue_threads = MIN2(num_compile_threads, cpu_caps->nr_cpus);
+
    *pDevice = lvp_device_to_handle(device);
 
    return VK_SUCCESS;
@@ -1983,6 +1991,10 @@ VKAPI_ATTR void VKAPI_CALL lvp_DestroyDevice(
 {
    VK_FROM_HANDLE(lvp_device, device, _device);
 
+   if (util_queue_is_initialized(&device->pipeline_queue))
+      util_queue_destroy(&device->pipeline_queue);
+   simple_mtx_destroy(&device->pipeline_queue_lock);
+
    lvp_device_finish_accel_struct_state(device);
 
    vk_meta_device_finish(&device->vk, &device->meta);
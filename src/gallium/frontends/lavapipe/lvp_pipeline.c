@@ -29,6 +29,7 @@
 #include "vk_util.h"
 #include "glsl_types.h"
 #include "util/os_time.h"
+#include "util/stack_array.h"
 #include "spirv/nir_spirv.h"
 #include "nir/nir_builder.h"
 #include "nir/nir_serialize.h"
@@ -259,76 +260,11 @@ lvp_nir_fixup_indirect_tex(nir_shader *shader)
    return nir_shader_lower_instructions(shader, find_tex, fixup_tex_instr, NULL);
 }
 
-static void
-optimize(nir_shader *nir)
-{
-   bool progress = false;
-   do {
-      progress = false;
-
-      NIR_PASS(progress, nir, nir_lower_flrp, 16|32|64, true);
-      NIR_PASS(progress, nir, nir_split_array_vars, nir_var_function_temp);
-      NIR_PASS(progress, nir, nir_shrink_vec_array_vars, nir_var_function_temp);
-      NIR_PASS(progress, nir, nir_opt_deref);
-      NIR_PASS(progress, nir, nir_lower_vars_to_ssa);
-
-      NIR_PASS(progress, nir, nir_opt_copy_prop_vars);
-
-      NIR_PASS(progress, nir, nir_opt_copy_prop);
-      NIR_PASS(progress, nir, nir_opt_dce);
-
-      nir_opt_peephole_select_options peephole_select_options = {
-         .limit = 8,
-         .indirect_load_ok = true,
-         .expensive_alu_ok = true,
-      };
-      NIR_PASS(progress, nir, nir_opt_peephole_select, &peephole_select_options);
-
-      NIR_PASS(progress, nir, nir_opt_algebraic);
-      NIR_PASS(progress, nir, nir_opt_constant_folding);
-
-      NIR_PASS(progress, nir, nir_opt_remove_phis);
-      bool loop = false;
-      NIR_PASS(loop, nir, nir_opt_loop);
-      progress |= loop;
-      if (loop) {
-         /* If nir_opt_loop makes progress, then we need to clean
-          * things up if we want any hope of nir_opt_if or nir_opt_loop_unroll
-          * to make progress.
-          */
-         NIR_PASS(progress, nir, nir_opt_copy_prop);
-         NIR_PASS(progress, nir, nir_opt_dce);
-         NIR_PASS(progress, nir, nir_opt_remove_phis);
-      }
-      NIR_PASS(progress, nir, nir_opt_if, nir_opt_if_optimize_phi_true_false);
-      NIR_PASS(progress, nir, nir_opt_dead_cf);
-
-      nir_opt_peephole_select_options peephole_discard_options = {
-         .limit = 0,
-         .discard_ok = true,
-      };
-      NIR_PASS(progress, nir, nir_opt_peephole_select, &peephole_discard_options);
-      NIR_PASS(progress, nir, nir_opt_remove_phis);
-      NIR_PASS(progress, nir, nir_opt_cse);
-      NIR_PASS(progress, nir, nir_opt_undef);
-
-      NIR_PASS(progress, nir, nir_opt_deref);
-      NIR_PASS(progress, nir, nir_lower_alu_to_scalar, NULL, NULL);
-      NIR_PASS(progress, nir, nir_opt_loop_unroll);
-      NIR_PASS(progress, nir, lvp_nir_fixup_indirect_tex);
-   } while (progress);
-}
-
 void
 lvp_shader_optimize(nir_shader *nir)
 {
-   optimize(nir);
-   NIR_PASS(_, nir, nir_opt_algebraic_late);
-   NIR_PASS(_, nir, nir_opt_dce);
-   NIR_PASS(_, nir, nir_lower_var_copies);
-   NIR_PASS(_, nir, nir_remove_dead_variables, nir_var_function_temp, NULL);
-   NIR_PASS(_, nir, nir_opt_dce);
-   nir_sweep(nir);
+   nir_optimize(nir, lvp_nir_fixup_indirect_tex, "lvp_nir_fixup_indirect_tex");
+   nir_optimize_late(nir);
 }
 
 struct lvp_pipeline_nir *
@@ -444,7 +380,7 @@ lvp_shader_lower(struct lvp_device *pdevice, nir_shader *nir, struct lvp_pipelin
    NIR_PASS(_, nir, nir_remove_dead_variables,
             nir_var_uniform | nir_var_image, NULL);
 
-   optimize(nir);
+   nir_optimize(nir, lvp_nir_fixup_indirect_tex, "lvp_nir_fixup_indirect_tex");
    nir_shader_gather_info(nir, nir_shader_get_entrypoint(nir));
 
    NIR_PASS(_, nir, nir_lower_io_vars_to_temporaries, nir_shader_get_entrypoint(nir),
@@ -1069,6 +1005,137 @@ lvp_graphics_pipeline_create(
    return VK_SUCCESS;
 }
 
+typedef VkResult (*lvp_pipeline_create_func)(VkDevice device,
+                                             VkPipelineCache cache,
+                                             const void *create_info,
+                                             VkPipelineCreateFlagBits2KHR flags,
+                                             VkPipeline *pipeline);
+
+struct lvp_pipeline_create_job {
+   VkDevice device;
+   VkPipelineCache cache;
+   const void *create_info;
+   VkPipelineCreateFlagBits2KHR flags;
+   lvp_pipeline_create_func create;
+   VkPipeline *pipeline;
+   VkResult result;
+   struct util_queue_fence fence;
+};
+
+static void
+lvp_pipeline_create_job_execute(void *data, void *gdata, int thread_index)
+{
+   struct lvp_pipeline_create_job *job = data;
+
+   if (job->flags & VK_PIPELINE_CREATE_2_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT_KHR)
+      job->result = VK_PIPELINE_COMPILE_REQUIRED;
+   else
+      job->result = job->create(job->device, job->cache, job->create_info,
+                                job->flags, job->pipeline);
+}
+
+/**
+ * Create a batch of pipelines on the device's pipeline queue, one job per
+ * pipeline.  Pipelines don't depend on other pipelines of the same batch, so
+ * this gives the same results as creating them in order.  The caller must not
+ * use this when any of them asks for EARLY_RETURN_ON_FAILURE.
+ *
+ * Returns false if the batch could not be set up, in which case nothing has
+ * been created.
+ */
+static bool
+lvp_create_pipelines_parallel(struct lvp_device *device,
+                              VkPipelineCache pipelineCache,
+                              uint32_t count,
+                              const void *pCreateInfos,
+                              size_t create_info_size,
+                              const VkPipelineCreateFlagBits2KHR *flags,
+                              lvp_pipeline_create_func create,
+                              VkPipeline *pPipelines,
+                              VkResult *result)
+{
+   struct lvp_pipeline_create_job *jobs =
+      vk_alloc(&device->vk.alloc, count * sizeof(*jobs), 8,
+               VK_SYSTEM_ALLOCATION_SCOPE_COMMAND);
+   if (!jobs)
+      return false;
+
+   for (uint32_t i = 0; i < count; i++) {
+      jobs[i] = (struct lvp_pipeline_create_job) {
+         .device = lvp_device_to_handle(device),
+         .cache = pipelineCache,
+         .create_info = (const uint8_t *)pCreateInfos + i * create_info_size,
+         .flags = flags[i],
+         .create = create,
+         .pipeline = &pPipelines[i],
+      };
+      util_queue_fence_init(&jobs[i].fence);
+      util_queue_add_job(&device->pipeline_queue, &jobs[i], &jobs[i].fence,
+                         lvp_pipeline_create_job_execute, NULL, 0);
+   }
+
+   *result = VK_SUCCESS;
+   for (uint32_t i = 0; i < count; i++) {
+      util_queue_fence_wait(&jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
+      if (jobs[i].result != VK_SUCCESS) {
+         *result = jobs[i].result;
+         pPipelines[i] = VK_NULL_HANDLE;
+      }
+   }
+
+   vk_free(&device->vk.alloc, jobs);
+   return true;
+}
+
+/**
+ * Start the device's pipeline queue if it isn't yet.  Devices which never
+ * create pipelines in batches don't get the threads.
+ */
+static bool
+lvp_init_pipeline_queue(struct lvp_device *device)
+{
+   simple_mtx_lock(&device->pipeline_queue_lock);
+   if (!util_queue_is_initialized(&device->pipeline_queue)) {
+      util_queue_init(&device->pipeline_queue, "lvp_pipe", 64,
+                      device->pipeline_queue_threads,
+                      UTIL_QUEUE_INIT_RESIZE_IF_FULL, NULL);
+   }
+   bool initialized = util_queue_is_initialized(&device->pipeline_queue);
+   simple_mtx_unlock(&device->pipeline_queue_lock);
+
+   return initialized;
+}
+
+/**
+ * Whether a vkCreate*Pipelines batch should be spread across the device's
+ * pipeline queue.
+ */
+static bool
+lvp_pipeline_batch_is_parallel(struct lvp_device *device, uint32_t count,
+                               const VkPipelineCreateFlagBits2KHR *flags)
+{
+   if (count < 2 || !device->pipeline_queue_threads)
+      return false;
+
+   for (uint32_t i = 0; i < count; i++) {
+      if (flags[i] & VK_PIPELINE_CREATE_2_EARLY_RETURN_ON_FAILURE_BIT_KHR)
+         return false;
+   }
+   return lvp_init_pipeline_queue(device);
+}
+
+static VkResult
+lvp_graphics_pipeline_create_single(VkDevice device,
+                                    VkPipelineCache cache,
+                                    const void *create_info,
+                                    VkPipelineCreateFlagBits2KHR flags,
+                                    VkPipeline *pipeline)
+{
+   return lvp_graphics_pipeline_create(device, cache, create_info, flags,
+                                       pipeline, false);
+}
+
 VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateGraphicsPipelines(
    VkDevice                                    _device,
    VkPipelineCache                             pipelineCache,
@@ -1077,10 +1144,25 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateGraphicsPipelines(
    const VkAllocationCallbacks*                pAllocator,
    VkPipeline*                                 pPipelines)
 {
+   VK_FROM_HANDLE(lvp_device, device, _device);
    VkResult result = VK_SUCCESS;
    unsigned i = 0;
 
-   for (; i < count; i++) {
+   STACK_ARRAY(VkPipelineCreateFlagBits2KHR, batch_flags, count);
+   for (i = 0; i < count; i++)
+      batch_flags[i] = vk_graphics_pipeline_create_flags(&pCreateInfos[i]);
+
+   bool done = lvp_pipeline_batch_is_parallel(device, count, batch_flags) &&
+               lvp_create_pipelines_parallel(device, pipelineCache, count,
+                                             pCreateInfos, sizeof(*pCreateInfos),
+                                             batch_flags,
+                                             lvp_graphics_pipeline_create_single,
+                                             pPipelines, &result);
+   STACK_ARRAY_FINISH(batch_flags);
+   if (done)
+      return result;
+
+   for (i = 0; i < count; i++) {
       VkResult r = VK_PIPELINE_COMPILE_REQUIRED;
       VkPipelineCreateFlagBits2KHR flags = vk_graphics_pipeline_create_flags(&pCreateInfos[i]);
 
@@ -1173,6 +1255,17 @@ lvp_compute_pipeline_create(
    return VK_SUCCESS;
 }
 
+static VkResult
+lvp_compute_pipeline_create_single(VkDevice device,
+                                   VkPipelineCache cache,
+                                   const void *create_info,
+                                   VkPipelineCreateFlagBits2KHR flags,
+                                   VkPipeline *pipeline)
+{
+   return lvp_compute_pipeline_create(device, cache, create_info, flags,
+                                      pipeline);
+}
+
 VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateComputePipelines(
    VkDevice                                    _device,
    VkPipelineCache                             pipelineCache,
@@ -1181,10 +1274,25 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateComputePipelines(
    const VkAllocationCallbacks*                pAllocator,
    VkPipeline*                                 pPipelines)
 {
+   VK_FROM_HANDLE(lvp_device, device, _device);
    VkResult result = VK_SUCCESS;
    unsigned i = 0;
 
-   for (; i < count; i++) {
+   STACK_ARRAY(VkPipelineCreateFlagBits2KHR, batch_flags, count);
+   for (i = 0; i < count; i++)
+      batch_flags[i] = vk_compute_pipeline_create_flags(&pCreateInfos[i]);
+
+   bool done = lvp_pipeline_batch_is_parallel(device, count, batch_flags) &&
+               lvp_create_pipelines_parallel(device, pipelineCache, count,
+                                             pCreateInfos, sizeof(*pCreateInfos),
+                                             batch_flags,
+                                             lvp_compute_pipeline_create_single,
+                                             pPipelines, &result);
+   STACK_ARRAY_FINISH(batch_flags);
+   if (done)
+      return result;
+
+   for (i = 0; i < count; i++) {
       VkResult r = VK_PIPELINE_COMPILE_REQUIRED;
       VkPipelineCreateFlagBits2KHR flags = vk_compute_pipeline_create_flags(&pCreateInfos[i]);
 
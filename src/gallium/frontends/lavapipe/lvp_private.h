@@ -221,6 +221,13 @@ struct lvp_device {
 
    uint32_t group_handle_alloc;
 
+   /* Worker threads for vkCreate*Pipelines batches (LVP_PIPELINE_COMPILE_THREADS),
+    * only started by the first batch which can use them.
+    */
+   struct util_queue pipeline_queue;
+   unsigned pipeline_queue_threads;
+   simple_mtx_t pipeline_queue_lock;
+
    struct vk_meta_device meta;
    radix_sort_vk_t *radix_sort;
    simple_mtx_t radix_sort_lock;
@@ -38,7 +38,11 @@
 #include "zstd.h"
 #endif
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "util/compress.h"
+#include "util/crc32.h"
 #include "util/perf/cpu_trace.h"
 #include "macros.h"
 
@@ -166,4 +170,180 @@ util_compress_inflate(const uint8_t *in_data, size_t in_data_size,
 #endif
 }
 
+/* A dictionary to improve the compression of small inputs, e.g. trained
+ * from similar data with zstd's ZDICT_trainFromBuffer().  zstd also accepts
+ * raw content dictionaries, which is what zlib uses it as.
+ */
+struct util_compress_dict {
+   uint32_t id;
+#ifdef HAVE_ZSTD
+   ZSTD_CDict *cdict;
+   ZSTD_DDict *ddict;
+#else
+   size_t size;
+   uint8_t data[];
+#endif
+};
+
+struct util_compress_dict *
+util_compress_dict_create(const void *dict_data, size_t dict_size)
+{
+   struct util_compress_dict *dict;
+
+   if (!dict_size)
+      return NULL;
+
+#ifdef HAVE_ZSTD
+   dict = calloc(1, sizeof(*dict));
+   if (!dict)
+      return NULL;
+
+   dict->cdict = ZSTD_createCDict(dict_data, dict_size,
+                                  ZSTD_COMPRESSION_LEVEL);
+   dict->ddict = ZSTD_createDDict(dict_data, dict_size);
+   if (!dict->cdict || !dict->ddict) {
+      util_compress_dict_destroy(dict);
+      return NULL;
+   }
+#else
+   dict = malloc(sizeof(*dict) + dict_size);
+   if (!dict)
+      return NULL;
+
+   dict->size = dict_size;
+   memcpy(dict->data, dict_data, dict_size);
+#endif
+
+   /* Zero is reserved for data compressed without a dictionary. */
+   dict->id = MAX2(util_hash_crc32(dict_data, dict_size), 1);
+
+   return dict;
+}
+
+void
+util_compress_dict_destroy(struct util_compress_dict *dict)
+{
+   if (!dict)
+      return;
+
+#ifdef HAVE_ZSTD
+   ZSTD_freeCDict(dict->cdict);
+   ZSTD_freeDDict(dict->ddict);
+#endif
+   free(dict);
+}
+
+/* Returns a non-zero identifier of the dictionary contents. */
+uint32_t
+util_compress_dict_id(const struct util_compress_dict *dict)
+{
+   return dict->id;
+}
+
+/* Compress data with a dictionary, which is required to decompress it too,
+ * and return the size of the compressed data.
+ */
+size_t
+util_compress_deflate_dict(const struct util_compress_dict *dict,
+                           const uint8_t *in_data, size_t in_data_size,
+                           uint8_t *out_data, size_t out_buff_size)
+{
+   MESA_TRACE_FUNC();
+#ifdef HAVE_ZSTD
+   ZSTD_CCtx *cctx = ZSTD_createCCtx();
+   if (!cctx)
+      return 0;
+
+   size_t ret = ZSTD_compress_usingCDict(cctx, out_data, out_buff_size,
+                                         in_data, in_data_size, dict->cdict);
+   ZSTD_freeCCtx(cctx);
+   if (ZSTD_isError(ret))
+      return 0;
+
+   return ret;
+#elif defined(HAVE_ZLIB)
+   size_t compressed_size = 0;
+
+   z_stream strm;
+   strm.zalloc = Z_NULL;
+   strm.zfree = Z_NULL;
+   strm.opaque = Z_NULL;
+   strm.next_in = in_data;
+   strm.next_out = out_data;
+   strm.avail_in = in_data_size;
+   strm.avail_out = out_buff_size;
+
+   int ret = deflateInit(&strm, Z_BEST_COMPRESSION);
+   if (ret != Z_OK) {
+       (void) deflateEnd(&strm);
+       return 0;
+   }
+
+   /* zlib only uses the last 32K of the dictionary. */
+   ret = deflateSetDictionary(&strm, dict->data, dict->size);
+   if (ret == Z_OK)
+      ret = deflate(&strm, Z_FINISH);
+
+   if (ret == Z_STREAM_END)
+      compressed_size = strm.total_out;
+
+   (void) deflateEnd(&strm);
+   return compressed_size;
+#else
+   STATIC_ASSERT(false);
+#endif
+}
+
+/**
+ * Decompresses data compressed with util_compress_deflate_dict(), returns
+ * true if successful.
+ */
+bool
+util_compress_inflate_dict(const struct util_compress_dict *dict,
+                           const uint8_t *in_data, size_t in_data_size,
+                           uint8_t *out_data, size_t out_data_size)
+{
+   MESA_TRACE_FUNC();
+#ifdef HAVE_ZSTD
+   ZSTD_DCtx *dctx = ZSTD_createDCtx();
+   if (!dctx)
+      return false;
+
+   size_t ret = ZSTD_decompress_usingDDict(dctx, out_data, out_data_size,
+                                           in_data, in_data_size,
+                                           dict->ddict);
+   ZSTD_freeDCtx(dctx);
+   return !ZSTD_isError(ret);
+#elif defined(HAVE_ZLIB)
+   z_stream strm;
+
+   strm.zalloc = Z_NULL;
+   strm.zfree = Z_NULL;
+   strm.opaque = Z_NULL;
+   strm.next_in = in_data;
+   strm.avail_in = in_data_size;
+   strm.next_out = out_data;
+   strm.avail_out = out_data_size;
+
+   int ret = inflateInit(&strm);
+   if (ret != Z_OK)
+      return false;
+
+   /* The stream header tells that the dictionary is needed, and checks that
+    * it's the one the data was compressed with.
+    */
+   ret = inflate(&strm, Z_NO_FLUSH);
+   if (ret == Z_NEED_DICT) {
+      ret = inflateSetDictionary(&strm, dict->data, dict->size);
+      if (ret == Z_OK)
+         ret = inflate(&strm, Z_NO_FLUSH);
+   }
+
+   (void)inflateEnd(&strm);
+   return ret == Z_STREAM_END && strm.avail_out == 0;
+#else
+   STATIC_ASSERT(false);
+#endif
+}
+
 #endif
@@ -39,6 +39,7 @@
 
 #include "util/compress.h"
 #include "util/crc32.h"
+#include "util/hash_table.h"
 #include "util/u_debug.h"
 #include "util/rand_xor.h"
 #include "util/u_atomic.h"
@@ -51,20 +52,6 @@
 #include "disk_cache.h"
 #include "disk_cache_os.h"
 
-/* The cache version should be bumped whenever a change is made to the
- * structure of cache entries or the index. This will give any 3rd party
- * applications reading the cache entries a chance to adjust to the changes.
- *
- * - The cache version is checked internally when reading a cache entry. If we
- *   ever have a mismatch we are in big trouble as this means we had a cache
- *   collision. In case of such an event please check the skys for giant
- *   asteroids and that the entire Mesa team hasn't been eaten by wolves.
- *
- * - There is no strict requirement that cache versions be backwards
- *   compatible but effort should be taken to limit disruption where possible.
- */
-#define CACHE_VERSION 1
-
 #define DRV_KEY_CPY(_dst, _src, _src_size) \
 do {                                       \
    memcpy(_dst, _src, _src_size);          \
@@ -116,6 +103,8 @@ disk_cache_type_create(const char *gpu_name,
    if (cache == NULL)
       goto fail;
 
+   simple_mtx_init(&cache->get_mtx, mtx_plain);
+
    /* Assume failure. */
    cache->path_init_failed = true;
    cache->type = DISK_CACHE_NONE;
@@ -166,6 +155,8 @@ disk_cache_type_create(const char *gpu_name,
    if (!disk_cache_init_queue(cache))
       goto fail;
 
+   disk_cache_load_dicts(cache, gpu_name);
+
    cache->path_init_failed = false;
 
  path_fail:
@@ -321,6 +312,17 @@ disk_cache_create_custom(const char *gpu_name, const char *driver_id,
                                  DISK_CACHE_DATABASE, max_size);
 }
 
+/* Items kept by disk_cache_prefetch() are dropped rather than kept beyond
+ * this, prefetching is only a hint.
+ */
+#define DISK_CACHE_MAX_PREFETCHED_SIZE (64 * 1024 * 1024)
+
+struct disk_cache_prefetched_item {
+   cache_key key;
+   void *data;
+   size_t size;
+};
+
 void
 disk_cache_destroy(struct disk_cache *cache)
 {
@@ -330,6 +332,21 @@ disk_cache_destroy(struct disk_cache *cache)
                 cache->stats.misses);
    }
 
+   if (cache && util_queue_is_initialized(&cache->get_queue)) {
+      util_queue_finish(&cache->get_queue);
+      util_queue_destroy(&cache->get_queue);
+   }
+
+   if (cache && cache->prefetched) {
+      hash_table_foreach(cache->prefetched, entry) {
+         struct disk_cache_prefetched_item *item = entry->data;
+         free(item->data);
+      }
+   }
+
+   if (cache)
+      simple_mtx_destroy(&cache->get_mtx);
+
    if (cache && util_queue_is_initialized(&cache->cache_queue)) {
       util_queue_finish(&cache->cache_queue);
       util_queue_destroy(&cache->cache_queue);
@@ -344,6 +361,7 @@ disk_cache_destroy(struct disk_cache *cache)
          mesa_cache_db_multipart_close(&cache->cache_db);
 
       disk_cache_destroy_mmap(cache);
+      disk_cache_destroy_dicts(cache);
    }
 
    ralloc_free(cache);
@@ -353,6 +371,10 @@ void
 disk_cache_wait_for_idle(struct disk_cache *cache)
 {
    util_queue_finish(&cache->cache_queue);
+
+   /* Also wait for disk_cache_prefetch() jobs. */
+   if (util_queue_is_initialized(&cache->get_queue))
+      util_queue_finish(&cache->get_queue);
 }
 
 void
@@ -598,8 +620,8 @@ disk_cache_put_nocopy(struct disk_cache *cache, const cache_key key,
    }
 }
 
-void *
-disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
+static void *
+disk_cache_load(struct disk_cache *cache, const cache_key key, size_t *size)
 {
    void *buf = NULL;
 
@@ -623,16 +645,388 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
       }
    }
 
+   return buf;
+}
+
+static void
+disk_cache_count_lookup(struct disk_cache *cache, bool hit)
+{
    if (unlikely(cache->stats.enabled)) {
-      if (buf)
+      if (hit)
          p_atomic_inc(&cache->stats.hits);
       else
          p_atomic_inc(&cache->stats.misses);
    }
+}
+
+static uint32_t
+prefetched_key_hash(const void *key)
+{
+   /* Cache keys are already hashes. */
+   uint32_t hash;
+   memcpy(&hash, key, sizeof(hash));
+   return hash;
+}
+
+static bool
+prefetched_key_equal(const void *a, const void *b)
+{
+   return memcmp(a, b, CACHE_KEY_SIZE) == 0;
+}
+
+/* Take an item loaded by disk_cache_prefetch() out of the cache. */
+static void *
+disk_cache_take_prefetched(struct disk_cache *cache, const cache_key key,
+                           size_t *size)
+{
+   void *buf = NULL;
+
+   if (!p_atomic_read(&cache->num_prefetched))
+      return NULL;
+
+   simple_mtx_lock(&cache->get_mtx);
+   struct hash_entry *entry = _mesa_hash_table_search(cache->prefetched, key);
+   if (entry) {
+      struct disk_cache_prefetched_item *item = entry->data;
+      _mesa_hash_table_remove(cache->prefetched, entry);
+      p_atomic_dec(&cache->num_prefetched);
+      cache->prefetched_size -= item->size;
+
+      buf = item->data;
+      if (size)
+         *size = item->size;
+      ralloc_free(item);
+   }
+   simple_mtx_unlock(&cache->get_mtx);
 
    return buf;
 }
 
+void *
+disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
+{
+   void *buf = disk_cache_take_prefetched(cache, key, size);
+
+   if (!buf)
+      buf = disk_cache_load(cache, key, size);
+
+   disk_cache_count_lookup(cache, buf != NULL);
+
+   return buf;
+}
+
+static bool
+disk_cache_init_get_queue(struct disk_cache *cache)
+{
+   if (util_queue_is_initialized(&cache->get_queue))
+      return true;
+
+   /* Lookups are waited on by the application, so unlike the put queue this
+    * one runs at normal priority.  See disk_cache_init_queue() for the number
+    * of threads.
+    */
+   simple_mtx_lock(&cache->get_mtx);
+   bool ret = util_queue_is_initialized(&cache->get_queue) ||
+              util_queue_init(&cache->get_queue, "disk_get$", 32, 4,
+                              UTIL_QUEUE_INIT_RESIZE_IF_FULL, NULL);
+   simple_mtx_unlock(&cache->get_mtx);
+
+   return ret;
+}
+
+struct disk_cache_get_job {
+   struct util_queue_fence fence;
+   struct disk_cache *cache;
+   const uint8_t *key;
+
+   /* Undecoded database entry, or NULL to do a full lookup of key. */
+   void *raw_item;
+   size_t raw_item_size;
+
+   void *data;
+   size_t size;
+};
+
+static void
+cache_get(void *job, void *gdata, int thread_index)
+{
+   struct disk_cache_get_job *gj = job;
+
+   if (gj->raw_item) {
+      gj->data = disk_cache_parse_raw_item(gj->cache, gj->raw_item,
+                                           gj->raw_item_size, &gj->size);
+   } else {
+      gj->data = disk_cache_load(gj->cache, gj->key, &gj->size);
+   }
+}
+
+/**
+ * Load \p count items, decoding them on the get queue if \p parallel.
+ * Doesn't look at the prefetched items nor update the stats.
+ */
+static unsigned
+disk_cache_load_many(struct disk_cache *cache, unsigned count,
+                     const cache_key *keys, void **data, size_t *sizes,
+                     bool parallel)
+{
+   struct disk_cache_get_job *jobs = calloc(count, sizeof(*jobs));
+   void **raw_items = NULL;
+   size_t *raw_item_sizes = NULL;
+   unsigned num_jobs = 0, found = 0;
+
+   if (!jobs)
+      goto serial;
+
+   for (unsigned i = 0; i < count; i++) {
+      jobs[i].cache = cache;
+      jobs[i].key = keys[i];
+   }
+
+   /* The database can read all entries with a single lock and in file
+    * order, leaving only the decoding to be done per item.  The read-only
+    * cache has to be tried first to give the same results as
+    * disk_cache_get().
+    */
+   if (cache->type == DISK_CACHE_DATABASE && !cache->blob_get_cb &&
+       !cache->foz_ro_cache) {
+      raw_items = malloc(count * (sizeof(*raw_items) +
+                                  sizeof(*raw_item_sizes)));
+      if (!raw_items)
+         goto serial;
+      raw_item_sizes = (size_t *)(raw_items + count);
+
+      disk_cache_db_load_raw_items(cache, count, keys, raw_items,
+                                   raw_item_sizes);
+
+      for (unsigned i = 0; i < count; i++) {
+         if (raw_items[i]) {
+            jobs[num_jobs] = jobs[i];
+            jobs[num_jobs].raw_item = raw_items[i];
+            jobs[num_jobs].raw_item_size = raw_item_sizes[i];
+            num_jobs++;
+         }
+      }
+      free(raw_items);
+   } else {
+      num_jobs = count;
+   }
+
+   if (parallel && num_jobs > 1 && disk_cache_init_get_queue(cache)) {
+      for (unsigned i = 0; i < num_jobs; i++) {
+         util_queue_fence_init(&jobs[i].fence);
+         util_queue_add_job(&cache->get_queue, &jobs[i], &jobs[i].fence,
+                            cache_get, NULL, 0);
+      }
+      for (unsigned i = 0; i < num_jobs; i++) {
+         util_queue_fence_wait(&jobs[i].fence);
+         util_queue_fence_destroy(&jobs[i].fence);
+      }
+   } else {
+      for (unsigned i = 0; i < num_jobs; i++)
+         cache_get(&jobs[i], NULL, 0);
+   }
+
+   /* Jobs only reference their key, map them back to the caller's slots. */
+   for (unsigned i = 0; i < count; i++) {
+      data[i] = NULL;
+      sizes[i] = 0;
+   }
+   for (unsigned i = 0; i < num_jobs; i++) {
+      const unsigned idx = (const cache_key *)jobs[i].key - keys;
+      if (jobs[i].data) {
+         data[idx] = jobs[i].data;
+         sizes[idx] = jobs[i].size;
+         found++;
+      }
+   }
+
+   free(jobs);
+   return found;
+
+serial:
+   free(jobs);
+   for (unsigned i = 0; i < count; i++) {
+      data[i] = disk_cache_load(cache, keys[i], &sizes[i]);
+      if (data[i])
+         found++;
+   }
+   return found;
+}
+
+unsigned
+disk_cache_get_many(struct disk_cache *cache, unsigned count,
+                    const cache_key *keys, void **data, size_t *sizes)
+{
+   size_t *item_sizes = sizes;
+   unsigned found = 0;
+
+   if (!count)
+      return 0;
+
+   if (!sizes) {
+      item_sizes = malloc(count * sizeof(*item_sizes));
+      if (!item_sizes) {
+         for (unsigned i = 0; i < count; i++) {
+            data[i] = disk_cache_get(cache, keys[i], NULL);
+            if (data[i])
+               found++;
+         }
+         return found;
+      }
+   }
+
+   if (!p_atomic_read(&cache->num_prefetched)) {
+      found = disk_cache_load_many(cache, count, keys, data, item_sizes, true);
+   } else {
+      /* Only load what disk_cache_prefetch() didn't already. */
+      unsigned num_missing = 0;
+      for (unsigned i = 0; i < count; i++) {
+         data[i] = disk_cache_take_prefetched(cache, keys[i], &item_sizes[i]);
+         if (data[i])
+            found++;
+         else
+            num_missing++;
+      }
+
+      cache_key *missing_keys = NULL;
+      void **missing_data = NULL;
+      if (num_missing) {
+         missing_keys = malloc(num_missing * sizeof(*missing_keys));
+         missing_data = malloc(num_missing * (sizeof(void *) +
+                                              sizeof(size_t)));
+      }
+
+      if (missing_keys && missing_data) {
+         size_t *missing_sizes = (size_t *)(missing_data + num_missing);
+
+         for (unsigned i = 0, j = 0; i < count; i++) {
+            if (!data[i])
+               memcpy(missing_keys[j++], keys[i], sizeof(cache_key));
+         }
+
+         found += disk_cache_load_many(cache, num_missing,
+                                       (const cache_key *)missing_keys,
+                                       missing_data, missing_sizes, true);
+
+         for (unsigned i = 0, j = 0; i < count; i++) {
+            if (!data[i]) {
+               data[i] = missing_data[j];
+               item_sizes[i] = missing_sizes[j];
+               j++;
+            }
+         }
+      } else if (num_missing) {
+         for (unsigned i = 0; i < count; i++) {
+            if (!data[i]) {
+               data[i] = disk_cache_load(cache, keys[i], &item_sizes[i]);
+               if (data[i])
+                  found++;
+            }
+         }
+      }
+
+      free(missing_keys);
+      free(missing_data);
+   }
+
+   for (unsigned i = 0; i < count; i++)
+      disk_cache_count_lookup(cache, data[i] != NULL);
+
+   if (item_sizes != sizes)
+      free(item_sizes);
+
+   return found;
+}
+
+struct disk_cache_prefetch_job {
+   struct util_queue_fence fence;
+   struct disk_cache *cache;
+   unsigned count;
+   cache_key keys[];
+};
+
+static void
+cache_prefetch(void *job, void *gdata, int thread_index)
+{
+   struct disk_cache_prefetch_job *pj = job;
+   struct disk_cache *cache = pj->cache;
+
+   void **data = malloc(pj->count * (sizeof(void *) + sizeof(size_t)));
+   if (!data)
+      return;
+   size_t *sizes = (size_t *)(data + pj->count);
+
+   /* Already running on the get queue, waiting on it could deadlock. */
+   disk_cache_load_many(cache, pj->count, (const cache_key *)pj->keys,
+                        data, sizes, false);
+
+   simple_mtx_lock(&cache->get_mtx);
+   for (unsigned i = 0; i < pj->count; i++) {
+      if (!data[i])
+         continue;
+
+      struct disk_cache_prefetched_item *item = NULL;
+      if (cache->prefetched_size + sizes[i] <= DISK_CACHE_MAX_PREFETCHED_SIZE &&
+          !_mesa_hash_table_search(cache->prefetched, pj->keys[i]))
+         item = ralloc(cache->prefetched, struct disk_cache_prefetched_item);
+
+      if (!item) {
+         free(data[i]);
+         continue;
+      }
+
+      memcpy(item->key, pj->keys[i], sizeof(cache_key));
+      item->data = data[i];
+      item->size = sizes[i];
+      _mesa_hash_table_insert(cache->prefetched, item->key, item);
+      cache->prefetched_size += sizes[i];
+      p_atomic_inc(&cache->num_prefetched);
+   }
+   simple_mtx_unlock(&cache->get_mtx);
+
+   free(data);
+}
+
+static void
+destroy_prefetch_job(void *job, void *gdata, int thread_index)
+{
+   struct disk_cache_prefetch_job *pj = job;
+
+   util_queue_fence_destroy(&pj->fence);
+   free(pj);
+}
+
+void
+disk_cache_prefetch(struct disk_cache *cache, unsigned count,
+                    const cache_key *keys)
+{
+   if (!count || cache->type == DISK_CACHE_NONE ||
+       !disk_cache_init_get_queue(cache))
+      return;
+
+   simple_mtx_lock(&cache->get_mtx);
+   if (!cache->prefetched) {
+      cache->prefetched = _mesa_hash_table_create(cache, prefetched_key_hash,
+                                                  prefetched_key_equal);
+   }
+   simple_mtx_unlock(&cache->get_mtx);
+   if (!cache->prefetched)
+      return;
+
+   struct disk_cache_prefetch_job *pj =
+      malloc(sizeof(*pj) + count * sizeof(cache_key));
+   if (!pj)
+      return;
+
+   pj->cache = cache;
+   pj->count = count;
+   memcpy(pj->keys, keys, count * sizeof(cache_key));
+
+   util_queue_fence_init(&pj->fence);
+   util_queue_add_job(&cache->get_queue, pj, &pj->fence,
+                      cache_prefetch, destroy_prefetch_job, 0);
+}
+
 void
 disk_cache_put_key(struct disk_cache *cache, const cache_key key)
 {
@@ -176,8 +176,8 @@ disk_cache_create_custom(const char *gpu_name, const char *driver_id,
 void
 disk_cache_destroy(struct disk_cache *cache);
 
-/* Wait for all previous disk_cache_put() calls to be processed (used for unit
- * testing).
+/* Wait for all previous disk_cache_put() and disk_cache_prefetch() calls to
+ * be processed (used for unit testing).
  */
 void
 disk_cache_wait_for_idle(struct disk_cache *cache);
@@ -234,6 +234,32 @@ disk_cache_put_nocopy(struct disk_cache *cache, const cache_key key,
 void *
 disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size);
 
+/**
+ * Retrieve several items at once.
+ *
+ * Gives the same results as calling disk_cache_get() for each of the \count
+ * \keys, storing the objects in \data and their sizes in \sizes (which may
+ * be NULL).  Lookups in a single database file are batched and the items are
+ * decompressed on worker threads.
+ *
+ * \return The number of items found.
+ */
+unsigned
+disk_cache_get_many(struct disk_cache *cache, unsigned count,
+                    const cache_key *keys, void **data, size_t *sizes);
+
+/**
+ * Hint that the items stored under \keys will be retrieved soon.
+ *
+ * The items are loaded in the background and handed out by the next
+ * disk_cache_get() or disk_cache_get_many() of their key.  This is only a
+ * hint: items may be dropped, e.g. when too much memory is already taken
+ * by prefetched items.
+ */
+void
+disk_cache_prefetch(struct disk_cache *cache, unsigned count,
+                    const cache_key *keys);
+
 /**
  * Store the name \key within the cache, (without any associated data).
  *
@@ -317,6 +343,24 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
    return NULL;
 }
 
+static inline unsigned
+disk_cache_get_many(struct disk_cache *cache, unsigned count,
+                    const cache_key *keys, void **data, size_t *sizes)
+{
+   for (unsigned i = 0; i < count; i++) {
+      data[i] = NULL;
+      if (sizes)
+         sizes[i] = 0;
+   }
+   return 0;
+}
+
+static inline void
+disk_cache_prefetch(struct disk_cache *cache, unsigned count,
+                    const cache_key *keys)
+{
+}
+
 static inline void
 disk_cache_put_key(struct disk_cache *cache, const cache_key key)
 {
@@ -86,6 +86,7 @@ disk_cache_get_function_identifier(void *ptr, blake3_hasher *ctx)
 
 #else
 
+#include <ctype.h>
 #include <dirent.h>
 #include <errno.h>
 #include <pwd.h>
@@ -547,6 +548,62 @@ disk_cache_evict_item(struct disk_cache *cache, char *filename)
       p_atomic_add(&cache->size->value, - (uint64_t)sb.st_blocks * 512);
 }
 
+static const struct util_compress_dict *
+find_dict(struct disk_cache *cache, uint32_t dict_id)
+{
+   for (unsigned i = 0; i < cache->num_dicts; i++) {
+      if (util_compress_dict_id(cache->dicts[i]) == dict_id)
+         return cache->dicts[i];
+   }
+
+   return NULL;
+}
+
+/* Check and uncompress the data following the cache_entry_file_data */
+static void *
+uncompress_cache_item_data(struct disk_cache *cache,
+                           const struct cache_entry_file_data *cf_data,
+                           const uint8_t *data, size_t data_size)
+{
+   const struct util_compress_dict *dict = NULL;
+
+   /* Check the data for corruption */
+   if (cf_data->crc32 != util_hash_crc32(data, data_size))
+      return NULL;
+
+   /* Entries written with a dictionary we don't have are simply misses */
+   if (cf_data->dict_id) {
+      dict = find_dict(cache, cf_data->dict_id);
+      if (!dict)
+         return NULL;
+   }
+
+   uint8_t *uncompressed_data = malloc(cf_data->uncompressed_size);
+   if (!uncompressed_data)
+      return NULL;
+
+   if (cache->compression_disabled) {
+      if (cf_data->uncompressed_size != data_size)
+         goto fail;
+
+      memcpy(uncompressed_data, data, data_size);
+   } else if (dict) {
+      if (!util_compress_inflate_dict(dict, data, data_size, uncompressed_data,
+                                      cf_data->uncompressed_size))
+         goto fail;
+   } else {
+      if (!util_compress_inflate(data, data_size, uncompressed_data,
+                                 cf_data->uncompressed_size))
+         goto fail;
+   }
+
+   return uncompressed_data;
+
+fail:
+   free(uncompressed_data);
+   return NULL;
+}
+
 static void *
 parse_and_validate_cache_item(struct disk_cache *cache, void *cache_item,
                               size_t cache_item_size, size_t *size)
@@ -598,26 +655,11 @@ parse_and_validate_cache_item(struct disk_cache *cache, void *cache_item,
    size_t cache_data_size = ci_blob_reader.end - ci_blob_reader.current;
    const uint8_t *data = (uint8_t *) blob_read_bytes(&ci_blob_reader, cache_data_size);
 
-   /* Check the data for corruption */
-   if (cf_data->crc32 != util_hash_crc32(data, cache_data_size))
-      goto fail;
-
-   /* Uncompress the cache data */
-   uncompressed_data = malloc(cf_data->uncompressed_size);
+   uncompressed_data =
+      uncompress_cache_item_data(cache, cf_data, data, cache_data_size);
    if (!uncompressed_data)
       goto fail;
 
-   if (cache->compression_disabled) {
-      if (cf_data->uncompressed_size != cache_data_size)
-         goto fail;
-
-      memcpy(uncompressed_data, data, cache_data_size);
-   } else {
-      if (!util_compress_inflate(data, cache_data_size, uncompressed_data,
-                                 cf_data->uncompressed_size))
-         goto fail;
-   }
-
    if (size)
       *size = cf_data->uncompressed_size;
 
@@ -698,6 +740,7 @@ create_cache_item_header_and_blob(struct disk_cache_put_job *dc_job,
 {
 
    /* Compress the cache item data */
+   const struct util_compress_dict *dict = dc_job->cache->compress_dict;
    size_t max_buf = util_compress_max_compressed_len(dc_job->size);
    size_t compressed_size;
    void *compressed_data;
@@ -705,13 +748,20 @@ create_cache_item_header_and_blob(struct disk_cache_put_job *dc_job,
    if (dc_job->cache->compression_disabled) {
       compressed_size = dc_job->size;
       compressed_data = dc_job->data;
+      dict = NULL;
    } else {
       compressed_data = malloc(max_buf);
       if (compressed_data == NULL)
          return false;
-      compressed_size =
-         util_compress_deflate(dc_job->data, dc_job->size,
-                              compressed_data, max_buf);
+      if (dict) {
+         compressed_size =
+            util_compress_deflate_dict(dict, dc_job->data, dc_job->size,
+                                       compressed_data, max_buf);
+      } else {
+         compressed_size =
+            util_compress_deflate(dc_job->data, dc_job->size,
+                                 compressed_data, max_buf);
+      }
       if (compressed_size == 0)
          goto fail;
    }
@@ -748,6 +798,7 @@ create_cache_item_header_and_blob(struct disk_cache_put_job *dc_job,
    struct cache_entry_file_data cf_data;
    cf_data.crc32 = util_hash_crc32(compressed_data, compressed_size);
    cf_data.uncompressed_size = dc_job->size;
+   cf_data.dict_id = dict ? util_compress_dict_id(dict) : 0;
 
    if (!blob_write_bytes(cache_blob, &cf_data, sizeof(cf_data)))
       goto fail;
@@ -1200,6 +1251,349 @@ disk_cache_db_load_item(struct disk_cache *cache, const cache_key key,
    return uncompressed_data;
 }
 
+/* Read the undecoded entries of several keys in one go, see
+ * disk_cache_parse_raw_item().
+ */
+unsigned
+disk_cache_db_load_raw_items(struct disk_cache *cache, unsigned count,
+                             const cache_key *keys, void **items,
+                             size_t *item_sizes)
+{
+   const uint8_t **keys_160bit = malloc(count * sizeof(*keys_160bit));
+   if (!keys_160bit) {
+      memset(items, 0, count * sizeof(*items));
+      return 0;
+   }
+
+   /* The DB takes its keys by reference. */
+   for (unsigned i = 0; i < count; i++)
+      keys_160bit[i] = keys[i];
+
+   unsigned found =
+      mesa_cache_db_multipart_read_entries(&cache->cache_db, count,
+                                           keys_160bit, items, item_sizes);
+   free(keys_160bit);
+
+   return found;
+}
+
+/* Validate and uncompress an entry returned by disk_cache_db_load_raw_items(),
+ * freeing it.
+ */
+void *
+disk_cache_parse_raw_item(struct disk_cache *cache, void *item,
+                          size_t item_size, size_t *size)
+{
+   uint8_t *uncompressed_data =
+       parse_and_validate_cache_item(cache, item, item_size, size);
+   free(item);
+
+   return uncompressed_data;
+}
+
+/* Return the path of the compression dictionary for gpu_name in the cache
+ * directory, that is of the current dictionary if dict_id is 0, or else of
+ * the replaced one with that id.
+ */
+char *
+disk_cache_get_dict_filename(void *mem_ctx, const char *path,
+                             const char *gpu_name, uint32_t dict_id)
+{
+   char *name = ralloc_strdup(mem_ctx, gpu_name);
+   char *filename;
+
+   if (!name)
+      return NULL;
+
+   for (char *c = name; *c; c++) {
+      if (!isalnum((unsigned char)*c) && *c != '-' && *c != '_')
+         *c = '_';
+   }
+
+   if (dict_id)
+      filename = ralloc_asprintf(mem_ctx, "%s/%s.%08x.dict", path, name,
+                                 dict_id);
+   else
+      filename = ralloc_asprintf(mem_ctx, "%s/%s.dict", path, name);
+
+   ralloc_free(name);
+
+   return filename;
+}
+
+static struct util_compress_dict *
+load_dict(const char *filename)
+{
+   struct util_compress_dict *dict = NULL;
+   void *data = NULL;
+   struct stat sb;
+
+   int fd = open(filename, O_RDONLY | O_CLOEXEC);
+   if (fd == -1)
+      return NULL;
+
+   if (fstat(fd, &sb) == -1 || !sb.st_size)
+      goto out;
+
+   data = malloc(sb.st_size);
+   if (!data || read_all(fd, data, sb.st_size) != sb.st_size)
+      goto out;
+
+   dict = util_compress_dict_create(data, sb.st_size);
+
+out:
+   free(data);
+   close(fd);
+
+   return dict;
+}
+
+/* Load the compression dictionaries of gpu_name, as installed in the cache
+ * directory by the mesa_cache_train_dict tool.
+ *
+ * New entries are compressed with the current dictionary, the ones it
+ * replaced are only kept to read the entries written with them.
+ */
+void
+disk_cache_load_dicts(struct disk_cache *cache, const char *gpu_name)
+{
+   void *local = ralloc_context(NULL);
+   struct dirent *entry;
+   DIR *dir;
+
+   if (cache->compression_disabled)
+      goto out;
+
+   char *filename = disk_cache_get_dict_filename(local, cache->path,
+                                                 gpu_name, 0);
+   if (!filename)
+      goto out;
+
+   const char *current = strrchr(filename, '/') + 1;
+   const size_t name_len = strlen(current) - strlen(".dict");
+
+   dir = opendir(cache->path);
+   if (!dir)
+      goto out;
+
+   while ((entry = readdir(dir)) != NULL) {
+      const char *d_name = entry->d_name;
+      const size_t len = strlen(d_name);
+
+      /* <name>.dict or <name>.<id>.dict */
+      bool is_current = strcmp(d_name, current) == 0;
+      if (!is_current &&
+          (len != name_len + strlen(".12345678.dict") ||
+           strncmp(d_name, current, name_len + 1) ||
+           strcmp(d_name + len - strlen(".dict"), ".dict")))
+         continue;
+
+      struct util_compress_dict **dicts =
+         realloc(cache->dicts, (cache->num_dicts + 1) * sizeof(*dicts));
+      if (!dicts)
+         break;
+      cache->dicts = dicts;
+
+      char *path = ralloc_asprintf(local, "%s/%s", cache->path, d_name);
+      struct util_compress_dict *dict = path ? load_dict(path) : NULL;
+      if (!dict)
+         continue;
+
+      cache->dicts[cache->num_dicts++] = dict;
+      if (is_current)
+         cache->compress_dict = dict;
+   }
+
+   closedir(dir);
+
+out:
+   ralloc_free(local);
+}
+
+void
+disk_cache_destroy_dicts(struct disk_cache *cache)
+{
+   for (unsigned i = 0; i < cache->num_dicts; i++)
+      util_compress_dict_destroy(cache->dicts[i]);
+
+   free(cache->dicts);
+   cache->dicts = NULL;
+   cache->num_dicts = 0;
+   cache->compress_dict = NULL;
+}
+
+struct disk_cache_walk {
+   struct disk_cache cache;
+   const char *gpu_name;
+   disk_cache_item_cb cb;
+   void *data;
+};
+
+/* Unlike parse_and_validate_cache_item(), this accepts the entries of all
+ * drivers and builds, only filtering them by GPU name.
+ */
+static void
+walk_cache_item(struct disk_cache_walk *walk, const void *cache_item,
+                size_t cache_item_size)
+{
+   struct blob_reader reader;
+   blob_reader_init(&reader, cache_item, cache_item_size);
+
+   /* The driver keys, see disk_cache_type_create() */
+   if (blob_read_uint8(&reader) != CACHE_VERSION)
+      return;
+
+   blob_read_string(&reader);
+   const char *gpu_name = blob_read_string(&reader);
+   blob_read_uint8(&reader);
+   blob_read_bytes(&reader, sizeof(uint64_t));
+   if (reader.overrun || strcmp(gpu_name, walk->gpu_name))
+      return;
+
+   if (blob_read_uint32(&reader) == CACHE_ITEM_TYPE_GLSL) {
+      uint32_t num_keys = blob_read_uint32(&reader);
+      blob_read_bytes(&reader, num_keys * sizeof(cache_key));
+   }
+
+   const struct cache_entry_file_data *cf_data =
+      blob_read_bytes(&reader, sizeof(struct cache_entry_file_data));
+   if (reader.overrun)
+      return;
+
+   size_t data_size = reader.end - reader.current;
+   const uint8_t *data = blob_read_bytes(&reader, data_size);
+
+   void *uncompressed_data =
+      uncompress_cache_item_data(&walk->cache, cf_data, data, data_size);
+   if (!uncompressed_data)
+      return;
+
+   walk->cb(walk->data, uncompressed_data, cf_data->uncompressed_size);
+   free(uncompressed_data);
+}
+
+static void
+walk_db_entry(void *data, const uint8_t *cache_key_160bit,
+              const void *blob, size_t blob_size)
+{
+   walk_cache_item(data, blob, blob_size);
+}
+
+static bool
+walk_db(struct disk_cache_walk *walk, const char *path)
+{
+   struct stat sb;
+   bool found = false;
+
+   for (unsigned part = 0;; part++) {
+      char *part_path;
+      if (asprintf(&part_path, "%s/part%u", path, part) == -1)
+         break;
+
+      if (stat(part_path, &sb) == -1 || !S_ISDIR(sb.st_mode)) {
+         free(part_path);
+         break;
+      }
+
+      struct mesa_cache_db db = {0};
+      if (mesa_cache_db_open(&db, part_path)) {
+         found |= mesa_cache_db_foreach_entry(&db, walk_db_entry, walk);
+         mesa_cache_db_close(&db);
+      }
+
+      free(part_path);
+   }
+
+   return found;
+}
+
+static bool
+walk_multi_file(struct disk_cache_walk *walk, const char *path)
+{
+   struct dirent *entry, *subentry;
+   struct stat sb;
+   DIR *dir, *subdir;
+
+   dir = opendir(path);
+   if (!dir)
+      return false;
+
+   while ((entry = readdir(dir)) != NULL) {
+      if (strlen(entry->d_name) != 2 || strcmp(entry->d_name, "..") == 0)
+         continue;
+
+      char *subdir_path;
+      if (asprintf(&subdir_path, "%s/%s", path, entry->d_name) == -1)
+         continue;
+
+      subdir = opendir(subdir_path);
+      while (subdir && (subentry = readdir(subdir)) != NULL) {
+         char *filename;
+         if (asprintf(&filename, "%s/%s", subdir_path, subentry->d_name) == -1)
+            continue;
+
+         if (stat(filename, &sb) == 0 &&
+             is_regular_non_tmp_file(filename, &sb, subentry->d_name,
+                                     strlen(subentry->d_name))) {
+            int fd = open(filename, O_RDONLY | O_CLOEXEC);
+            void *item = fd != -1 ? malloc(sb.st_size) : NULL;
+
+            if (item && read_all(fd, item, sb.st_size) == sb.st_size)
+               walk_cache_item(walk, item, sb.st_size);
+
+            free(item);
+            if (fd != -1)
+               close(fd);
+         }
+
+         free(filename);
+      }
+
+      if (subdir)
+         closedir(subdir);
+      free(subdir_path);
+   }
+
+   closedir(dir);
+
+   return true;
+}
+
+/* Call cb with the uncompressed data of every entry written for gpu_name to
+ * the multi-file or Mesa-DB cache in path.  This is used to train the
+ * compression dictionaries.
+ */
+bool
+disk_cache_foreach_item(const char *path, const char *gpu_name,
+                        disk_cache_item_cb cb, void *data)
+{
+   struct disk_cache_walk walk = {
+      .gpu_name = gpu_name,
+      .cb = cb,
+      .data = data,
+   };
+   struct stat sb;
+   bool ret;
+
+   /* Entries compressed with a dictionary are needed too */
+   walk.cache.path = (char *)path;
+   disk_cache_load_dicts(&walk.cache, gpu_name);
+
+   char *part0;
+   if (asprintf(&part0, "%s/part0", path) == -1)
+      return false;
+
+   if (stat(part0, &sb) == 0)
+      ret = walk_db(&walk, path);
+   else
+      ret = walk_multi_file(&walk, path);
+
+   free(part0);
+   disk_cache_destroy_dicts(&walk.cache);
+
+   return ret;
+}
+
 bool
 disk_cache_db_write_item_to_disk(struct disk_cache_put_job *dc_job)
 {
@@ -41,6 +41,20 @@
 extern "C" {
 #endif
 
+/* The cache version should be bumped whenever a change is made to the
+ * structure of cache entries or the index. This will give any 3rd party
+ * applications reading the cache entries a chance to adjust to the changes.
+ *
+ * - The cache version is checked internally when reading a cache entry. If we
+ *   ever have a mismatch we are in big trouble as this means we had a cache
+ *   collision. In case of such an event please check the skys for giant
+ *   asteroids and that the entire Mesa team hasn't been eaten by wolves.
+ *
+ * - There is no strict requirement that cache versions be backwards
+ *   compatible but effort should be taken to limit disruption where possible.
+ */
+#define CACHE_VERSION 2
+
 /* Number of bits to mask off from a cache key to get an index. */
 #define CACHE_INDEX_KEY_BITS 16
 
@@ -97,6 +111,13 @@ struct disk_cache {
    /* Don't compress cached data. This is for testing purposes only. */
    bool compression_disabled;
 
+   /* Dictionary new entries are compressed with, if any, and all the
+    * dictionaries entries can be read with, see disk_cache_load_dicts().
+    */
+   struct util_compress_dict *compress_dict;
+   struct util_compress_dict **dicts;
+   unsigned num_dicts;
+
    struct {
       bool enabled;
       unsigned hits;
@@ -105,11 +126,26 @@ struct disk_cache {
 
    /* Internal RO FOZ cache for combined use of RO and RW caches. */
    struct disk_cache *foz_ro_cache;
+
+   /* Thread queue for disk_cache_get_many() and disk_cache_prefetch(),
+    * created on first use under get_mtx.
+    */
+   struct util_queue get_queue;
+   simple_mtx_t get_mtx;
+
+   /* Items loaded by disk_cache_prefetch() which haven't been retrieved yet,
+    * keyed by cache key and protected by get_mtx.
+    */
+   struct hash_table *prefetched;
+   size_t prefetched_size;
+   unsigned num_prefetched;
 };
 
 struct cache_entry_file_data {
    uint32_t crc32;
    uint32_t uncompressed_size;
+   /* util_compress_dict_id() of the compression dictionary, 0 if none. */
+   uint32_t dict_id;
 };
 
 struct disk_cache_put_job {
@@ -177,6 +213,32 @@ void *
 disk_cache_db_load_item(struct disk_cache *cache, const cache_key key,
                         size_t *size);
 
+unsigned
+disk_cache_db_load_raw_items(struct disk_cache *cache, unsigned count,
+                             const cache_key *keys, void **items,
+                             size_t *item_sizes);
+
+void *
+disk_cache_parse_raw_item(struct disk_cache *cache, void *item,
+                          size_t item_size, size_t *size);
+
+char *
+disk_cache_get_dict_filename(void *mem_ctx, const char *path,
+                             const char *gpu_name, uint32_t dict_id);
+
+void
+disk_cache_load_dicts(struct disk_cache *cache, const char *gpu_name);
+
+void
+disk_cache_destroy_dicts(struct disk_cache *cache);
+
+typedef void (*disk_cache_item_cb)(void *data, const void *item_data,
+                                   size_t item_size);
+
+bool
+disk_cache_foreach_item(const char *path, const char *gpu_name,
+                        disk_cache_item_cb cb, void *data);
+
 bool
 disk_cache_db_write_item_to_disk(struct disk_cache_put_job *dc_job);
 
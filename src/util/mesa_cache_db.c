@@ -16,6 +16,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "crc32.h"
@@ -31,6 +32,11 @@
 #define MESA_CACHE_DB_VERSION          1
 #define MESA_CACHE_DB_MAGIC            "MESA_DB"
 
+/* Number of lockless reads after which their access times are written to the
+ * index file even if nothing else takes the DB lock.
+ */
+#define MESA_CACHE_DB_MAX_ACCESSED     256
+
 struct PACKED mesa_db_file_header {
    char magic[8];
    uint32_t version;
@@ -96,6 +102,9 @@ mesa_db_reopen_file(struct mesa_cache_db_file *db_file);
 static void
 mesa_db_close_file(struct mesa_cache_db_file *db_file);
 
+static void
+mesa_db_flush_accessed(struct mesa_cache_db *db);
+
 static int
 mesa_db_flock(FILE *file, int op)
 {
@@ -123,6 +132,8 @@ mesa_db_lock(struct mesa_cache_db *db)
    if (mesa_db_flock(db->index.file, LOCK_EX) < 0)
       goto unlock_cache;
 
+   mesa_db_flush_accessed(db);
+
    return true;
 
 unlock_cache:
@@ -275,6 +286,50 @@ mesa_db_cache_entry_valid(struct mesa_cache_db_file_entry *entry)
    return entry->size && entry->crc;
 }
 
+/* Write the last access times of the entries read by
+ * mesa_db_read_entry_lockless() to the index file, must be called with the
+ * DB lock held.
+ */
+static void
+mesa_db_flush_accessed(struct mesa_cache_db *db)
+{
+   struct mesa_index_db_hash_entry *hash_entry;
+   struct mesa_index_db_file_entry index_entry;
+
+   if (!db->accessed.size)
+      return;
+
+   /* The recorded entries are gone if the DB has been changed meanwhile */
+   if (!db->alive || mesa_db_uuid_changed(db))
+      goto out;
+
+   util_dynarray_foreach(&db->accessed, uint64_t, hash) {
+      hash_entry = _mesa_hash_table_u64_search(db->index_db, *hash);
+      if (!hash_entry)
+         continue;
+
+      if (!mesa_db_seek(db->index.file, hash_entry->index_db_file_offset) ||
+          !mesa_db_read(db->index.file, &index_entry) ||
+          !mesa_db_index_entry_valid(&index_entry) ||
+          index_entry.cache_db_file_offset != hash_entry->cache_db_file_offset)
+         break;
+
+      /* The same entry may have been read multiple times */
+      if (index_entry.last_access_time >= hash_entry->last_access_time)
+         continue;
+
+      index_entry.last_access_time = hash_entry->last_access_time;
+
+      if (!mesa_db_seek(db->index.file, hash_entry->index_db_file_offset) ||
+          !mesa_db_write(db->index.file, &index_entry))
+         break;
+   }
+
+   fflush(db->index.file);
+out:
+   util_dynarray_clear(&db->accessed);
+}
+
 static bool
 mesa_db_update_index(struct mesa_cache_db *db)
 {
@@ -685,6 +740,11 @@ cleanup:
 bool
 mesa_cache_db_open(struct mesa_cache_db *db, const char *cache_path)
 {
+   db->cache_read_fd = -1;
+   db->lockless_reads =
+      debug_get_bool_option("MESA_DISK_CACHE_DATABASE_LOCKLESS_READS", false);
+   util_dynarray_init(&db->accessed, NULL);
+
    if (!mesa_db_open_file(&db->cache, cache_path, "mesa_cache.db"))
       return false;
 
@@ -739,6 +799,15 @@ mesa_db_wipe_path(const char *cache_path)
 void
 mesa_cache_db_close(struct mesa_cache_db *db)
 {
+   /* Taking the lock writes out the pending access times */
+   if (db->accessed.size && mesa_db_lock(db))
+      mesa_db_unlock(db);
+
+   if (db->cache_read_fd >= 0)
+      close(db->cache_read_fd);
+
+   util_dynarray_fini(&db->accessed);
+
    _mesa_hash_table_u64_destroy(db->index_db);
    simple_mtx_destroy(&db->flock_mtx);
    ralloc_free(db->mem_ctx);
@@ -760,6 +829,107 @@ mesa_cache_db_file_entry_size(void)
    return sizeof(struct mesa_cache_db_file_entry);
 }
 
+static uint64_t
+mesa_db_read_uuid(int fd)
+{
+   struct mesa_db_file_header header;
+
+   if (pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+       strncmp(header.magic, MESA_CACHE_DB_MAGIC, sizeof(header.magic)) ||
+       header.version != MESA_CACHE_DB_VERSION)
+      return 0;
+
+   return header.uuid;
+}
+
+/* Read an entry that is already in the in-memory index without taking the
+ * file locks.
+ *
+ * Cache file entries are never modified in place, they are only appended,
+ * moved by compaction or dropped by zapping the DB.  Compaction replaces the
+ * header UUID with zero before moving anything and sets a new UUID when it's
+ * done, so the UUID works as a sequence count: an entry read while the UUID
+ * stays the same is consistent, and the CRC catches anything else.
+ *
+ * This uses pread() rather than mmap, because other processes truncate the
+ * file on compaction, which would fault the mapped readers.
+ *
+ * Returns NULL whenever the locked path has to be taken instead, e.g. for
+ * entries added by other processes since the index was last updated.
+ */
+static void *
+mesa_db_read_entry_lockless(struct mesa_cache_db *db,
+                            const uint8_t *cache_key_160bit,
+                            size_t *size)
+{
+   uint64_t hash = to_mesa_cache_db_hash(cache_key_160bit);
+   struct mesa_cache_db_file_entry cache_entry;
+   struct mesa_index_db_hash_entry *hash_entry;
+   bool flush = false;
+   void *data = NULL;
+
+   /* Only protects the index against the other threads */
+   simple_mtx_lock(&db->flock_mtx);
+
+   if (!db->alive)
+      goto out;
+
+   hash_entry = _mesa_hash_table_u64_search(db->index_db, hash);
+   if (!hash_entry)
+      goto out;
+
+   if (db->cache_read_fd < 0) {
+      db->cache_read_fd = open(db->cache.path, O_RDONLY | O_CLOEXEC);
+      if (db->cache_read_fd < 0)
+         goto out;
+   }
+
+   if (mesa_db_read_uuid(db->cache_read_fd) != db->uuid) {
+      /* The file may have been replaced rather than compacted */
+      close(db->cache_read_fd);
+      db->cache_read_fd = -1;
+      goto out;
+   }
+
+   data = malloc(hash_entry->size);
+   if (!data)
+      goto out;
+
+   struct iovec iov[2] = {
+      { .iov_base = &cache_entry, .iov_len = sizeof(cache_entry) },
+      { .iov_base = data, .iov_len = hash_entry->size },
+   };
+
+   if (preadv(db->cache_read_fd, iov, ARRAY_SIZE(iov),
+              hash_entry->cache_db_file_offset) !=
+          blob_file_size(hash_entry->size) ||
+       !mesa_db_cache_entry_valid(&cache_entry) ||
+       cache_entry.size != hash_entry->size ||
+       memcmp(cache_entry.key, cache_key_160bit, sizeof(cache_entry.key)) ||
+       util_hash_crc32(data, cache_entry.size) != cache_entry.crc ||
+       mesa_db_read_uuid(db->cache_read_fd) != db->uuid) {
+      free(data);
+      data = NULL;
+      goto out;
+   }
+
+   hash_entry->last_access_time = os_time_get_nano();
+   util_dynarray_append(&db->accessed, hash);
+   flush = util_dynarray_num_elements(&db->accessed, uint64_t) >=
+           MESA_CACHE_DB_MAX_ACCESSED;
+
+   *size = cache_entry.size;
+
+out:
+   simple_mtx_unlock(&db->flock_mtx);
+
+   /* Taking the lock writes out the access times */
+   if (flush && mesa_db_lock(db))
+      mesa_db_unlock(db);
+
+   return data;
+}
+
 void *
 mesa_cache_db_read_entry(struct mesa_cache_db *db,
                          const uint8_t *cache_key_160bit,
@@ -771,6 +941,12 @@ mesa_cache_db_read_entry(struct mesa_cache_db *db,
    struct mesa_index_db_hash_entry *hash_entry;
    void *data = NULL;
 
+   if (db->lockless_reads) {
+      data = mesa_db_read_entry_lockless(db, cache_key_160bit, size);
+      if (data)
+         return data;
+   }
+
    if (!mesa_db_lock(db))
       return NULL;
 
@@ -835,6 +1011,231 @@ fail:
    return NULL;
 }
 
+struct mesa_db_batch_entry {
+   struct mesa_index_db_hash_entry *hash_entry;
+   unsigned idx;
+};
+
+static int
+batch_entry_sort_offset(const void *_a, const void *_b)
+{
+   const struct mesa_db_batch_entry *a = _a;
+   const struct mesa_db_batch_entry *b = _b;
+
+   /* The same key may be requested more than once */
+   if (a->hash_entry->cache_db_file_offset !=
+       b->hash_entry->cache_db_file_offset)
+      return a->hash_entry->cache_db_file_offset >
+             b->hash_entry->cache_db_file_offset ? 1 : -1;
+
+   return a->idx > b->idx ? 1 : (a->idx < b->idx ? -1 : 0);
+}
+
+/**
+ * Look up \p count entries at once.
+ *
+ * Same as calling mesa_cache_db_read_entry() for each key, but the DB is
+ * locked and its index refreshed only once, and the entries are read in
+ * file order.  Missing entries are returned as NULL.
+ *
+ * \return the number of entries found.
+ */
+unsigned
+mesa_cache_db_read_entries(struct mesa_cache_db *db, unsigned count,
+                           const uint8_t *const *cache_keys_160bit,
+                           void **data, size_t *sizes)
+{
+   struct mesa_db_batch_entry *batch;
+   unsigned num_batch = 0, found = 0;
+
+   memset(data, 0, count * sizeof(*data));
+   memset(sizes, 0, count * sizeof(*sizes));
+
+   if (db->lockless_reads) {
+      for (unsigned i = 0; i < count; i++) {
+         data[i] = mesa_db_read_entry_lockless(db, cache_keys_160bit[i],
+                                               &sizes[i]);
+         if (data[i])
+            found++;
+      }
+
+      if (found == count)
+         return found;
+   }
+
+   batch = malloc(count * sizeof(*batch));
+   if (!batch)
+      return found;
+
+   if (!mesa_db_lock(db)) {
+      free(batch);
+      return found;
+   }
+
+   if (!db->alive)
+      goto out;
+
+   if (mesa_db_uuid_changed(db) && !mesa_db_reload(db))
+      goto fail_fatal;
+
+   if (!mesa_db_update_index(db))
+      goto fail_fatal;
+
+   for (unsigned i = 0; i < count; i++) {
+      if (data[i])
+         continue;
+
+      uint64_t hash = to_mesa_cache_db_hash(cache_keys_160bit[i]);
+      struct mesa_index_db_hash_entry *hash_entry =
+         _mesa_hash_table_u64_search(db->index_db, hash);
+
+      if (hash_entry) {
+         batch[num_batch].hash_entry = hash_entry;
+         batch[num_batch].idx = i;
+         num_batch++;
+      }
+   }
+
+   /* Turn the random lookups into one forward pass over the cache file. */
+   qsort(batch, num_batch, sizeof(*batch), batch_entry_sort_offset);
+
+   uint64_t now = os_time_get_nano();
+
+   for (unsigned i = 0; i < num_batch; i++) {
+      struct mesa_index_db_hash_entry *hash_entry = batch[i].hash_entry;
+      const unsigned idx = batch[i].idx;
+      struct mesa_cache_db_file_entry cache_entry;
+      struct mesa_index_db_file_entry index_entry;
+
+      if (!mesa_db_seek(db->cache.file, hash_entry->cache_db_file_offset) ||
+          !mesa_db_read(db->cache.file, &cache_entry) ||
+          !mesa_db_cache_entry_valid(&cache_entry))
+         goto fail_fatal;
+
+      if (memcmp(cache_entry.key, cache_keys_160bit[idx],
+                 sizeof(cache_entry.key)))
+         continue;
+
+      data[idx] = malloc(cache_entry.size);
+      if (!data[idx])
+         continue;
+
+      if (!mesa_db_read_data(db->cache.file, data[idx], cache_entry.size) ||
+          util_hash_crc32(data[idx], cache_entry.size) != cache_entry.crc)
+         goto fail_fatal;
+
+      if (!mesa_db_seek(db->index.file, hash_entry->index_db_file_offset) ||
+          !mesa_db_read(db->index.file, &index_entry) ||
+          !mesa_db_index_entry_valid(&index_entry) ||
+          index_entry.cache_db_file_offset != hash_entry->cache_db_file_offset ||
+          index_entry.size != hash_entry->size)
+         goto fail_fatal;
+
+      index_entry.last_access_time = now;
+      hash_entry->last_access_time = now;
+
+      if (!mesa_db_seek(db->index.file, hash_entry->index_db_file_offset) ||
+          !mesa_db_write(db->index.file, &index_entry))
+         goto fail_fatal;
+
+      sizes[idx] = cache_entry.size;
+      found++;
+   }
+
+   fflush(db->index.file);
+
+out:
+   mesa_db_unlock(db);
+   free(batch);
+
+   return found;
+
+fail_fatal:
+   mesa_db_zap(db);
+
+   for (unsigned i = 0; i < count; i++) {
+      free(data[i]);
+      data[i] = NULL;
+      sizes[i] = 0;
+   }
+   found = 0;
+
+   goto out;
+}
+
+/**
+ * Call \p cb for every entry of the DB, in file order.
+ *
+ * This is meant for tools inspecting a cache, the DB is locked for the
+ * whole walk.
+ */
+bool
+mesa_cache_db_foreach_entry(struct mesa_cache_db *db,
+                            mesa_cache_db_entry_cb cb, void *data)
+{
+   struct mesa_index_db_hash_entry **entries = NULL;
+   struct mesa_cache_db_file_entry cache_entry;
+   unsigned num_entries, i = 0;
+   void *blob = NULL;
+   bool ret = false;
+
+   if (!mesa_db_lock(db))
+      return false;
+
+   if (!db->alive)
+      goto out;
+
+   if (mesa_db_uuid_changed(db) && !mesa_db_reload(db))
+      goto out;
+
+   if (!mesa_db_update_index(db))
+      goto out;
+
+   num_entries = _mesa_hash_table_num_entries(&db->index_db->table);
+   entries = calloc(num_entries, sizeof(*entries));
+   if (num_entries && !entries)
+      goto out;
+
+   hash_table_foreach(&db->index_db->table, entry)
+      entries[i++] = entry->data;
+
+   util_qsort_r(entries, num_entries, sizeof(*entries),
+                entry_sort_offset, db);
+
+   /* entry_sort_offset() may zap the database */
+   if (!db->alive)
+      goto out;
+
+   for (i = 0; i < num_entries; i++) {
+      if (!mesa_db_seek(db->cache.file, entries[i]->cache_db_file_offset) ||
+          !mesa_db_read(db->cache.file, &cache_entry) ||
+          !mesa_db_cache_entry_valid(&cache_entry))
+         goto out;
+
+      blob = malloc(cache_entry.size);
+      if (!blob)
+         goto out;
+
+      if (!mesa_db_read_data(db->cache.file, blob, cache_entry.size))
+         goto out;
+
+      if (util_hash_crc32(blob, cache_entry.size) == cache_entry.crc)
+         cb(data, cache_entry.key, blob, cache_entry.size);
+
+      free(blob);
+      blob = NULL;
+   }
+
+   ret = true;
+
+out:
+   free(blob);
+   free(entries);
+   mesa_db_unlock(db);
+
+   return ret;
+}
+
 static bool
 mesa_cache_db_has_space_locked(struct mesa_cache_db *db, size_t blob_size)
 {
@@ -16,6 +16,7 @@
 
 #include "detect_os.h"
 #include "simple_mtx.h"
+#include "u_dynarray.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -37,8 +38,22 @@ struct mesa_cache_db {
    void *mem_ctx;
    uint64_t uuid;
    bool alive;
+
+   /* Lockless reads of already indexed entries, see
+    * mesa_db_read_entry_lockless().
+    */
+   bool lockless_reads;
+   int cache_read_fd;
+   /* Hashes of the entries read locklessly, whose last access time is
+    * written to the index file once the DB lock is taken.
+    */
+   struct util_dynarray accessed;
 };
 
+typedef void (*mesa_cache_db_entry_cb)(void *data,
+                                       const uint8_t *cache_key_160bit,
+                                       const void *blob, size_t blob_size);
+
 #if DETECT_OS_WINDOWS == 0
 bool
 mesa_cache_db_open(struct mesa_cache_db *db, const char *cache_path);
@@ -58,11 +73,20 @@ mesa_cache_db_read_entry(struct mesa_cache_db *db,
                          const uint8_t *cache_key_160bit,
                          size_t *size);
 
+unsigned
+mesa_cache_db_read_entries(struct mesa_cache_db *db, unsigned count,
+                           const uint8_t *const *cache_keys_160bit,
+                           void **data, size_t *sizes);
+
 bool
 mesa_cache_db_entry_write(struct mesa_cache_db *db,
                           const uint8_t *cache_key_160bit,
                           const void *blob, size_t blob_size);
 
+bool
+mesa_cache_db_foreach_entry(struct mesa_cache_db *db,
+                            mesa_cache_db_entry_cb cb, void *data);
+
 bool
 mesa_cache_db_entry_remove(struct mesa_cache_db *db,
                            const uint8_t *cache_key_160bit);
@@ -107,6 +131,14 @@ mesa_cache_db_read_entry(struct mesa_cache_db *db,
    return NULL;
 }
 
+static inline unsigned
+mesa_cache_db_read_entries(struct mesa_cache_db *db, unsigned count,
+                           const uint8_t *const *cache_keys_160bit,
+                           void **data, size_t *sizes)
+{
+   return 0;
+}
+
 static inline bool
 mesa_cache_db_entry_write(struct mesa_cache_db *db,
                           const uint8_t *cache_key_160bit,
@@ -115,6 +147,13 @@ mesa_cache_db_entry_write(struct mesa_cache_db *db,
    return false;
 }
 
+static inline bool
+mesa_cache_db_foreach_entry(struct mesa_cache_db *db,
+                            mesa_cache_db_entry_cb cb, void *data)
+{
+   return false;
+}
+
 static inline bool
 mesa_cache_db_entry_remove(struct mesa_cache_db *db,
                            const uint8_t *cache_key_160bit)
@@ -148,6 +148,66 @@ mesa_cache_db_multipart_read_entry(struct mesa_cache_db_multipart *db,
    return NULL;
 }
 
+unsigned
+mesa_cache_db_multipart_read_entries(struct mesa_cache_db_multipart *db,
+                                     unsigned count,
+                                     const uint8_t *const *cache_keys_160bit,
+                                     void **data, size_t *sizes)
+{
+   unsigned last_read_part = db->last_read_part;
+   unsigned found = 0, num_missing = count;
+
+   memset(data, 0, count * sizeof(*data));
+   memset(sizes, 0, count * sizeof(*sizes));
+
+   void **part_data = malloc(count * (sizeof(void *) + sizeof(size_t) +
+                                      sizeof(uint8_t *) + sizeof(unsigned)));
+   if (!part_data)
+      return 0;
+
+   size_t *part_sizes = (size_t *)(part_data + count);
+   /* Keys which haven't been found yet, compacted after each part. */
+   const uint8_t **missing_keys = (const uint8_t **)(part_sizes + count);
+   unsigned *missing_idx = (unsigned *)(missing_keys + count);
+
+   for (unsigned i = 0; i < count; i++) {
+      missing_keys[i] = cache_keys_160bit[i];
+      missing_idx[i] = i;
+   }
+
+   for (unsigned int i = 0; i < db->num_parts && num_missing; i++) {
+      unsigned int part = (last_read_part + i) % db->num_parts;
+
+      if (!mesa_cache_db_multipart_init_part(db, part))
+         break;
+
+      unsigned part_found =
+         mesa_cache_db_read_entries(db->parts[part], num_missing,
+                                    missing_keys, part_data, part_sizes);
+      if (!part_found)
+         continue;
+
+      unsigned still_missing = 0;
+      for (unsigned j = 0; j < num_missing; j++) {
+         if (part_data[j]) {
+            data[missing_idx[j]] = part_data[j];
+            sizes[missing_idx[j]] = part_sizes[j];
+         } else {
+            missing_keys[still_missing] = missing_keys[j];
+            missing_idx[still_missing++] = missing_idx[j];
+         }
+      }
+
+      found += part_found;
+      num_missing = still_missing;
+      db->last_read_part = part;
+   }
+
+   free(part_data);
+
+   return found;
+}
+
 static unsigned
 mesa_cache_db_multipart_select_victim_part(struct mesa_cache_db_multipart *db)
 {
@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "c11/threads.h"
 #include "util/list.h"
 #include "util/macros.h"
 #include "util/u_math.h"
@@ -99,14 +100,32 @@ add_child(ralloc_header *parent, ralloc_header *info)
    }
 }
 
+static bool count_allocs;
+static thread_local struct ralloc_alloc_counts alloc_counts;
+
+void
+ralloc_enable_alloc_counts(bool enable)
+{
+   count_allocs = enable;
+}
+
+void
+ralloc_get_alloc_counts(struct ralloc_alloc_counts *counts)
+{
+   *counts = alloc_counts;
+}
+
 void *
 ralloc_context(const void *ctx)
 {
    return ralloc_size(ctx, 0);
 }
 
-void *
-ralloc_size(const void *ctx, size_t size)
+/* ralloc_size() without counting the allocation, for the memory of GC
+ * contexts, which is counted as GC allocations instead.
+ */
+static void *
+alloc_block(const void *ctx, size_t size)
 {
    /* Some malloc allocation doesn't always align to 16 bytes even on 64 bits
     * system, from Android bionic/tests/malloc_test.cpp:
@@ -146,6 +165,17 @@ ralloc_size(const void *ctx, size_t size)
    return PTR_FROM_HEADER(info);
 }
 
+void *
+ralloc_size(const void *ctx, size_t size)
+{
+   void *ptr = alloc_block(ctx, size);
+
+   if (unlikely(count_allocs) && ptr)
+      alloc_counts.ralloc++;
+
+   return ptr;
+}
+
 void *
 rzalloc_size(const void *ctx, size_t size)
 {
@@ -823,7 +853,7 @@ get_slab_size(uint32_t bucket)
 static gc_slab *
 create_slab(gc_ctx *ctx, unsigned bucket)
 {
-   gc_slab *slab = ralloc_size(ctx, get_slab_size(bucket));
+   gc_slab *slab = alloc_block(ctx, get_slab_size(bucket));
    if (unlikely(!slab))
       return NULL;
 
@@ -867,7 +897,7 @@ gc_alloc_size(gc_ctx *ctx, size_t size, size_t alignment)
       gc_slab *slab = list_first_entry(&ctx->slabs[bucket].free_slabs, gc_slab, free_link);
       header = alloc_from_slab(slab, bucket);
    } else {
-      header = ralloc_size(ctx, size);
+      header = alloc_block(ctx, size);
       if (unlikely(!header))
          return NULL;
       /* Mark the header as allocated directly, so we know to actually free it. */
@@ -878,6 +908,8 @@ gc_alloc_size(gc_ctx *ctx, size_t size, size_t alignment)
 #ifndef NDEBUG
    header->canary = GC_CANARY;
 #endif
+   if (unlikely(count_allocs))
+      alloc_counts.gc++;
 
    uint8_t *ptr = (uint8_t *)header + header_size;
    if ((header_size - 1) != offsetof(gc_block_header, flags))
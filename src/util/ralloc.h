@@ -49,6 +49,7 @@
 #include <stddef.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "macros.h"
 
@@ -493,6 +494,20 @@ bool ralloc_vasprintf_append(char **str, const char *fmt, va_list args);
 size_t ralloc_total_size(const void *ptr);
 #endif
 
+/**
+ * Number of allocations made by the calling thread from ralloc contexts and
+ * from GC contexts, while counting is enabled with
+ * ralloc_enable_alloc_counts().  It is disabled by default, as it costs a
+ * branch per allocation.
+ */
+struct ralloc_alloc_counts {
+   uint64_t ralloc;
+   uint64_t gc;
+};
+
+void ralloc_enable_alloc_counts(bool enable);
+void ralloc_get_alloc_counts(struct ralloc_alloc_counts *counts);
+
 typedef struct gc_ctx gc_ctx;
 
 /**
@@ -871,29 +871,13 @@ ra_class_allocations_conflict(struct ra_class *c1, unsigned int r1,
    }
 }
 
-static struct ra_node *
-ra_find_conflicting_neighbor(struct ra_graph *g, unsigned int n, unsigned int r)
-{
-   struct ra_list *adj = &g->nodes[n].adjacency;
-   for (unsigned i = 0; i < adj->size; i++) {
-      unsigned int n2 = adj->elems[i];
-
-      /* If our adjacent node is in the stack, it's not allocated yet. */
-      if (!BITSET_TEST(g->tmp.in_stack, n2) &&
-          ra_class_allocations_conflict(g->regs->classes[g->nodes[n].class], r,
-                                        g->regs->classes[g->nodes[n2].class], g->nodes[n2].reg)) {
-         return &g->nodes[n2];
-      }
-   }
-
-   return NULL;
-}
-
 /* Computes a bitfield of what regs are available for a given register
  * selection.
  *
- * This lets drivers implement a more complicated policy than our simple first
- * or round robin policies (which don't require knowing the whole bitset)
+ * This works a word of registers at a time, which is much cheaper than
+ * checking every candidate register against all of the neighbors.  It also
+ * lets drivers implement a more complicated policy than our simple first or
+ * round robin policies.
  */
 static bool
 ra_compute_available_regs(struct ra_graph *g, unsigned int n, BITSET_WORD *regs)
@@ -915,8 +899,8 @@ ra_compute_available_regs(struct ra_graph *g, unsigned int n, BITSET_WORD *regs)
          if (c->contig_len) {
             int start = MAX2(0, (int)n2->reg - c->contig_len + 1);
             int end = MIN2(g->regs->count, n2->reg + n2c->contig_len);
-            for (unsigned i = start; i < end; i++)
-               BITSET_CLEAR(regs, i);
+            if (start < end)
+               BITSET_CLEAR_RANGE(regs, start, end - 1);
          } else {
             for (int j = 0; j < BITSET_WORDS(g->regs->count); j++)
                regs[j] &= ~g->regs->regs[n2->reg].conflicts[j];
@@ -932,6 +916,29 @@ ra_compute_available_regs(struct ra_graph *g, unsigned int n, BITSET_WORD *regs)
    return false;
 }
 
+/* Returns the first register set in regs at or after start, wrapping around
+ * at count.  There must be one.
+ */
+static unsigned int
+ra_find_available_reg(const BITSET_WORD *regs, unsigned int count,
+                      unsigned int start)
+{
+   const unsigned int words = BITSET_WORDS(count);
+   const unsigned int start_word = start / BITSET_WORDBITS;
+
+   BITSET_WORD word = regs[start_word] & ~(BITSET_BIT(start) - 1);
+   if (word)
+      return start_word * BITSET_WORDBITS + ffs(word) - 1;
+
+   for (unsigned int i = 1; i <= words; i++) {
+      unsigned int w = (start_word + i) % words;
+      if (regs[w])
+         return w * BITSET_WORDBITS + ffs(regs[w]) - 1;
+   }
+
+   UNREACHABLE("no available register");
+}
+
 /**
  * Pops nodes from the stack back into the graph, coloring them with
  * registers as they go.
@@ -942,59 +949,32 @@ ra_compute_available_regs(struct ra_graph *g, unsigned int n, BITSET_WORD *regs)
 static bool
 ra_select(struct ra_graph *g)
 {
-   int start_search_reg = 0;
-   BITSET_WORD *select_regs = NULL;
-
-   if (g->select_reg_callback)
-      select_regs = malloc(BITSET_BYTES(g->regs->count));
+   unsigned int start_search_reg = 0;
+   BITSET_WORD *select_regs = malloc(BITSET_BYTES(g->regs->count));
 
    while (g->tmp.stack_count != 0) {
-      unsigned int ri;
-      unsigned int r = -1;
+      unsigned int r;
       int n = g->tmp.stack[g->tmp.stack_count - 1];
-      struct ra_class *c = g->regs->classes[g->nodes[n].class];
 
       /* set this to false even if we return here so that
        * ra_get_best_spill_node() considers this node later.
        */
       BITSET_CLEAR(g->tmp.in_stack, n);
 
-      if (g->select_reg_callback) {
-         if (!ra_compute_available_regs(g, n, select_regs)) {
-            free(select_regs);
-            return false;
-         }
+      if (!ra_compute_available_regs(g, n, select_regs)) {
+         free(select_regs);
+         return false;
+      }
 
+      if (g->select_reg_callback) {
          r = g->select_reg_callback(n, select_regs, g->select_reg_callback_data);
          assert(r < g->regs->count);
       } else {
-         /* Find the lowest-numbered reg which is not used by a member
-          * of the graph adjacent to us.
+         /* Find the lowest-numbered reg, starting from start_search_reg,
+          * which is not used by a member of the graph adjacent to us.
           */
-         for (ri = 0; ri < g->regs->count; ri++) {
-            r = (start_search_reg + ri) % g->regs->count;
-            if (!reg_belongs_to_class(r, c))
-               continue;
-
-            struct ra_node *conflicting = ra_find_conflicting_neighbor(g, n, r);
-            if (!conflicting) {
-               /* Found a reg! */
-               break;
-            }
-            if (g->regs->classes[conflicting->class]->contig_len) {
-               /* Skip to point at the last base reg of the conflicting reg
-                * allocation -- the loop will increment us to check the next reg
-                * after the conflicting allocaiton.
-                */
-               unsigned conflicting_end = (conflicting->reg +
-                                           g->regs->classes[conflicting->class]->contig_len - 1);
-               assert(conflicting_end >= r);
-               ri += conflicting_end - r;
-            }
-         }
-
-         if (ri >= g->regs->count)
-            return false;
+         r = ra_find_available_reg(select_regs, g->regs->count,
+                                   start_search_reg % g->regs->count);
       }
 
       g->nodes[n].reg = r;
@@ -1057,23 +1037,18 @@ ra_set_node_reg(struct ra_graph *g, unsigned int n, unsigned int reg)
 static float
 ra_get_spill_benefit(struct ra_graph *g, unsigned int n)
 {
-   float benefit = 0;
-   int n_class = g->nodes[n].class;
+   struct ra_class *c = g->regs->classes[g->nodes[n].class];
 
    /* Define the benefit of eliminating an interference between n, n2
     * through spilling as q(C, B) / p(C).  This is similar to the
     * "count number of edges" approach of traditional graph coloring,
     * but takes classes into account.
+    *
+    * The sum over all of the neighbors is the q_total we keep up to date as
+    * interferences are added and removed, so this doesn't need to walk the
+    * adjacency list.
     */
-   struct ra_list *adj = &g->nodes[n].adjacency;
-   for (unsigned i = 0; i < adj->size; i++) {
-      unsigned int n2 = adj->elems[i];
-      unsigned int n2_class = g->nodes[n2].class;
-      benefit += ((float)g->regs->classes[n_class]->q[n2_class] /
-                  g->regs->classes[n_class]->p);
-   }
-
-   return benefit;
+   return (float)g->nodes[n].q_total / c->p;
 }
 
 float
@@ -183,6 +183,16 @@ u_sparse_bitset_test(struct u_sparse_bitset *s, unsigned bit)
    }
 }
 
+/* Clearing bits can leave nodes with no bit set behind, skip them. */
+static inline struct rb_node *
+_u_sparse_bitset_skip_empty(struct rb_node *iter)
+{
+   while (iter &&
+          BITSET_IS_EMPTY(to_u_sparse_bitset_node(iter)->vals))
+      iter = rb_node_next(iter);
+   return iter;
+}
+
 static inline int
 u_sparse_bitset_cmp(struct u_sparse_bitset *a, struct u_sparse_bitset *b)
 {
@@ -192,8 +202,8 @@ u_sparse_bitset_cmp(struct u_sparse_bitset *a, struct u_sparse_bitset *b)
       return memcmp(a->vals, b->vals, BITSET_BYTES(a->capacity));
    }
 
-   struct rb_node *a_iter = rb_tree_first(&a->tree);
-   struct rb_node *b_iter = rb_tree_first(&b->tree);
+   struct rb_node *a_iter = _u_sparse_bitset_skip_empty(rb_tree_first(&a->tree));
+   struct rb_node *b_iter = _u_sparse_bitset_skip_empty(rb_tree_first(&b->tree));
 
    while (a_iter && b_iter) {
       struct u_sparse_bitset_node *node_a = to_u_sparse_bitset_node(a_iter);
@@ -207,8 +217,8 @@ u_sparse_bitset_cmp(struct u_sparse_bitset *a, struct u_sparse_bitset *b)
       if (cmp_res)
          return cmp_res;
 
-      a_iter = rb_node_next(a_iter);
-      b_iter = rb_node_next(b_iter);
+      a_iter = _u_sparse_bitset_skip_empty(rb_node_next(a_iter));
+      b_iter = _u_sparse_bitset_skip_empty(rb_node_next(b_iter));
    }
 
    return (a_iter != NULL) - (b_iter != NULL);
@@ -0,0 +1,818 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * Swiss-table style hash table and set, see swiss_table.h.
+ *
+ * The table has a power of two number of slots, split into groups of
+ * SWISS_GROUP_SIZE.  Each slot has a control byte which is either
+ * SWISS_CTRL_EMPTY, SWISS_CTRL_DELETED, or the top 7 bits of the (mixed)
+ * hash of the entry it holds.  The rest of the hash picks the first group to
+ * probe, and groups are then probed in triangular order, which visits all of
+ * them.  A search stops at the first group with an empty slot.
+ *
+ * At most 7/8 of the slots are used or deleted, so there always is such a
+ * group.
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include "swiss_table.h"
+#include "bitscan.h"
+#include "detect_arch.h"
+#include "macros.h"
+#include "ralloc.h"
+
+#if DETECT_ARCH_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SWISS_NEON 1
+#endif
+
+#define SWISS_GROUP_SIZE 16
+#define SWISS_CTRL_EMPTY 0x80
+#define SWISS_CTRL_DELETED 0xfe
+
+/* Bitmask of the slots of a group matching some condition.  Each slot gets
+ * 1 << SWISS_MASK_STRIDE_SHIFT bits, of which only the top one may be set.
+ */
+typedef uint64_t swiss_mask;
+
+#if DETECT_ARCH_SSE
+
+#define SWISS_MASK_STRIDE_SHIFT 0
+
+static inline swiss_mask
+swiss_group_match(const uint8_t *group, uint8_t h2)
+{
+   __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+   return (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(h2)));
+}
+
+static inline swiss_mask
+swiss_group_match_empty(const uint8_t *group)
+{
+   return swiss_group_match(group, SWISS_CTRL_EMPTY);
+}
+
+static inline swiss_mask
+swiss_group_match_empty_or_deleted(const uint8_t *group)
+{
+   __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+   return (uint16_t)_mm_movemask_epi8(ctrl);
+}
+
+static inline swiss_mask
+swiss_group_match_full(const uint8_t *group)
+{
+   return swiss_group_match_empty_or_deleted(group) ^ 0xffff;
+}
+
+#elif SWISS_NEON
+
+/* There's no movemask, narrowing the comparison result gives 4 bits per
+ * slot instead.
+ */
+#define SWISS_MASK_STRIDE_SHIFT 2
+
+static inline swiss_mask
+swiss_neon_mask(uint8x16_t cmp)
+{
+   uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+   return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0) &
+          0x8888888888888888ull;
+}
+
+static inline swiss_mask
+swiss_group_match(const uint8_t *group, uint8_t h2)
+{
+   return swiss_neon_mask(vceqq_u8(vld1q_u8(group), vdupq_n_u8(h2)));
+}
+
+static inline swiss_mask
+swiss_group_match_empty(const uint8_t *group)
+{
+   return swiss_group_match(group, SWISS_CTRL_EMPTY);
+}
+
+static inline swiss_mask
+swiss_group_match_empty_or_deleted(const uint8_t *group)
+{
+   return swiss_neon_mask(vtstq_u8(vld1q_u8(group), vdupq_n_u8(0x80)));
+}
+
+static inline swiss_mask
+swiss_group_match_full(const uint8_t *group)
+{
+   return swiss_group_match_empty_or_deleted(group) ^ 0x8888888888888888ull;
+}
+
+#else
+
+#define SWISS_MASK_STRIDE_SHIFT 0
+
+static inline swiss_mask
+swiss_group_match(const uint8_t *group, uint8_t h2)
+{
+   swiss_mask mask = 0;
+   for (unsigned i = 0; i < SWISS_GROUP_SIZE; i++)
+      mask |= (swiss_mask)(group[i] == h2) << i;
+   return mask;
+}
+
+static inline swiss_mask
+swiss_group_match_empty(const uint8_t *group)
+{
+   return swiss_group_match(group, SWISS_CTRL_EMPTY);
+}
+
+static inline swiss_mask
+swiss_group_match_empty_or_deleted(const uint8_t *group)
+{
+   swiss_mask mask = 0;
+   for (unsigned i = 0; i < SWISS_GROUP_SIZE; i++)
+      mask |= (swiss_mask)(group[i] >> 7) << i;
+   return mask;
+}
+
+static inline swiss_mask
+swiss_group_match_full(const uint8_t *group)
+{
+   return swiss_group_match_empty_or_deleted(group) ^ 0xffff;
+}
+
+#endif
+
+/* Returns the index in the group of the first matching slot, and removes it
+ * from the mask.
+ */
+static inline unsigned
+swiss_mask_next(swiss_mask *mask)
+{
+   return u_bit_scan64(mask) >> SWISS_MASK_STRIDE_SHIFT;
+}
+
+/* Removes the slots before the given index in the group from the mask. */
+static inline swiss_mask
+swiss_mask_from(swiss_mask mask, unsigned index)
+{
+   return mask & (~0ull << (index << SWISS_MASK_STRIDE_SHIFT));
+}
+
+/* User hashes like _mesa_hash_pointer() aren't well distributed enough to be
+ * split into a position and control bits as they are.
+ */
+static inline uint64_t
+swiss_mix(uint32_t hash)
+{
+   return hash * 0x9e3779b97f4a7c15ull;
+}
+
+static inline uint8_t
+swiss_h2(uint64_t mixed)
+{
+   return mixed >> 57;
+}
+
+struct swiss_probe {
+   uint32_t group;
+   uint32_t stride;
+   uint32_t mask;
+};
+
+static inline struct swiss_probe
+swiss_probe_start(const struct swiss_storage *s, uint64_t mixed)
+{
+   uint32_t mask = s->size / SWISS_GROUP_SIZE - 1;
+
+   return (struct swiss_probe) {
+      .group = (uint32_t)(mixed >> 32) & mask,
+      .stride = 0,
+      .mask = mask,
+   };
+}
+
+static inline void
+swiss_probe_next(struct swiss_probe *probe)
+{
+   probe->group = (probe->group + ++probe->stride) & probe->mask;
+}
+
+static inline uint32_t
+swiss_probe_slot(const struct swiss_probe *probe)
+{
+   return probe->group * SWISS_GROUP_SIZE;
+}
+
+/* The helpers below are shared by the table and the set, and inlined into
+ * each of them so that the entry layout is known at compile time.
+ */
+static_assert(offsetof(struct hash_entry, hash) == 0, "");
+static_assert(offsetof(struct set_entry, hash) == 0, "");
+
+static ALWAYS_INLINE void *
+swiss_slot(const struct swiss_storage *s, uint32_t index, size_t entry_size)
+{
+   return (char *)s->slots + (size_t)index * entry_size;
+}
+
+static ALWAYS_INLINE uint32_t
+swiss_slot_index(const struct swiss_storage *s, const void *entry,
+                 size_t entry_size)
+{
+   return ((const char *)entry - (const char *)s->slots) / entry_size;
+}
+
+static ALWAYS_INLINE const void *
+swiss_slot_key(void *entry, size_t key_offset)
+{
+   return *(const void **)((char *)entry + key_offset);
+}
+
+static void
+swiss_init(struct swiss_storage *s, void *mem_ctx,
+           uint32_t (*key_hash_function)(const void *key),
+           bool (*key_equals_function)(const void *a, const void *b))
+{
+   /* Nothing is allocated until the first insertion. */
+   memset(s, 0, sizeof(*s));
+   s->mem_ctx = mem_ctx;
+   s->key_hash_function = key_hash_function;
+   s->key_equals_function = key_equals_function;
+}
+
+static ALWAYS_INLINE void *
+swiss_search(const struct swiss_storage *s, uint32_t hash, const void *key,
+             size_t entry_size, size_t key_offset)
+{
+   if (!s->entries)
+      return NULL;
+
+   uint64_t mixed = swiss_mix(hash);
+   uint8_t h2 = swiss_h2(mixed);
+   struct swiss_probe probe = swiss_probe_start(s, mixed);
+
+   while (true) {
+      const uint8_t *group = s->ctrl + swiss_probe_slot(&probe);
+      swiss_mask match = swiss_group_match(group, h2);
+
+      while (match) {
+         uint32_t index = swiss_probe_slot(&probe) + swiss_mask_next(&match);
+         void *entry = swiss_slot(s, index, entry_size);
+
+         if (*(uint32_t *)entry == hash &&
+             s->key_equals_function(key, swiss_slot_key(entry, key_offset)))
+            return entry;
+      }
+
+      if (likely(swiss_group_match_empty(group)))
+         return NULL;
+
+      swiss_probe_next(&probe);
+   }
+}
+
+/* Finds a free slot for an entry known not to be in the table yet. */
+static ALWAYS_INLINE uint32_t
+swiss_find_free_slot(const struct swiss_storage *s, uint64_t mixed)
+{
+   struct swiss_probe probe = swiss_probe_start(s, mixed);
+
+   while (true) {
+      swiss_mask free_slots =
+         swiss_group_match_empty_or_deleted(s->ctrl + swiss_probe_slot(&probe));
+      if (free_slots)
+         return swiss_probe_slot(&probe) + swiss_mask_next(&free_slots);
+
+      swiss_probe_next(&probe);
+   }
+}
+
+static bool
+swiss_resize(struct swiss_storage *s, uint32_t new_size, size_t entry_size)
+{
+   /* The control bytes and the slots share a single allocation. */
+   uint8_t *ctrl = ralloc_size(s->mem_ctx, new_size + new_size * entry_size);
+   if (!ctrl)
+      return false;
+
+   memset(ctrl, SWISS_CTRL_EMPTY, new_size);
+
+   struct swiss_storage old = *s;
+   s->ctrl = ctrl;
+   s->slots = ctrl + new_size;
+   s->size = new_size;
+   s->max_entries = new_size - new_size / 8;
+   s->deleted_entries = 0;
+
+   for (uint32_t i = 0; i < old.size; i += SWISS_GROUP_SIZE) {
+      swiss_mask full = swiss_group_match_full(old.ctrl + i);
+
+      while (full) {
+         void *old_entry = swiss_slot(&old, i + swiss_mask_next(&full),
+                                      entry_size);
+         uint64_t mixed = swiss_mix(*(uint32_t *)old_entry);
+         uint32_t index = swiss_find_free_slot(s, mixed);
+
+         ctrl[index] = swiss_h2(mixed);
+         memcpy(swiss_slot(s, index, entry_size), old_entry, entry_size);
+      }
+   }
+
+   ralloc_free(old.ctrl);
+
+   return true;
+}
+
+static bool
+swiss_reserve(struct swiss_storage *s, uint32_t entries, size_t entry_size)
+{
+   uint32_t size = MAX2(s->size, SWISS_GROUP_SIZE);
+
+   while (size - size / 8 < entries) {
+      if (size > UINT32_MAX / 2)
+         return false;
+      size *= 2;
+   }
+
+   if (size == s->size)
+      return true;
+
+   return swiss_resize(s, size, entry_size);
+}
+
+/* Returns the entry of the key if it's already present, and otherwise
+ * claims a slot for it, only filling its hash.
+ */
+static ALWAYS_INLINE void *
+swiss_search_or_add(struct swiss_storage *s, uint32_t hash, const void *key,
+                    bool *found, size_t entry_size, size_t key_offset)
+{
+   if (unlikely(s->entries + s->deleted_entries >= s->max_entries)) {
+      /* Clean up deleted entries in place unless the table is getting
+       * full.
+       */
+      uint32_t new_size = s->size;
+      if (!new_size) {
+         new_size = SWISS_GROUP_SIZE;
+      } else if (s->entries >= s->max_entries / 2) {
+         if (new_size > UINT32_MAX / 2)
+            return NULL;
+         new_size *= 2;
+      }
+
+      if (!swiss_resize(s, new_size, entry_size))
+         return NULL;
+   }
+
+   uint64_t mixed = swiss_mix(hash);
+   uint8_t h2 = swiss_h2(mixed);
+   struct swiss_probe probe = swiss_probe_start(s, mixed);
+   uint32_t available = UINT32_MAX;
+
+   while (true) {
+      const uint8_t *group = s->ctrl + swiss_probe_slot(&probe);
+      swiss_mask match = swiss_group_match(group, h2);
+
+      while (match) {
+         uint32_t index = swiss_probe_slot(&probe) + swiss_mask_next(&match);
+         void *entry = swiss_slot(s, index, entry_size);
+
+         if (*(uint32_t *)entry == hash &&
+             s->key_equals_function(key, swiss_slot_key(entry, key_offset))) {
+            *found = true;
+            return entry;
+         }
+      }
+
+      /* Stash the first available slot we find */
+      if (available == UINT32_MAX) {
+         swiss_mask free_slots = swiss_group_match_empty_or_deleted(group);
+         if (free_slots)
+            available = swiss_probe_slot(&probe) + swiss_mask_next(&free_slots);
+      }
+
+      if (likely(swiss_group_match_empty(group)))
+         break;
+
+      swiss_probe_next(&probe);
+   }
+
+   if (s->ctrl[available] == SWISS_CTRL_DELETED)
+      s->deleted_entries--;
+   s->ctrl[available] = h2;
+   s->entries++;
+
+   void *entry = swiss_slot(s, available, entry_size);
+   *(uint32_t *)entry = hash;
+   *found = false;
+
+   return entry;
+}
+
+static ALWAYS_INLINE void
+swiss_remove(struct swiss_storage *s, void *entry, size_t entry_size)
+{
+   uint32_t index = swiss_slot_index(s, entry, entry_size);
+   uint32_t group = index & ~(SWISS_GROUP_SIZE - 1);
+
+   /* Searches stop at a group with an empty slot, so no entry has been
+    * placed past such a group and the slot can be made empty again.
+    */
+   if (swiss_group_match_empty(s->ctrl + group)) {
+      s->ctrl[index] = SWISS_CTRL_EMPTY;
+   } else {
+      s->ctrl[index] = SWISS_CTRL_DELETED;
+      s->deleted_entries++;
+   }
+   s->entries--;
+}
+
+static ALWAYS_INLINE void *
+swiss_next_entry(const struct swiss_storage *s, void *entry,
+                 size_t entry_size)
+{
+   uint32_t start = entry ? swiss_slot_index(s, entry, entry_size) + 1 : 0;
+   uint32_t group = start & ~(SWISS_GROUP_SIZE - 1);
+
+   /* The table is usually dense enough for the next entry to be close. */
+   for (uint32_t i = start; i < MIN2(start + 4, s->size); i++) {
+      if (s->ctrl[i] < SWISS_CTRL_EMPTY)
+         return swiss_slot(s, i, entry_size);
+   }
+
+   for (; group < s->size; group += SWISS_GROUP_SIZE) {
+      swiss_mask full = swiss_group_match_full(s->ctrl + group);
+
+      if (group < start)
+         full = swiss_mask_from(full, start - group);
+
+      if (full)
+         return swiss_slot(s, group + swiss_mask_next(&full), entry_size);
+   }
+
+   return NULL;
+}
+
+static void
+swiss_clear(struct swiss_storage *s)
+{
+   if (s->ctrl)
+      memset(s->ctrl, SWISS_CTRL_EMPTY, s->size);
+   s->entries = 0;
+   s->deleted_entries = 0;
+}
+
+static void
+swiss_fini(struct swiss_storage *s)
+{
+   ralloc_free(s->ctrl);
+   s->ctrl = NULL;
+   s->slots = NULL;
+   s->size = 0;
+   s->max_entries = 0;
+   s->entries = 0;
+   s->deleted_entries = 0;
+}
+
+#define TABLE_ENTRY sizeof(struct hash_entry), offsetof(struct hash_entry, key)
+#define SET_ENTRY sizeof(struct set_entry), offsetof(struct set_entry, key)
+
+void
+_mesa_swiss_table_init(struct swiss_table *ht, void *mem_ctx,
+                       uint32_t (*key_hash_function)(const void *key),
+                       bool (*key_equals_function)(const void *a,
+                                                   const void *b))
+{
+   swiss_init(&ht->storage, mem_ctx, key_hash_function, key_equals_function);
+}
+
+/**
+ * Deallocates the entries.  Like for _mesa_hash_table_fini(), this is
+ * optional when delete_function isn't needed and mem_ctx is non-NULL.
+ */
+void
+_mesa_swiss_table_fini(struct swiss_table *ht,
+                       void (*delete_function)(struct hash_entry *entry))
+{
+   if (delete_function) {
+      swiss_table_foreach(ht, entry)
+         delete_function(entry);
+   }
+
+   swiss_fini(&ht->storage);
+}
+
+struct swiss_table *
+_mesa_swiss_table_create(void *mem_ctx,
+                         uint32_t (*key_hash_function)(const void *key),
+                         bool (*key_equals_function)(const void *a,
+                                                     const void *b))
+{
+   struct swiss_table *ht = ralloc(mem_ctx, struct swiss_table);
+   if (ht == NULL)
+      return NULL;
+
+   _mesa_swiss_table_init(ht, ht, key_hash_function, key_equals_function);
+   return ht;
+}
+
+struct swiss_table *
+_mesa_pointer_swiss_table_create(void *mem_ctx)
+{
+   return _mesa_swiss_table_create(mem_ctx, _mesa_hash_pointer,
+                                   _mesa_key_pointer_equal);
+}
+
+void
+_mesa_swiss_table_destroy(struct swiss_table *ht,
+                          void (*delete_function)(struct hash_entry *entry))
+{
+   if (!ht)
+      return;
+
+   _mesa_swiss_table_fini(ht, delete_function);
+   ralloc_free(ht);
+}
+
+void
+_mesa_swiss_table_clear(struct swiss_table *ht,
+                        void (*delete_function)(struct hash_entry *entry))
+{
+   if (!ht)
+      return;
+
+   if (delete_function) {
+      swiss_table_foreach(ht, entry)
+         delete_function(entry);
+   }
+
+   swiss_clear(&ht->storage);
+}
+
+bool
+_mesa_swiss_table_reserve(struct swiss_table *ht, unsigned size)
+{
+   return swiss_reserve(&ht->storage, size, sizeof(struct hash_entry));
+}
+
+static struct hash_entry *
+swiss_table_insert(struct swiss_table *ht, uint32_t hash, const void *key,
+                   void *data)
+{
+   bool found;
+   struct hash_entry *entry =
+      swiss_search_or_add(&ht->storage, hash, key, &found, TABLE_ENTRY);
+
+   /* Like _mesa_hash_table_insert(), this replaces the key and data of an
+    * existing entry.
+    */
+   if (entry) {
+      entry->key = key;
+      entry->data = data;
+      entry->present = true;
+      entry->deleted = false;
+   }
+
+   return entry;
+}
+
+struct hash_entry *
+_mesa_swiss_table_insert(struct swiss_table *ht, const void *key, void *data)
+{
+   assert(ht->storage.key_hash_function);
+   return swiss_table_insert(ht, ht->storage.key_hash_function(key), key,
+                             data);
+}
+
+struct hash_entry *
+_mesa_swiss_table_insert_pre_hashed(struct swiss_table *ht, uint32_t hash,
+                                    const void *key, void *data)
+{
+   assert(ht->storage.key_hash_function == NULL ||
+          hash == ht->storage.key_hash_function(key));
+   return swiss_table_insert(ht, hash, key, data);
+}
+
+struct hash_entry *
+_mesa_swiss_table_search(const struct swiss_table *ht, const void *key)
+{
+   assert(ht->storage.key_hash_function);
+   return swiss_search(&ht->storage, ht->storage.key_hash_function(key), key,
+                       TABLE_ENTRY);
+}
+
+struct hash_entry *
+_mesa_swiss_table_search_pre_hashed(const struct swiss_table *ht,
+                                    uint32_t hash, const void *key)
+{
+   assert(ht->storage.key_hash_function == NULL ||
+          hash == ht->storage.key_hash_function(key));
+   return swiss_search(&ht->storage, hash, key, TABLE_ENTRY);
+}
+
+void
+_mesa_swiss_table_remove(struct swiss_table *ht, struct hash_entry *entry)
+{
+   if (!entry)
+      return;
+
+   entry->present = false;
+   entry->deleted = true;
+   swiss_remove(&ht->storage, entry, sizeof(struct hash_entry));
+}
+
+void
+_mesa_swiss_table_remove_key(struct swiss_table *ht, const void *key)
+{
+   _mesa_swiss_table_remove(ht, _mesa_swiss_table_search(ht, key));
+}
+
+/**
+ * Iterator over the table, pass in NULL for the first entry.  Iteration is
+ * O(table_size), but empty slots are skipped a group at a time.
+ */
+struct hash_entry *
+_mesa_swiss_table_next_entry(const struct swiss_table *ht,
+                             struct hash_entry *entry)
+{
+   return swiss_next_entry(&ht->storage, entry, sizeof(struct hash_entry));
+}
+
+void
+_mesa_swiss_set_init(struct swiss_set *set, void *mem_ctx,
+                     uint32_t (*key_hash_function)(const void *key),
+                     bool (*key_equals_function)(const void *a,
+                                                 const void *b))
+{
+   swiss_init(&set->storage, mem_ctx, key_hash_function, key_equals_function);
+}
+
+void
+_mesa_swiss_set_fini(struct swiss_set *set,
+                     void (*delete_function)(struct set_entry *entry))
+{
+   if (delete_function) {
+      swiss_set_foreach(set, entry)
+         delete_function(entry);
+   }
+
+   swiss_fini(&set->storage);
+}
+
+struct swiss_set *
+_mesa_swiss_set_create(void *mem_ctx,
+                       uint32_t (*key_hash_function)(const void *key),
+                       bool (*key_equals_function)(const void *a,
+                                                   const void *b))
+{
+   struct swiss_set *set = ralloc(mem_ctx, struct swiss_set);
+   if (set == NULL)
+      return NULL;
+
+   _mesa_swiss_set_init(set, set, key_hash_function, key_equals_function);
+   return set;
+}
+
+struct swiss_set *
+_mesa_pointer_swiss_set_create(void *mem_ctx)
+{
+   return _mesa_swiss_set_create(mem_ctx, _mesa_hash_pointer,
+                                 _mesa_key_pointer_equal);
+}
+
+void
+_mesa_swiss_set_destroy(struct swiss_set *set,
+                        void (*delete_function)(struct set_entry *entry))
+{
+   if (!set)
+      return;
+
+   _mesa_swiss_set_fini(set, delete_function);
+   ralloc_free(set);
+}
+
+void
+_mesa_swiss_set_clear(struct swiss_set *set,
+                      void (*delete_function)(struct set_entry *entry))
+{
+   if (!set)
+      return;
+
+   if (delete_function) {
+      swiss_set_foreach(set, entry)
+         delete_function(entry);
+   }
+
+   swiss_clear(&set->storage);
+}
+
+bool
+_mesa_swiss_set_reserve(struct swiss_set *set, unsigned size)
+{
+   return swiss_reserve(&set->storage, size, sizeof(struct set_entry));
+}
+
+static struct set_entry *
+swiss_set_search_or_add(struct swiss_set *set, uint32_t hash, const void *key,
+                        bool *found)
+{
+   bool _found = false;
+   struct set_entry *entry =
+      swiss_search_or_add(&set->storage, hash, key, &_found, SET_ENTRY);
+
+   if (entry && !_found)
+      entry->key = key;
+   if (found)
+      *found = _found;
+
+   return entry;
+}
+
+static struct set_entry *
+swiss_set_add(struct swiss_set *set, uint32_t hash, const void *key)
+{
+   struct set_entry *entry = swiss_set_search_or_add(set, hash, key, NULL);
+
+   /* Like _mesa_set_add(), this replaces the key of an existing entry. */
+   if (entry)
+      entry->key = key;
+
+   return entry;
+}
+
+struct set_entry *
+_mesa_swiss_set_add(struct swiss_set *set, const void *key)
+{
+   assert(set->storage.key_hash_function);
+   return swiss_set_add(set, set->storage.key_hash_function(key), key);
+}
+
+struct set_entry *
+_mesa_swiss_set_add_pre_hashed(struct swiss_set *set, uint32_t hash,
+                               const void *key)
+{
+   assert(set->storage.key_hash_function == NULL ||
+          hash == set->storage.key_hash_function(key));
+   return swiss_set_add(set, hash, key);
+}
+
+struct set_entry *
+_mesa_swiss_set_search_or_add(struct swiss_set *set, const void *key,
+                              bool *found)
+{
+   assert(set->storage.key_hash_function);
+   return swiss_set_search_or_add(set, set->storage.key_hash_function(key),
+                                  key, found);
+}
+
+struct set_entry *
+_mesa_swiss_set_search_or_add_pre_hashed(struct swiss_set *set, uint32_t hash,
+                                         const void *key, bool *found)
+{
+   assert(set->storage.key_hash_function == NULL ||
+          hash == set->storage.key_hash_function(key));
+   return swiss_set_search_or_add(set, hash, key, found);
+}
+
+struct set_entry *
+_mesa_swiss_set_search(const struct swiss_set *set, const void *key)
+{
+   assert(set->storage.key_hash_function);
+   return swiss_search(&set->storage, set->storage.key_hash_function(key), key,
+                       SET_ENTRY);
+}
+
+struct set_entry *
+_mesa_swiss_set_search_pre_hashed(const struct swiss_set *set, uint32_t hash,
+                                  const void *key)
+{
+   assert(set->storage.key_hash_function == NULL ||
+          hash == set->storage.key_hash_function(key));
+   return swiss_search(&set->storage, hash, key, SET_ENTRY);
+}
+
+void
+_mesa_swiss_set_remove(struct swiss_set *set, struct set_entry *entry)
+{
+   if (!entry)
+      return;
+
+   swiss_remove(&set->storage, entry, sizeof(struct set_entry));
+}
+
+void
+_mesa_swiss_set_remove_key(struct swiss_set *set, const void *key)
+{
+   _mesa_swiss_set_remove(set, _mesa_swiss_set_search(set, key));
+}
+
+struct set_entry *
+_mesa_swiss_set_next_entry(const struct swiss_set *set,
+                           struct set_entry *entry)
+{
+   return swiss_next_entry(&set->storage, entry, sizeof(struct set_entry));
+}
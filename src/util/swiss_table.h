@@ -0,0 +1,199 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * Open-addressing hash table and set probed Swiss-table style.
+ *
+ * These mirror the _mesa_hash_table_*() and _mesa_set_*() APIs and hand out
+ * the same struct hash_entry and struct set_entry, so that hot maps can be
+ * switched over without touching their users.  Besides the entries, every
+ * slot has a control byte holding 7 bits of the hash, and lookups compare
+ * the control bytes of a group of 16 slots at once (with SSE2 or NEON when
+ * available) before looking at any entry.
+ *
+ * Like the regular hash table, iteration is safe against removal but not
+ * against insertion, which may move the entries.
+ */
+
+#ifndef _SWISS_TABLE_H
+#define _SWISS_TABLE_H
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "hash_table.h"
+#include "set.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Storage shared by swiss_table and swiss_set, only differing by the type
+ * of their entries.
+ */
+struct swiss_storage {
+   void *mem_ctx;
+   uint8_t *ctrl;
+   void *slots;
+   uint32_t (*key_hash_function)(const void *key);
+   bool (*key_equals_function)(const void *a, const void *b);
+   uint32_t size;
+   uint32_t max_entries;
+   uint32_t entries;
+   uint32_t deleted_entries;
+};
+
+struct swiss_table {
+   struct swiss_storage storage;
+};
+
+struct swiss_set {
+   struct swiss_storage storage;
+};
+
+void
+_mesa_swiss_table_init(struct swiss_table *ht, void *mem_ctx,
+                       uint32_t (*key_hash_function)(const void *key),
+                       bool (*key_equals_function)(const void *a,
+                                                   const void *b));
+
+void
+_mesa_swiss_table_fini(struct swiss_table *ht,
+                       void (*delete_function)(struct hash_entry *entry));
+
+struct swiss_table *
+_mesa_swiss_table_create(void *mem_ctx,
+                         uint32_t (*key_hash_function)(const void *key),
+                         bool (*key_equals_function)(const void *a,
+                                                     const void *b));
+
+struct swiss_table *
+_mesa_pointer_swiss_table_create(void *mem_ctx);
+
+void
+_mesa_swiss_table_destroy(struct swiss_table *ht,
+                          void (*delete_function)(struct hash_entry *entry));
+
+void
+_mesa_swiss_table_clear(struct swiss_table *ht,
+                        void (*delete_function)(struct hash_entry *entry));
+
+static inline uint32_t
+_mesa_swiss_table_num_entries(const struct swiss_table *ht)
+{
+   return ht->storage.entries;
+}
+
+bool
+_mesa_swiss_table_reserve(struct swiss_table *ht, unsigned size);
+
+struct hash_entry *
+_mesa_swiss_table_insert(struct swiss_table *ht, const void *key, void *data);
+struct hash_entry *
+_mesa_swiss_table_insert_pre_hashed(struct swiss_table *ht, uint32_t hash,
+                                    const void *key, void *data);
+
+struct hash_entry *
+_mesa_swiss_table_search(const struct swiss_table *ht, const void *key);
+struct hash_entry *
+_mesa_swiss_table_search_pre_hashed(const struct swiss_table *ht,
+                                    uint32_t hash, const void *key);
+
+void
+_mesa_swiss_table_remove(struct swiss_table *ht, struct hash_entry *entry);
+void
+_mesa_swiss_table_remove_key(struct swiss_table *ht, const void *key);
+
+struct hash_entry *
+_mesa_swiss_table_next_entry(const struct swiss_table *ht,
+                             struct hash_entry *entry);
+
+/**
+ * This foreach function is safe against deletion, but not against insertion
+ * (which may rehash the table, making entry a dangling pointer).
+ */
+#define swiss_table_foreach(ht, entry)                                       \
+   for (struct hash_entry *entry = _mesa_swiss_table_next_entry(ht, NULL);   \
+        entry != NULL;                                                       \
+        entry = _mesa_swiss_table_next_entry(ht, entry))
+
+void
+_mesa_swiss_set_init(struct swiss_set *set, void *mem_ctx,
+                     uint32_t (*key_hash_function)(const void *key),
+                     bool (*key_equals_function)(const void *a,
+                                                 const void *b));
+
+void
+_mesa_swiss_set_fini(struct swiss_set *set,
+                     void (*delete_function)(struct set_entry *entry));
+
+struct swiss_set *
+_mesa_swiss_set_create(void *mem_ctx,
+                       uint32_t (*key_hash_function)(const void *key),
+                       bool (*key_equals_function)(const void *a,
+                                                   const void *b));
+
+struct swiss_set *
+_mesa_pointer_swiss_set_create(void *mem_ctx);
+
+void
+_mesa_swiss_set_destroy(struct swiss_set *set,
+                        void (*delete_function)(struct set_entry *entry));
+
+void
+_mesa_swiss_set_clear(struct swiss_set *set,
+                      void (*delete_function)(struct set_entry *entry));
+
+static inline uint32_t
+_mesa_swiss_set_num_entries(const struct swiss_set *set)
+{
+   return set->storage.entries;
+}
+
+bool
+_mesa_swiss_set_reserve(struct swiss_set *set, unsigned size);
+
+struct set_entry *
+_mesa_swiss_set_add(struct swiss_set *set, const void *key);
+struct set_entry *
+_mesa_swiss_set_add_pre_hashed(struct swiss_set *set, uint32_t hash,
+                               const void *key);
+
+struct set_entry *
+_mesa_swiss_set_search_or_add(struct swiss_set *set, const void *key,
+                              bool *found);
+struct set_entry *
+_mesa_swiss_set_search_or_add_pre_hashed(struct swiss_set *set, uint32_t hash,
+                                         const void *key, bool *found);
+
+struct set_entry *
+_mesa_swiss_set_search(const struct swiss_set *set, const void *key);
+struct set_entry *
+_mesa_swiss_set_search_pre_hashed(const struct swiss_set *set, uint32_t hash,
+                                  const void *key);
+
+void
+_mesa_swiss_set_remove(struct swiss_set *set, struct set_entry *entry);
+void
+_mesa_swiss_set_remove_key(struct swiss_set *set, const void *key);
+
+struct set_entry *
+_mesa_swiss_set_next_entry(const struct swiss_set *set,
+                           struct set_entry *entry);
+
+/**
+ * This foreach function is safe against deletion, but not against insertion
+ * (which may rehash the set, making entry a dangling pointer).
+ */
+#define swiss_set_foreach(set, entry)                                        \
+   for (struct set_entry *entry = _mesa_swiss_set_next_entry(set, NULL);     \
+        entry != NULL;                                                       \
+        entry = _mesa_swiss_set_next_entry(set, entry))
+
+#ifdef __cplusplus
+} /* extern C */
+#endif
+
+#endif /* _SWISS_TABLE_H */
@@ -502,6 +502,70 @@ test_put_key_and_get_key(const char *driver_id)
    disk_cache_destroy(cache);
 }
 
+static void
+test_get_many(const char *driver_id)
+{
+   static const char *items[] = {
+      "first item", "second, longer item", "third item",
+   };
+   static const char missing[] = "never put into the cache";
+   cache_key keys[ARRAY_SIZE(items) + 1];
+   void *data[ARRAY_SIZE(keys)];
+   size_t sizes[ARRAY_SIZE(keys)];
+   struct disk_cache *cache;
+   unsigned found;
+
+#ifdef SHADER_CACHE_DISABLE_BY_DEFAULT
+   os_set_option("MESA_SHADER_CACHE_DISABLE", "false", true);
+#endif /* SHADER_CACHE_DISABLE_BY_DEFAULT */
+
+   /* Make sure none of the items gets evicted by the earlier tests. */
+   os_set_option("MESA_SHADER_CACHE_MAX_SIZE", "16M", true);
+   cache = disk_cache_create("test", driver_id, 0);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(items); i++) {
+      disk_cache_compute_key(cache, items[i], strlen(items[i]) + 1, keys[i]);
+      disk_cache_put(cache, keys[i], items[i], strlen(items[i]) + 1, NULL);
+   }
+   disk_cache_compute_key(cache, missing, sizeof(missing),
+                          keys[ARRAY_SIZE(items)]);
+   disk_cache_wait_for_idle(cache);
+
+   found = disk_cache_get_many(cache, ARRAY_SIZE(keys), keys, data, sizes);
+   EXPECT_EQ(found, ARRAY_SIZE(items)) << "disk_cache_get_many hit count";
+
+   for (unsigned i = 0; i < ARRAY_SIZE(items); i++) {
+      EXPECT_STREQ((char *) data[i], items[i]) << "disk_cache_get_many item";
+      EXPECT_EQ(sizes[i], strlen(items[i]) + 1) << "disk_cache_get_many size";
+      free(data[i]);
+   }
+   EXPECT_EQ(data[ARRAY_SIZE(items)], nullptr)
+      << "disk_cache_get_many with non-existent item";
+
+   /* Prefetched items must be returned the same way, whether they come from
+    * the prefetched set or from disk.
+    */
+   disk_cache_prefetch(cache, ARRAY_SIZE(keys), keys);
+   disk_cache_wait_for_idle(cache);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(items); i++) {
+      size_t size;
+      char *result = (char *) disk_cache_get(cache, keys[i], &size);
+      EXPECT_STREQ(result, items[i]) << "disk_cache_get of prefetched item";
+      EXPECT_EQ(size, strlen(items[i]) + 1) << "disk_cache_get of prefetched item (size)";
+      free(result);
+   }
+
+   /* Prefetched items are handed out only once, but stay in the cache. */
+   disk_cache_prefetch(cache, 1, keys);
+   found = disk_cache_get_many(cache, ARRAY_SIZE(keys), keys, data, NULL);
+   EXPECT_EQ(found, ARRAY_SIZE(items)) << "disk_cache_get_many after prefetch";
+   for (unsigned i = 0; i < ARRAY_SIZE(keys); i++)
+      free(data[i]);
+
+   disk_cache_destroy(cache);
+}
+
 /* To make sure we are not just using the inmemory cache index for the single
  * file cache we test adding and retriving cache items between two different
  * cache instances.
@@ -565,6 +629,69 @@ test_put_and_get_between_instances(const char *driver_id)
    disk_cache_destroy(cache2);
 }
 
+/* Entries read without the DB lock have to be picked up again after another
+ * instance compacted the DB.
+ */
+static void
+test_lockless_reads_between_instances(const char *driver_id)
+{
+   char blob[] = "This is a blob of thirty-seven bytes";
+   uint8_t blob_key[BLAKE3_KEY_LEN];
+   char string[] = "While this string has thirty-four";
+   uint8_t string_key[BLAKE3_KEY_LEN];
+   char *result;
+   size_t size;
+
+#ifdef SHADER_CACHE_DISABLE_BY_DEFAULT
+   os_set_option("MESA_SHADER_CACHE_DISABLE", "false", true);
+#endif /* SHADER_CACHE_DISABLE_BY_DEFAULT */
+
+   os_set_option("MESA_SHADER_CACHE_MAX_SIZE", "16M", true);
+   os_set_option("MESA_DISK_CACHE_DATABASE_LOCKLESS_READS", "true", true);
+
+   struct disk_cache *cache1 = disk_cache_create("test_lockless_reads",
+                                                 driver_id, 0);
+   struct disk_cache *cache2 = disk_cache_create("test_lockless_reads",
+                                                 driver_id, 0);
+
+   disk_cache_compute_key(cache1, blob, sizeof(blob), blob_key);
+   disk_cache_compute_key(cache1, string, sizeof(string), string_key);
+
+   disk_cache_put(cache1, blob_key, blob, sizeof(blob), NULL);
+   disk_cache_put(cache1, string_key, string, sizeof(string), NULL);
+   disk_cache_wait_for_idle(cache1);
+
+   /* The first lookup indexes the entries, the second one skips the lock. */
+   for (unsigned i = 0; i < 2; i++) {
+      result = (char *) disk_cache_get(cache2, blob_key, &size);
+      EXPECT_STREQ(result, blob) << "disk_cache_get(cache2) of existing item (pointer)";
+      EXPECT_EQ(size, sizeof(blob)) << "disk_cache_get(cache2) of existing item (size)";
+      free(result);
+
+      result = (char *) disk_cache_get(cache2, string_key, &size);
+      EXPECT_STREQ(result, string) << "2nd disk_cache_get(cache2) of existing item (pointer)";
+      EXPECT_EQ(size, sizeof(string)) << "2nd disk_cache_get(cache2) of existing item (size)";
+      free(result);
+   }
+
+   /* Removing the first entry compacts the DB, moving the second one. */
+   disk_cache_remove(cache1, blob_key);
+
+   result = (char *) disk_cache_get(cache2, blob_key, &size);
+   EXPECT_EQ(result, nullptr) << "disk_cache_get(cache2) of removed item";
+   free(result);
+
+   result = (char *) disk_cache_get(cache2, string_key, &size);
+   EXPECT_STREQ(result, string) << "disk_cache_get(cache2) of moved item (pointer)";
+   EXPECT_EQ(size, sizeof(string)) << "disk_cache_get(cache2) of moved item (size)";
+   free(result);
+
+   disk_cache_destroy(cache1);
+   disk_cache_destroy(cache2);
+
+   os_unset_option("MESA_DISK_CACHE_DATABASE_LOCKLESS_READS");
+}
+
 static void
 test_put_and_get_between_instances_with_eviction(const char *driver_id)
 {
@@ -695,6 +822,87 @@ test_put_and_get_between_instances_with_eviction(const char *driver_id)
    disk_cache_destroy(cache[1]);
 }
 
+static void
+count_item(void *data, const void *item_data, size_t item_size)
+{
+   static const char item[] = "compressed with a dictionary";
+
+   if (item_size == sizeof(item) && memcmp(item_data, item, item_size) == 0)
+      (*(unsigned *)data)++;
+}
+
+static void
+test_put_and_get_with_dict(const char *driver_id)
+{
+   static const char dict[] = "compressed with a dictionary, or without";
+   static const char old_item[] = "compressed without a dictionary";
+   static const char item[] = "compressed with a dictionary";
+   uint8_t old_key[BLAKE3_KEY_LEN], key[BLAKE3_KEY_LEN];
+   struct disk_cache *cache;
+   char *result;
+   size_t size;
+
+#ifdef SHADER_CACHE_DISABLE_BY_DEFAULT
+   os_set_option("MESA_SHADER_CACHE_DISABLE", "false", true);
+#endif /* SHADER_CACHE_DISABLE_BY_DEFAULT */
+
+   os_set_option("MESA_SHADER_CACHE_MAX_SIZE", "16M", true);
+   cache = disk_cache_create("test", driver_id, 0);
+   EXPECT_EQ(cache->compress_dict, nullptr) << "no dictionary installed";
+
+   disk_cache_compute_key(cache, old_item, sizeof(old_item), old_key);
+   disk_cache_put(cache, old_key, old_item, sizeof(old_item), NULL);
+   disk_cache_wait_for_idle(cache);
+
+   char *dict_filename =
+      disk_cache_get_dict_filename(NULL, cache->path, "test", 0);
+   FILE *f = fopen(dict_filename, "wb");
+   ASSERT_NE(f, nullptr) << "creating the dictionary";
+   fwrite(dict, 1, sizeof(dict), f);
+   fclose(f);
+
+   disk_cache_destroy(cache);
+   cache = disk_cache_create("test", driver_id, 0);
+   EXPECT_NE(cache->compress_dict, nullptr) << "dictionary loaded";
+
+   disk_cache_compute_key(cache, item, sizeof(item), key);
+   disk_cache_put(cache, key, item, sizeof(item), NULL);
+   disk_cache_wait_for_idle(cache);
+
+   result = (char *) disk_cache_get(cache, key, &size);
+   EXPECT_STREQ(result, item) << "disk_cache_get with dictionary";
+   EXPECT_EQ(size, sizeof(item)) << "disk_cache_get with dictionary (size)";
+   free(result);
+
+   result = (char *) disk_cache_get(cache, old_key, &size);
+   EXPECT_STREQ(result, old_item) << "disk_cache_get of entry without dictionary";
+   free(result);
+
+   unsigned count = 0;
+   EXPECT_TRUE(disk_cache_foreach_item(cache->path, "test", count_item, &count));
+   EXPECT_EQ(count, 1) << "disk_cache_foreach_item with dictionary";
+
+   char *path = ralloc_strdup(NULL, cache->path);
+   disk_cache_destroy(cache);
+
+   /* Entries compressed with a dictionary which is gone are misses. */
+   unlink(dict_filename);
+   cache = disk_cache_create("test", driver_id, 0);
+
+   EXPECT_FALSE(does_cache_contain(cache, key))
+      << "disk_cache_get without the entry's dictionary";
+   EXPECT_TRUE(does_cache_contain(cache, old_key))
+      << "disk_cache_get of entry without dictionary";
+
+   count = 0;
+   disk_cache_foreach_item(path, "test", count_item, &count);
+   EXPECT_EQ(count, 0) << "disk_cache_foreach_item without the dictionary";
+
+   disk_cache_destroy(cache);
+   ralloc_free(dict_filename);
+   ralloc_free(path);
+}
+
 static void
 test_put_big_sized_entry_to_empty_cache(const char *driver_id)
 {
@@ -761,6 +969,11 @@ run_tests:
 
    test_put_key_and_get_key(driver_id);
 
+   test_get_many(driver_id);
+
+   if (compress)
+      test_put_and_get_with_dict(driver_id);
+
    os_set_option("MESA_DISK_CACHE_MULTI_FILE", "false", true);
 
    int err = rmrf_local(CACHE_TEST_TMP);
@@ -801,6 +1014,8 @@ run_tests:
 
    test_put_and_get_between_instances(driver_id);
 
+   test_get_many(driver_id);
+
    os_set_option("MESA_DISK_CACHE_SINGLE_FILE", "false", true);
 
    int err = rmrf_local(CACHE_TEST_TMP);
@@ -842,10 +1057,16 @@ TEST_F(Cache, Database)
 
    test_put_key_and_get_key(driver_id);
 
+   test_get_many(driver_id);
+
    test_put_and_get_between_instances(driver_id);
 
    test_put_and_get_between_instances_with_eviction(driver_id);
 
+   test_lockless_reads_between_instances(driver_id);
+
+   test_put_and_get_with_dict("make_check");
+
    test_put_big_sized_entry_to_empty_cache(driver_id);
 
    os_set_option("MESA_DISK_CACHE_DATABASE", "false", true);
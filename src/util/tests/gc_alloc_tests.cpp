@@ -46,3 +46,39 @@ TEST(gc_alloc, align)
       }
    }
 }
+
+TEST(gc_alloc, alloc_counts)
+{
+   struct ralloc_alloc_counts before, after;
+
+   ralloc_enable_alloc_counts(true);
+   ralloc_get_alloc_counts(&before);
+
+   gc_ctx *ctx = gc_context(NULL);
+   ralloc_get_alloc_counts(&after);
+   EXPECT_EQ(after.gc, before.gc);
+
+   /* Neither the slab of the small object nor the block of the large one
+    * count as ralloc allocations.
+    */
+   before = after;
+   gc_alloc_size(ctx, 16, 8);
+   gc_alloc_size(ctx, 64 * 1024, 8);
+   ralloc_get_alloc_counts(&after);
+   EXPECT_EQ(after.gc - before.gc, 2);
+   EXPECT_EQ(after.ralloc, before.ralloc);
+
+   before = after;
+   ralloc_size(ctx, 16);
+   ralloc_get_alloc_counts(&after);
+   EXPECT_EQ(after.ralloc - before.ralloc, 1);
+   EXPECT_EQ(after.gc, before.gc);
+
+   ralloc_free(ctx);
+
+   ralloc_enable_alloc_counts(false);
+   ralloc_get_alloc_counts(&before);
+   ralloc_free(ralloc_size(NULL, 16));
+   ralloc_get_alloc_counts(&after);
+   EXPECT_EQ(after.ralloc, before.ralloc);
+}
@@ -0,0 +1,158 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Compares the regular hash table and set against their Swiss-table
+ * counterparts on pointer keys, the most common kind of keys in the
+ * compiler.
+ *
+ * Usage: hash_table_bench [max entries]
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "util/hash_table.h"
+#include "util/os_time.h"
+#include "util/set.h"
+#include "util/swiss_table.h"
+
+/* Roughly the same amount of operations is done for every table size. */
+#define OPS_PER_SIZE (1 << 22)
+
+static const void **keys;
+static const void **missing_keys;
+static volatile uintptr_t sink;
+
+enum op {
+   OP_INSERT,
+   OP_LOOKUP_HIT,
+   OP_LOOKUP_MISS,
+   OP_ITERATE,
+   OP_REMOVE_INSERT,
+   NUM_OPS,
+};
+
+static const char *op_names[NUM_OPS] = {
+   "insert",
+   "lookup hit",
+   "lookup miss",
+   "iterate",
+   "remove+insert",
+};
+
+/* One function per implementation, so that none of them goes through
+ * function pointers.
+ */
+#define BENCH(name, type, init, insert, search, remove, foreach, fini)        \
+static void                                                                  \
+bench_##name(unsigned n, double *ns)                                         \
+{                                                                            \
+   unsigned iters = MAX2(OPS_PER_SIZE / n, 1);                               \
+   int64_t t[NUM_OPS] = {0}, start;                                          \
+                                                                             \
+   for (unsigned it = 0; it < iters; it++) {                                 \
+      type table;                                                            \
+      init(&table, NULL, _mesa_hash_pointer, _mesa_key_pointer_equal);      \
+                                                                             \
+      start = os_time_get_nano();                                            \
+      for (unsigned i = 0; i < n; i++)                                       \
+         insert(&table, keys[i]);                                            \
+      t[OP_INSERT] += os_time_get_nano() - start;                            \
+                                                                             \
+      start = os_time_get_nano();                                            \
+      for (unsigned i = 0; i < n; i++)                                       \
+         sink += (uintptr_t)search(&table, keys[i]);                         \
+      t[OP_LOOKUP_HIT] += os_time_get_nano() - start;                        \
+                                                                             \
+      start = os_time_get_nano();                                            \
+      for (unsigned i = 0; i < n; i++)                                       \
+         sink += (uintptr_t)search(&table, missing_keys[i]);                 \
+      t[OP_LOOKUP_MISS] += os_time_get_nano() - start;                       \
+                                                                             \
+      start = os_time_get_nano();                                            \
+      foreach(&table, entry)                                                 \
+         sink += (uintptr_t)entry->key;                                      \
+      t[OP_ITERATE] += os_time_get_nano() - start;                           \
+                                                                             \
+      start = os_time_get_nano();                                            \
+      for (unsigned i = 0; i < n; i++) {                                     \
+         remove(&table, search(&table, keys[i]));                            \
+         insert(&table, missing_keys[i]);                                    \
+      }                                                                      \
+      t[OP_REMOVE_INSERT] += os_time_get_nano() - start;                     \
+                                                                             \
+      fini(&table, NULL);                                                    \
+   }                                                                         \
+                                                                             \
+   for (unsigned op = 0; op < NUM_OPS; op++)                                 \
+      ns[op] = (double)t[op] / ((double)iters * n);                          \
+}
+
+#define hash_table_insert_key(ht, key) _mesa_hash_table_insert(ht, key, NULL)
+#define swiss_table_insert_key(ht, key) _mesa_swiss_table_insert(ht, key, NULL)
+
+BENCH(hash_table, struct hash_table, _mesa_hash_table_init,
+      hash_table_insert_key, _mesa_hash_table_search,
+      _mesa_hash_table_remove, hash_table_foreach, _mesa_hash_table_fini)
+BENCH(swiss_table, struct swiss_table, _mesa_swiss_table_init,
+      swiss_table_insert_key, _mesa_swiss_table_search,
+      _mesa_swiss_table_remove, swiss_table_foreach, _mesa_swiss_table_fini)
+BENCH(set, struct set, _mesa_set_init, _mesa_set_add, _mesa_set_search,
+      _mesa_set_remove, set_foreach, _mesa_set_fini)
+BENCH(swiss_set, struct swiss_set, _mesa_swiss_set_init, _mesa_swiss_set_add,
+      _mesa_swiss_set_search, _mesa_swiss_set_remove, swiss_set_foreach,
+      _mesa_swiss_set_fini)
+
+static void
+print_results(const char *name, const char *swiss_name, unsigned n,
+              const double *ns, const double *swiss_ns)
+{
+   for (unsigned op = 0; op < NUM_OPS; op++) {
+      printf("%-12s %9u  %-14s %8.2f ns  %-12s %8.2f ns  %5.2fx\n",
+             name, n, op_names[op], ns[op], swiss_name, swiss_ns[op],
+             ns[op] / swiss_ns[op]);
+   }
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned max_entries = argc > 1 ? strtoul(argv[1], NULL, 0) : 1 << 20;
+
+   /* Heap-like pointers: 16 byte aligned, shuffled. */
+   keys = malloc(2 * max_entries * sizeof(*keys));
+   if (!keys)
+      return EXIT_FAILURE;
+
+   for (uintptr_t i = 0; i < 2 * max_entries; i++)
+      keys[i] = (const void *)(0x10000000 + i * 16);
+   srand(0);
+   for (unsigned i = 2 * max_entries - 1; i > 0; i--) {
+      unsigned j = rand() % (i + 1);
+      const void *tmp = keys[i];
+      keys[i] = keys[j];
+      keys[j] = tmp;
+   }
+   missing_keys = keys + max_entries;
+
+   /* Powers of two would fill the regular tables up to their max_entries,
+    * making them rehash on every removal+insertion.
+    */
+   for (unsigned n = 24; n <= max_entries; n *= 4) {
+      double ns[NUM_OPS], swiss_ns[NUM_OPS];
+
+      bench_hash_table(n, ns);
+      bench_swiss_table(n, swiss_ns);
+      print_results("hash_table", "swiss_table", n, ns, swiss_ns);
+
+      bench_set(n, ns);
+      bench_swiss_set(n, swiss_ns);
+      print_results("set", "swiss_set", n, ns, swiss_ns);
+   }
+
+   free(keys);
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Times the register allocator on random interference graphs built from
+ * live ranges, with a register file and classes similar to the Intel
+ * backend's.  Failed allocations are handled like the backends do: the best
+ * node is spilled by taking it out of the graph and the allocation is
+ * retried on the same graph.
+ *
+ * Usage: register_allocate_bench [max nodes]
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "util/os_time.h"
+#include "util/ralloc.h"
+#include "util/register_allocate.h"
+
+#define NUM_REGS 128
+#define NUM_CLASSES 4
+
+/* With twice as many nodes as instructions, this is also the average
+ * number of live ranges overlapping any point.  That is a bit more than fits
+ * in the register file with the average class size, so that some nodes have
+ * to be spilled.
+ */
+#define MAX_LIVE_RANGE 40
+
+static void
+bench(struct ra_regs *regs, struct ra_class **classes, unsigned num_nodes)
+{
+   unsigned *start = malloc(num_nodes * sizeof(*start));
+   unsigned *end = malloc(num_nodes * sizeof(*end));
+   unsigned num_ips = num_nodes / 2;
+
+   srand(num_nodes);
+
+   int64_t build_start = os_time_get_nano();
+
+   struct ra_graph *g = ra_alloc_interference_graph(regs, num_nodes);
+   for (unsigned n = 0; n < num_nodes; n++) {
+      start[n] = rand() % num_ips;
+      end[n] = start[n] + 1 + rand() % MAX_LIVE_RANGE;
+      ra_set_node_class(g, n, classes[rand() % NUM_CLASSES]);
+      ra_set_node_spill_cost(g, n, 1.0f + rand() % 16);
+   }
+
+   uint64_t num_edges = 0;
+   for (unsigned n1 = 0; n1 < num_nodes; n1++) {
+      for (unsigned n2 = 0; n2 < n1; n2++) {
+         if (start[n1] < end[n2] && start[n2] < end[n1]) {
+            ra_add_node_interference(g, n1, n2);
+            num_edges++;
+         }
+      }
+   }
+
+   int64_t alloc_start = os_time_get_nano();
+
+   unsigned rounds = 1, spills = 0;
+   while (!ra_allocate(g)) {
+      int n = ra_get_best_spill_node(g);
+      if (n < 0)
+         break;
+
+      ra_set_node_spill_cost(g, n, 0);
+      ra_reset_node_interference(g, n);
+      spills++;
+      rounds++;
+   }
+
+   int64_t alloc_end = os_time_get_nano();
+
+   printf("%8u %12" PRIu64 " %8u %12.3f %12.3f %12.3f\n", num_nodes,
+          num_edges, spills, (alloc_start - build_start) / 1000000.0,
+          (alloc_end - alloc_start) / 1000000.0,
+          (alloc_end - alloc_start) / 1000000.0 / rounds);
+
+   ralloc_free(g);
+   free(start);
+   free(end);
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned max_nodes = argc > 1 ? strtoul(argv[1], NULL, 0) : 16384;
+
+   struct ra_regs *regs = ra_alloc_reg_set(NULL, NUM_REGS, false);
+   struct ra_class *classes[NUM_CLASSES];
+   for (unsigned i = 0; i < NUM_CLASSES; i++) {
+      classes[i] = ra_alloc_contig_reg_class(regs, 1 << i);
+      for (unsigned r = 0; r + (1 << i) <= NUM_REGS; r++)
+         ra_class_add_reg(classes[i], r);
+   }
+   ra_set_finalize(regs, NULL);
+
+   printf("%8s %12s %8s %12s %12s %12s\n", "nodes", "edges", "spills",
+          "build ms", "alloc ms", "ms/round");
+
+   for (unsigned n = 1024; n <= max_nodes; n *= 2)
+      bench(regs, classes, n);
+
+   ralloc_free(regs);
+
+   return EXIT_SUCCESS;
+}
@@ -279,3 +279,104 @@ TEST_F(ra_test, serialization_roundtrip)
    blob_finish(&blob);
 }
 
+
+/* Allocates random live ranges, spilling until it succeeds, and checks that
+ * no two interfering nodes got conflicting registers.
+ */
+TEST_F(ra_test, interval_graph_spilling)
+{
+   const unsigned num_regs = 32, num_nodes = 400, num_ips = 200;
+   struct ra_regs *regs = ra_alloc_reg_set(mem_ctx, num_regs, false);
+
+   struct ra_class *classes[3];
+   for (unsigned size = 1, i = 0; i < 3; size *= 2, i++) {
+      classes[i] = ra_alloc_contig_reg_class(regs, size);
+      for (unsigned r = 0; r + size <= num_regs; r += size)
+         ra_class_add_reg(classes[i], r);
+   }
+   ra_set_finalize(regs, NULL);
+
+   struct ra_graph *g = ra_alloc_interference_graph(regs, num_nodes);
+   ralloc_steal(mem_ctx, g);
+
+   unsigned start[num_nodes], end[num_nodes];
+   srand(42);
+   for (unsigned n = 0; n < num_nodes; n++) {
+      start[n] = rand() % num_ips;
+      end[n] = start[n] + 1 + rand() % 20;
+      ra_set_node_class(g, n, classes[rand() % 3]);
+      ra_set_node_spill_cost(g, n, 1.0f + rand() % 4);
+   }
+
+   for (unsigned n1 = 0; n1 < num_nodes; n1++) {
+      for (unsigned n2 = 0; n2 < n1; n2++) {
+         if (start[n1] < end[n2] && start[n2] < end[n1])
+            ra_add_node_interference(g, n1, n2);
+      }
+   }
+
+   bool spilled[num_nodes] = {};
+   unsigned num_spilled = 0;
+   while (!ra_allocate(g)) {
+      int n = ra_get_best_spill_node(g);
+      ASSERT_GE(n, 0);
+
+      /* Spilled nodes are simply taken out of the graph. */
+      ra_set_node_spill_cost(g, n, 0);
+      ra_reset_node_interference(g, n);
+      spilled[n] = true;
+      num_spilled++;
+   }
+
+   EXPECT_GT(num_spilled, 0);
+
+   for (unsigned n1 = 0; n1 < num_nodes; n1++) {
+      if (spilled[n1])
+         continue;
+
+      struct ra_class *c1 = ra_get_node_class(g, n1);
+      unsigned r1 = ra_get_node_reg(g, n1);
+      ASSERT_TRUE(BITSET_TEST(c1->regs, r1));
+
+      for (unsigned n2 = 0; n2 < n1; n2++) {
+         if (spilled[n2] || !(start[n1] < end[n2] && start[n2] < end[n1]))
+            continue;
+
+         EXPECT_FALSE(ra_class_allocations_conflict(
+            c1, r1, ra_get_node_class(g, n2), ra_get_node_reg(g, n2)));
+      }
+   }
+}
+
+/* The registers are picked from the lowest one, or from the one after the
+ * last one picked with round-robin, across the words of the bitsets.
+ */
+TEST_F(ra_test, select_lowest_regs)
+{
+   const unsigned num_regs = 128, num_nodes = 40;
+
+   for (unsigned round_robin = 0; round_robin < 2; round_robin++) {
+      struct ra_regs *regs = ra_alloc_reg_set(mem_ctx, num_regs, round_robin);
+      struct ra_class *c = ra_alloc_reg_class(regs);
+      for (unsigned r = 0; r < num_regs; r++)
+         ra_class_add_reg(c, r);
+      ra_set_finalize(regs, NULL);
+
+      struct ra_graph *g = ra_alloc_interference_graph(regs, num_nodes);
+      ralloc_steal(mem_ctx, g);
+      for (unsigned n1 = 0; n1 < num_nodes; n1++) {
+         ra_set_node_class(g, n1, c);
+         for (unsigned n2 = 0; n2 < n1; n2++)
+            ra_add_node_interference(g, n1, n2);
+      }
+
+      ASSERT_TRUE(ra_allocate(g));
+
+      BITSET_DECLARE(used, num_regs) = { 0 };
+      for (unsigned n = 0; n < num_nodes; n++)
+         BITSET_SET(used, ra_get_node_reg(g, n));
+
+      for (unsigned r = 0; r < num_regs; r++)
+         EXPECT_EQ(BITSET_TEST(used, r), r < num_nodes) << "reg " << r;
+   }
+}
@@ -100,6 +100,33 @@ TEST(sparse_bitset, set_merge)
    u_sparse_bitset_free(&set2);
 }
 
+TEST(sparse_bitset, set_cmp)
+{
+   struct u_sparse_bitset set;
+   u_sparse_bitset_init(&set, 1048577, NULL);
+
+   u_sparse_bitset_set(&set, 65535);
+   u_sparse_bitset_set(&set, 1048576);
+
+   struct u_sparse_bitset set2;
+   u_sparse_bitset_init(&set2, 1048577, NULL);
+   u_sparse_bitset_set(&set2, 128);
+   u_sparse_bitset_set(&set2, 1048576);
+
+   EXPECT_NE(u_sparse_bitset_cmp(&set, &set2), 0);
+
+   /* Sets with the same bits are equal, even if clearing bits left empty
+    * nodes in one of them.
+    */
+   u_sparse_bitset_clear(&set, 65535);
+   u_sparse_bitset_clear(&set2, 128);
+
+   EXPECT_EQ(u_sparse_bitset_cmp(&set, &set2), 0);
+
+   u_sparse_bitset_free(&set);
+   u_sparse_bitset_free(&set2);
+}
+
 TEST(sparse_bitset, set_foreach)
 {
    struct u_sparse_bitset set;
@@ -0,0 +1,252 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <gtest/gtest.h>
+#include <set>
+#include <unordered_map>
+
+#include "util/ralloc.h"
+#include "util/swiss_table.h"
+
+static uint32_t
+constant_hash(const void *key)
+{
+   return 42;
+}
+
+static const void *
+key(uintptr_t i)
+{
+   /* 0 is a valid key too. */
+   return (const void *)(i * 8);
+}
+
+TEST(swiss_table, basic)
+{
+   struct swiss_table *ht = _mesa_pointer_swiss_table_create(NULL);
+   int a, b;
+
+   EXPECT_EQ(_mesa_swiss_table_search(ht, key(1)), nullptr);
+   swiss_table_foreach(ht, entry) {
+      GTEST_FAIL();
+   }
+
+   _mesa_swiss_table_insert(ht, key(1), &a);
+   _mesa_swiss_table_insert(ht, key(2), &b);
+   EXPECT_EQ(_mesa_swiss_table_num_entries(ht), 2);
+
+   /* Inserting an existing key replaces its data. */
+   _mesa_swiss_table_insert(ht, key(1), &b);
+   EXPECT_EQ(_mesa_swiss_table_num_entries(ht), 2);
+
+   struct hash_entry *entry = _mesa_swiss_table_search(ht, key(1));
+   ASSERT_NE(entry, nullptr);
+   EXPECT_EQ(entry->key, key(1));
+   EXPECT_EQ(entry->data, &b);
+
+   _mesa_swiss_table_remove(ht, entry);
+   EXPECT_EQ(_mesa_swiss_table_num_entries(ht), 1);
+   EXPECT_EQ(_mesa_swiss_table_search(ht, key(1)), nullptr);
+   EXPECT_NE(_mesa_swiss_table_search(ht, key(2)), nullptr);
+
+   _mesa_swiss_table_remove_key(ht, key(2));
+   EXPECT_EQ(_mesa_swiss_table_num_entries(ht), 0);
+
+   _mesa_swiss_table_insert(ht, key(3), &a);
+   _mesa_swiss_table_clear(ht, NULL);
+   EXPECT_EQ(_mesa_swiss_table_num_entries(ht), 0);
+   swiss_table_foreach(ht, entry) {
+      GTEST_FAIL();
+   }
+
+   _mesa_swiss_table_destroy(ht, NULL);
+}
+
+/* Compare against std::unordered_map over a mix of insertions and removals
+ * big enough to grow the table and fill it with deleted entries.
+ */
+TEST(swiss_table, random)
+{
+   struct swiss_table *ht = _mesa_pointer_swiss_table_create(NULL);
+   std::unordered_map<uintptr_t, uintptr_t> ref;
+
+   srand(1234);
+   for (unsigned i = 0; i < 100000; i++) {
+      uintptr_t k = rand() % 5000;
+
+      if (rand() % 3) {
+         _mesa_swiss_table_insert(ht, key(k), (void *)(uintptr_t)i);
+         ref[k] = i;
+      } else {
+         _mesa_swiss_table_remove_key(ht, key(k));
+         ref.erase(k);
+      }
+   }
+
+   EXPECT_EQ(_mesa_swiss_table_num_entries(ht), ref.size());
+
+   for (uintptr_t k = 0; k < 5000; k++) {
+      struct hash_entry *entry = _mesa_swiss_table_search(ht, key(k));
+      auto it = ref.find(k);
+
+      if (it == ref.end()) {
+         EXPECT_EQ(entry, nullptr);
+      } else {
+         ASSERT_NE(entry, nullptr);
+         EXPECT_EQ((uintptr_t)entry->data, it->second);
+      }
+   }
+
+   size_t count = 0;
+   swiss_table_foreach(ht, entry) {
+      EXPECT_EQ(ref.count((uintptr_t)entry->key / 8), 1);
+      count++;
+   }
+   EXPECT_EQ(count, ref.size());
+
+   _mesa_swiss_table_destroy(ht, NULL);
+}
+
+TEST(swiss_table, collisions)
+{
+   struct swiss_table ht;
+
+   _mesa_swiss_table_init(&ht, NULL, constant_hash, _mesa_key_pointer_equal);
+
+   for (uintptr_t i = 0; i < 100; i++)
+      _mesa_swiss_table_insert(&ht, key(i), (void *)i);
+
+   for (uintptr_t i = 0; i < 100; i += 2)
+      _mesa_swiss_table_remove_key(&ht, key(i));
+
+   for (uintptr_t i = 0; i < 100; i++) {
+      struct hash_entry *entry = _mesa_swiss_table_search(&ht, key(i));
+      if (i % 2) {
+         ASSERT_NE(entry, nullptr);
+         EXPECT_EQ(entry->data, (void *)i);
+      } else {
+         EXPECT_EQ(entry, nullptr);
+      }
+   }
+
+   _mesa_swiss_table_fini(&ht, NULL);
+}
+
+TEST(swiss_table, remove_while_iterating)
+{
+   struct swiss_table *ht = _mesa_pointer_swiss_table_create(NULL);
+
+   for (uintptr_t i = 0; i < 1000; i++)
+      _mesa_swiss_table_insert(ht, key(i), NULL);
+
+   unsigned count = 0;
+   swiss_table_foreach(ht, entry) {
+      if ((uintptr_t)entry->key / 8 % 3 == 0)
+         _mesa_swiss_table_remove(ht, entry);
+      count++;
+   }
+   EXPECT_EQ(count, 1000);
+   EXPECT_EQ(_mesa_swiss_table_num_entries(ht), 666);
+
+   _mesa_swiss_table_destroy(ht, NULL);
+}
+
+static unsigned deleted_count;
+
+static void
+delete_callback(struct hash_entry *entry)
+{
+   deleted_count++;
+}
+
+TEST(swiss_table, reserve_and_delete_callback)
+{
+   void *mem_ctx = ralloc_context(NULL);
+   struct swiss_table *ht = _mesa_pointer_swiss_table_create(mem_ctx);
+
+   EXPECT_TRUE(_mesa_swiss_table_reserve(ht, 1000));
+   for (uintptr_t i = 0; i < 1000; i++)
+      _mesa_swiss_table_insert(ht, key(i), NULL);
+
+   deleted_count = 0;
+   _mesa_swiss_table_clear(ht, delete_callback);
+   EXPECT_EQ(deleted_count, 1000);
+
+   for (uintptr_t i = 0; i < 10; i++)
+      _mesa_swiss_table_insert(ht, key(i), NULL);
+
+   deleted_count = 0;
+   _mesa_swiss_table_destroy(ht, delete_callback);
+   EXPECT_EQ(deleted_count, 10);
+
+   ralloc_free(mem_ctx);
+}
+
+TEST(swiss_set, basic)
+{
+   struct swiss_set *s = _mesa_pointer_swiss_set_create(NULL);
+   bool found;
+
+   _mesa_swiss_set_add(s, key(1));
+   _mesa_swiss_set_add(s, key(2));
+   EXPECT_EQ(_mesa_swiss_set_num_entries(s), 2);
+
+   _mesa_swiss_set_add(s, key(1));
+   EXPECT_EQ(_mesa_swiss_set_num_entries(s), 2);
+
+   struct set_entry *entry = _mesa_swiss_set_search_or_add(s, key(3), &found);
+   EXPECT_FALSE(found);
+   EXPECT_EQ(entry->key, key(3));
+   EXPECT_EQ(_mesa_swiss_set_search_or_add(s, key(3), &found), entry);
+   EXPECT_TRUE(found);
+
+   entry = _mesa_swiss_set_search(s, key(1));
+   ASSERT_NE(entry, nullptr);
+   _mesa_swiss_set_remove(s, entry);
+   EXPECT_EQ(_mesa_swiss_set_search(s, key(1)), nullptr);
+   EXPECT_EQ(_mesa_swiss_set_num_entries(s), 2);
+
+   std::set<const void *> keys;
+   swiss_set_foreach(s, entry)
+      keys.insert(entry->key);
+   EXPECT_EQ(keys, std::set<const void *>({key(2), key(3)}));
+
+   _mesa_swiss_set_clear(s, NULL);
+   EXPECT_EQ(_mesa_swiss_set_num_entries(s), 0);
+   swiss_set_foreach(s, entry) {
+      GTEST_FAIL();
+   }
+
+   _mesa_swiss_set_destroy(s, NULL);
+}
+
+TEST(swiss_set, random)
+{
+   struct swiss_set s;
+   std::set<uintptr_t> ref;
+
+   _mesa_swiss_set_init(&s, NULL, _mesa_hash_pointer,
+                        _mesa_key_pointer_equal);
+
+   srand(4321);
+   for (unsigned i = 0; i < 100000; i++) {
+      uintptr_t k = rand() % 5000;
+
+      if (rand() % 2) {
+         _mesa_swiss_set_add(&s, key(k));
+         ref.insert(k);
+      } else {
+         _mesa_swiss_set_remove_key(&s, key(k));
+         ref.erase(k);
+      }
+   }
+
+   EXPECT_EQ(_mesa_swiss_set_num_entries(&s), ref.size());
+   for (uintptr_t k = 0; k < 5000; k++) {
+      EXPECT_EQ(_mesa_swiss_set_search(&s, key(k)) != NULL, ref.count(k) == 1)
+         << "key " << k;
+   }
+
+   _mesa_swiss_set_fini(&s, NULL);
+}
@@ -0,0 +1,204 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Train a zstd dictionary on the entries of a shader cache and install it
+ * in the cache directory, so that the disk cache of the given GPU compresses
+ * new entries with it.
+ *
+ * Usage: mesa_cache_train_dict [-s dict_size] <cache dir> <gpu name>
+ *
+ * The cache dir is the one containing the cache files, e.g.
+ * ~/.cache/mesa_shader_cache_db, and the gpu name is the one the driver
+ * passes to disk_cache_create().  The dictionary it replaces, if any, is
+ * kept so that the entries compressed with it stay readable.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zdict.h>
+
+#include "util/compress.h"
+#include "util/disk_cache_os.h"
+#include "util/ralloc.h"
+#include "util/u_dynarray.h"
+
+/* zstd recommends samples of about 100 times the dictionary size, more
+ * only slows down the training.
+ */
+#define MAX_SAMPLES_SIZE (128 * 1024 * 1024)
+
+struct samples {
+   struct util_dynarray data;
+   struct util_dynarray sizes;
+};
+
+static void
+add_sample(void *data, const void *item_data, size_t item_size)
+{
+   struct samples *samples = data;
+
+   if (samples->data.size + item_size > MAX_SAMPLES_SIZE)
+      return;
+
+   void *sample = util_dynarray_grow_bytes(&samples->data, 1, item_size);
+   if (!sample)
+      return;
+
+   memcpy(sample, item_data, item_size);
+   util_dynarray_append(&samples->sizes, item_size);
+}
+
+static void *
+read_file(const char *filename, size_t *size)
+{
+   FILE *f = fopen(filename, "rb");
+   void *data = NULL;
+   long len;
+
+   if (!f)
+      return NULL;
+
+   if (fseek(f, 0, SEEK_END) || (len = ftell(f)) <= 0 ||
+       fseek(f, 0, SEEK_SET))
+      goto out;
+
+   data = malloc(len);
+   if (data && fread(data, 1, len, f) != (size_t)len) {
+      free(data);
+      data = NULL;
+   }
+   *size = len;
+
+out:
+   fclose(f);
+   return data;
+}
+
+static bool
+write_file(const char *filename, const void *data, size_t size)
+{
+   FILE *f = fopen(filename, "wb");
+   if (!f)
+      return false;
+
+   bool ok = fwrite(data, 1, size, f) == size;
+   return fclose(f) == 0 && ok;
+}
+
+/* Move the current dictionary to the name it is looked up by when reading
+ * the entries compressed with it.
+ */
+static bool
+archive_current_dict(void *mem_ctx, const char *path, const char *gpu_name)
+{
+   char *filename = disk_cache_get_dict_filename(mem_ctx, path, gpu_name, 0);
+   size_t size;
+
+   void *data = read_file(filename, &size);
+   if (!data)
+      return true;
+
+   struct util_compress_dict *dict = util_compress_dict_create(data, size);
+   free(data);
+   if (!dict)
+      return false;
+
+   char *archived =
+      disk_cache_get_dict_filename(mem_ctx, path, gpu_name,
+                                   util_compress_dict_id(dict));
+   util_compress_dict_destroy(dict);
+
+   if (rename(filename, archived)) {
+      fprintf(stderr, "Failed to rename %s to %s\n", filename, archived);
+      return false;
+   }
+
+   return true;
+}
+
+static void
+usage(const char *name)
+{
+   fprintf(stderr, "Usage: %s [-s dict_size] <cache dir> <gpu name>\n", name);
+}
+
+int
+main(int argc, char **argv)
+{
+   size_t dict_capacity = 112640;
+   int opt, ret = EXIT_FAILURE;
+
+   while ((opt = getopt(argc, argv, "s:h")) != -1) {
+      switch (opt) {
+      case 's':
+         dict_capacity = strtoul(optarg, NULL, 0);
+         break;
+      default:
+         usage(argv[0]);
+         return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+      }
+   }
+
+   if (argc - optind != 2 || !dict_capacity) {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   const char *path = argv[optind];
+   const char *gpu_name = argv[optind + 1];
+   void *mem_ctx = ralloc_context(NULL);
+   struct samples samples;
+   void *dict = NULL;
+
+   util_dynarray_init(&samples.data, NULL);
+   util_dynarray_init(&samples.sizes, NULL);
+
+   if (!disk_cache_foreach_item(path, gpu_name, add_sample, &samples)) {
+      fprintf(stderr, "Failed to read the cache in %s\n", path);
+      goto out;
+   }
+
+   unsigned num_samples = util_dynarray_num_elements(&samples.sizes, size_t);
+   printf("Training on %u entries, %u bytes\n", num_samples,
+          samples.data.size);
+
+   dict = malloc(dict_capacity);
+   if (!dict)
+      goto out;
+
+   size_t dict_size =
+      ZDICT_trainFromBuffer(dict, dict_capacity, samples.data.data,
+                            samples.sizes.data, num_samples);
+   if (ZDICT_isError(dict_size)) {
+      fprintf(stderr, "Training failed: %s\n", ZDICT_getErrorName(dict_size));
+      goto out;
+   }
+
+   char *filename = disk_cache_get_dict_filename(mem_ctx, path, gpu_name, 0);
+   char *tmp_filename = ralloc_asprintf(mem_ctx, "%s.tmp", filename);
+
+   if (!write_file(tmp_filename, dict, dict_size)) {
+      fprintf(stderr, "Failed to write %s\n", tmp_filename);
+      goto out;
+   }
+
+   if (!archive_current_dict(mem_ctx, path, gpu_name) ||
+       rename(tmp_filename, filename)) {
+      unlink(tmp_filename);
+      goto out;
+   }
+
+   printf("Wrote %zu bytes dictionary to %s\n", dict_size, filename);
+   ret = EXIT_SUCCESS;
+
+out:
+   free(dict);
+   util_dynarray_fini(&samples.data);
+   util_dynarray_fini(&samples.sizes);
+   ralloc_free(mem_ctx);
+
+   return ret;
+}